@@ -28,14 +28,17 @@
 
 #include <nuttx/config.h>
 
+#include <errno.h>
 #include <stdio.h>
 #include <string.h>
+#include <unistd.h>
 #include <arch/board/apbridgea_gadget.h>
 #include <apps/greybus-utils/utils.h>
 
 #include "apbridge_backend.h"
 
 #define IID_LENGTH 7
+#define GBSIM_BUSY_RETRY_USEC 1000
 
 static int gbsim_usb_to_unipro(unsigned int cportid, void *buf, size_t len,
                                unipro_send_completion_t callback, void *priv)
@@ -66,7 +69,16 @@ static int listen(unsigned int cport)
 static int gbsim_recv_from_unipro(unsigned int cportid,
                                   const void *buf, size_t len)
 {
-    return recv_from_unipro(cportid, (void *)buf, len);
+    int retval;
+
+    /*
+     * The bridge holds one waiting message per cport until a USB request
+     * is free, wait for it to be sent.
+     */
+    while ((retval = recv_from_unipro(cportid, (void *)buf, len)) == -EBUSY)
+        usleep(GBSIM_BUSY_RETRY_USEC);
+
+    return retval;
 }
 
 struct gb_transport_backend gb_unipro_backend = {
@@ -42,6 +42,8 @@
 #include <string.h>
 #include <errno.h>
 
+#include "bdbpm_stream.h"
+
 #define DEFAULT_CONVERSION_TIME     ina230_ct_1_1ms /* 1.1ms */
 #define DEFAULT_AVG_SAMPLE_COUNT    ina230_avg_count_64 /* 64 samples average */
 #define DEFAULT_CURRENT_LSB         100 /* 100uA current LSB */
@@ -63,6 +65,7 @@ static uint32_t refresh_rate = DEFAULT_REFRESH_RATE;
 static uint32_t loopcount = DEFAULT_LOOPCOUNT;
 static uint8_t continuous = DEFAULT_CONTINUOUS;
 static bool csv_export = false;
+static const char *stream_path;
 static uint8_t user_dev_id = DEV_COUNT;
 static uint8_t user_rail_id = DEV_MAX_RAIL_COUNT;
 static uint32_t current_lsb;
@@ -88,7 +91,7 @@ static const char ct_strings[ina230_ct_count + 1][8] = {
  */
 static void usage(void)
 {
-            printf("Usage: bdbpm [-d device] [-r rail] [-i current_lsb] [-t conversion_time] [-g avg_count] [-u refresh_rate] [-l loop] [-c] [-h]\n");
+            printf("Usage: bdbpm [-d device] [-r rail] [-i current_lsb] [-t conversion_time] [-g avg_count] [-u refresh_rate] [-l loop] [-c] [-x] [-o file] [-h]\n");
             printf("         -d: select device (SW, APB[1-3], GPB[1-2])"
 #ifdef CONFIG_ARCH_BOARD_ARA_SDB_SVC
                    ", SVC"
@@ -111,6 +114,9 @@ static void usage(void)
             printf("         -l: select number of power measurements (default: 1).\n");
             printf("         -c: select continuous power measurements mode (default: disabled).\n");
             printf("         -x: export power measurements as .csv trace instead of table.\n");
+            printf("         -o: capture power measurements in background into file\n");
+            printf("             (binary records, see bdbpm_stream.h) instead of displaying them.\n");
+            printf("             Use -u 0 to sample as fast as the conversion settings allow.\n");
             printf("         -h: print help.\n\n");
 }
 
@@ -270,10 +276,11 @@ static int bdbpm_main_get_user_options(int argc, char **argv)
     conversion_time = DEFAULT_CONVERSION_TIME;
     avg_count = DEFAULT_AVG_SAMPLE_COUNT;
     csv_export = false;
+    stream_path = NULL;
 
     dbg_verbose("%s(): retrieving user options...\n", __func__);
     optind = 1;
-    while ((c = getopt(argc, argv, "xhcd:r:l:u:i:t:n:")) != 255) {
+    while ((c = getopt(argc, argv, "xhcd:r:l:u:i:t:n:o:")) != 255) {
         switch (c) {
         case 'd':
             ret = bdbpm_device_id(optarg, &user_dev_id);
@@ -371,6 +378,11 @@ static int bdbpm_main_get_user_options(int argc, char **argv)
             printf("Using .csv format to display power measurements.\n");
             break;
 
+        case 'o':
+            stream_path = optarg;
+            printf("Capturing power measurements into %s.\n", optarg);
+            break;
+
         case 'h':
         default:
             return -EINVAL;
@@ -434,6 +446,43 @@ static int bdbpm_main_collect_measurements(void)
     return 0;
 }
 
+/**
+ * @brief           Capture power measurements of all user-selected rails
+ *                  into a file, sampling in background.
+ * @return          0 on success, standard error codes otherwise
+ */
+static int bdbpm_main_stream_measurements(void)
+{
+    bdbpm_rail *rails[DEV_COUNT * DEV_MAX_RAIL_COUNT];
+    struct bdbpm_stream_config cfg;
+    uint8_t d_start, d_end;
+    uint8_t r_start, r_end;
+    uint8_t d, r;
+    uint32_t sampling_time;
+
+    cfg.path = stream_path;
+    cfg.rails = rails;
+    cfg.rail_count = 0;
+    bdbpm_main_get_device_list(&d_start, &d_end);
+    for (d = d_start; d < d_end; d++) {
+        bdbpm_main_get_rail_list(d, &r_start, &r_end);
+        for (r = r_start; r < r_end; r++) {
+            rails[cfg.rail_count++] = bdbpm_rails[d][r];
+        }
+    }
+
+    /*
+     * Align the sampling period on the INA230 sampling time, so that each
+     * sweep reads freshly converted values.
+     */
+    sampling_time = bdbpm_get_sampling_time(rails[0]);
+    cfg.period_us = ((refresh_rate + sampling_time - 1) / sampling_time) *
+                    sampling_time;
+    cfg.sweep_count = continuous ? 0 : loopcount;
+
+    return bdbpm_stream_capture(&cfg);
+}
+
 /**
  * @brief           Init variables used for drawing table in console.
  */
@@ -645,6 +694,12 @@ int bdbpm_main(int argc, char *argv[])
         exit(ret);
     }
 
+    if (stream_path) {
+        ret = bdbpm_main_stream_measurements();
+        bdbpm_main_deinit();
+        return ret;
+    }
+
     printf("\nGetting power measurements...\n\n");
     if ((!csv_export) && ((continuous) || (loopcount > 1))) {
          /* Clear terminal */
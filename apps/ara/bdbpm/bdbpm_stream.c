@@ -0,0 +1,301 @@
+/*
+ * Copyright (c) 2015 Google Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * @file    apps/ara/bdbpm/bdbpm_stream.c
+ * @brief   BDB Power Measurement background capture engine
+ *
+ * A sampler thread sweeps all selected rails on a fixed schedule and pushes
+ * binary records into a RAM ring. The calling thread drains the ring to the
+ * output file, so that slow storage or console output never delays sampling.
+ */
+
+#include <nuttx/config.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <sched.h>
+
+#include "bdbpm_stream.h"
+
+#ifndef CONFIG_ARA_SVC_BDBPM_RING_SIZE
+#define CONFIG_ARA_SVC_BDBPM_RING_SIZE  256
+#endif
+
+#if (CONFIG_ARA_SVC_BDBPM_RING_SIZE & (CONFIG_ARA_SVC_BDBPM_RING_SIZE - 1))
+#error CONFIG_ARA_SVC_BDBPM_RING_SIZE must be a power of 2
+#endif
+
+#define RING_MASK                   (CONFIG_ARA_SVC_BDBPM_RING_SIZE - 1)
+#define SAMPLER_PRIORITY_BOOST      10
+
+static struct bdbpm_record ring[CONFIG_ARA_SVC_BDBPM_RING_SIZE];
+static volatile uint32_t ring_head;
+static volatile uint32_t ring_tail;
+static volatile bool sampler_done;
+static volatile bool sampler_stop;
+static sem_t ring_sem;
+
+static const struct bdbpm_stream_config *stream_cfg;
+static uint32_t dropped;
+static uint32_t late;
+static uint32_t sweeps;
+
+/**
+ * @brief           Return monotonic time in microseconds.
+ * @return          time in microseconds
+ */
+static uint64_t bdbpm_stream_now_us(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/**
+ * @brief           Measure all rails once and push the records in the ring.
+ * @param[in]       timestamp: sweep timestamp (us since capture start)
+ */
+static void bdbpm_stream_sweep(uint32_t timestamp)
+{
+    struct bdbpm_record *rec;
+    pwr_measure m;
+    uint8_t i;
+    int ret;
+
+    for (i = 0; i < stream_cfg->rail_count; i++) {
+        ret = bdbpm_measure_rail(stream_cfg->rails[i], &m);
+
+        if (ring_head - ring_tail == CONFIG_ARA_SVC_BDBPM_RING_SIZE) {
+            dropped++;
+            continue;
+        }
+
+        rec = &ring[ring_head & RING_MASK];
+        rec->timestamp_us = timestamp;
+        rec->sweep = (uint16_t) sweeps;
+        rec->rail_index = i;
+        if (ret) {
+            rec->flags = BDBPM_RECORD_ERROR;
+            rec->uV = rec->uA = rec->uW = 0;
+        } else {
+            rec->flags = 0;
+            rec->uV = m.uV;
+            rec->uA = m.uA;
+            rec->uW = m.uW;
+        }
+        ring_head++;
+    }
+}
+
+/**
+ * @brief           Sampler thread: sweep the rails every period.
+ *
+ * Deadlines are absolute so that the schedule does not drift with the time
+ * spent reading the rails. When a sweep overruns its slot, the missed slots
+ * are skipped (and counted) rather than sampled back to back.
+ *
+ * @return          NULL
+ * @param[in]       arg: unused
+ */
+static void *bdbpm_stream_sampler(void *arg)
+{
+    uint64_t start, next, now;
+
+    start = next = bdbpm_stream_now_us();
+    while (!sampler_stop &&
+           (stream_cfg->sweep_count == 0 || sweeps < stream_cfg->sweep_count)) {
+        bdbpm_stream_sweep((uint32_t) (next - start));
+        sweeps++;
+        sem_post(&ring_sem);
+
+        next += stream_cfg->period_us;
+        now = bdbpm_stream_now_us();
+        if (now >= next) {
+            late += (now - next) / stream_cfg->period_us + 1;
+            next += ((now - next) / stream_cfg->period_us + 1) *
+                    stream_cfg->period_us;
+        }
+        usleep((useconds_t) (next - now));
+    }
+
+    sampler_done = true;
+    sem_post(&ring_sem);
+
+    return NULL;
+}
+
+/**
+ * @brief           Write the capture file header and rail table.
+ * @return          0 on success, -EIO otherwise
+ * @param[in]       fp: output stream
+ */
+static int bdbpm_stream_write_header(FILE *fp)
+{
+    struct bdbpm_stream_header hdr;
+    struct bdbpm_stream_rail rail;
+    uint8_t i;
+
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, BDBPM_STREAM_MAGIC, sizeof(hdr.magic));
+    hdr.version = BDBPM_STREAM_VERSION;
+    hdr.record_size = sizeof(struct bdbpm_record);
+    hdr.period_us = stream_cfg->period_us;
+    hdr.sampling_time_us = bdbpm_get_sampling_time(stream_cfg->rails[0]);
+    hdr.rail_count = stream_cfg->rail_count;
+    if (fwrite(&hdr, sizeof(hdr), 1, fp) != 1) {
+        return -EIO;
+    }
+
+    for (i = 0; i < stream_cfg->rail_count; i++) {
+        memset(&rail, 0, sizeof(rail));
+        rail.dev = stream_cfg->rails[i]->dev;
+        rail.rail = stream_cfg->rails[i]->rail;
+        strncpy(rail.name, stream_cfg->rails[i]->rail_name,
+                sizeof(rail.name) - 1);
+        if (fwrite(&rail, sizeof(rail), 1, fp) != 1) {
+            return -EIO;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief           Write all the records available in the ring.
+ * @return          0 on success, -EIO otherwise
+ * @param[in]       fp: output stream
+ */
+static int bdbpm_stream_drain(FILE *fp)
+{
+    uint32_t head = ring_head;
+    uint32_t count;
+
+    while (ring_tail != head) {
+        /* Write up to the end of the ring in one go */
+        count = head - ring_tail;
+        if ((ring_tail & RING_MASK) + count > CONFIG_ARA_SVC_BDBPM_RING_SIZE) {
+            count = CONFIG_ARA_SVC_BDBPM_RING_SIZE - (ring_tail & RING_MASK);
+        }
+
+        if (fwrite(&ring[ring_tail & RING_MASK], sizeof(struct bdbpm_record),
+                   count, fp) != count) {
+            return -EIO;
+        }
+        ring_tail += count;
+    }
+
+    return fflush(fp) ? -EIO : 0;
+}
+
+/**
+ * @brief           Capture power measurements into a binary file.
+ *
+ * Blocks until cfg->sweep_count sweeps have been written (forever if 0).
+ *
+ * @return          0 on success, standard error codes otherwise
+ * @param[in]       cfg: capture configuration
+ */
+int bdbpm_stream_capture(const struct bdbpm_stream_config *cfg)
+{
+    struct sched_param param;
+    pthread_attr_t attr;
+    pthread_t sampler;
+    FILE *fp;
+    int ret;
+
+    if (!cfg || !cfg->path || !cfg->rails || !cfg->rail_count ||
+        !cfg->period_us) {
+        return -EINVAL;
+    }
+
+    fp = fopen(cfg->path, "wb");
+    if (!fp) {
+        fprintf(stderr, "failed to open %s! (%d)\n", cfg->path, errno);
+        return -errno;
+    }
+
+    stream_cfg = cfg;
+    ring_head = ring_tail = 0;
+    sampler_done = false;
+    sampler_stop = false;
+    dropped = late = sweeps = 0;
+    sem_init(&ring_sem, 0, 0);
+
+    ret = bdbpm_stream_write_header(fp);
+    if (ret) {
+        goto out;
+    }
+
+    /* Sample at a higher priority than the writer (this thread) */
+    pthread_attr_init(&attr);
+    sched_getparam(0, &param);
+    param.sched_priority += SAMPLER_PRIORITY_BOOST;
+    pthread_attr_setschedparam(&attr, &param);
+
+    ret = pthread_create(&sampler, &attr, bdbpm_stream_sampler, NULL);
+    pthread_attr_destroy(&attr);
+    if (ret) {
+        ret = -ret;
+        goto out;
+    }
+
+    printf("Capturing to %s (%u rails, %uus period)...\n",
+           cfg->path, cfg->rail_count, cfg->period_us);
+
+    while (!sampler_done || ring_tail != ring_head) {
+        while (sem_wait(&ring_sem) && errno == EINTR);
+
+        if (!ret) {
+            ret = bdbpm_stream_drain(fp);
+            if (ret) {
+                fprintf(stderr, "failed to write %s! (%d)\n", cfg->path, ret);
+                sampler_stop = true;
+            }
+        } else {
+            /* Discard what the sampler produced before it noticed the stop */
+            ring_tail = ring_head;
+        }
+    }
+
+    pthread_join(sampler, NULL);
+
+    printf("%u sweeps captured, %u records dropped, %u late sweeps.\n",
+           sweeps, dropped, late);
+
+out:
+    sem_destroy(&ring_sem);
+    fclose(fp);
+    return ret;
+}
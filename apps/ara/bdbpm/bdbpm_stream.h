@@ -0,0 +1,88 @@
+/*
+ * Copyright (c) 2015 Google Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * @file    apps/ara/bdbpm/bdbpm_stream.h
+ * @brief   BDB Power Measurement background capture engine
+ */
+
+#ifndef __BDBPM_STREAM_H__
+#define __BDBPM_STREAM_H__
+
+#include <stdint.h>
+#include <up_bdb_pm.h>
+
+#define BDBPM_STREAM_MAGIC          "BDBP"
+#define BDBPM_STREAM_VERSION        1
+
+/* Record flags */
+#define BDBPM_RECORD_ERROR          (1 << 0) /* rail read failed */
+
+/*
+ * Capture file layout (all fields little-endian):
+ *   struct bdbpm_stream_header
+ *   struct bdbpm_stream_rail[header.rail_count]
+ *   struct bdbpm_record[...] until end of file
+ */
+struct bdbpm_stream_header {
+    char magic[4];
+    uint16_t version;
+    uint16_t record_size;
+    uint32_t period_us;         /* time between two sweeps of all rails */
+    uint32_t sampling_time_us;  /* INA230 conversion * averaging time */
+    uint8_t rail_count;
+    uint8_t pad[3];
+};
+
+struct bdbpm_stream_rail {
+    uint8_t dev;
+    uint8_t rail;
+    char name[RAIL_NAME_MAX_LENGTH];
+};
+
+struct bdbpm_record {
+    uint32_t timestamp_us;      /* since capture start, wraps after ~71min */
+    uint16_t sweep;             /* sweep index, gaps reveal dropped sweeps */
+    uint8_t rail_index;         /* index in the rail table of the header */
+    uint8_t flags;
+    int32_t uV;
+    int32_t uA;
+    int32_t uW;
+};
+
+struct bdbpm_stream_config {
+    const char *path;           /* output file or character device */
+    bdbpm_rail **rails;
+    uint8_t rail_count;
+    uint32_t period_us;
+    uint32_t sweep_count;       /* 0: sample until killed */
+};
+
+int bdbpm_stream_capture(const struct bdbpm_stream_config *cfg);
+
+#endif
@@ -0,0 +1,580 @@
+/*
+ * Copyright (c) 2015 Google Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/*
+ * Greybus core benchmark
+ *
+ * The benchmark acts as the AP: it starts the Greybus core with an in-process
+ * transport backend, registers loopback drivers on CPorts 0 to N-1 and runs
+ * one thread per CPort. Each thread injects a request with
+ * greybus_rx_handler(), as the UniPro RX interrupt would, and waits for the
+ * loopback driver to send the response back through the transport.
+ *
+ * With -d, it instead floods CPort 0 with requests faster than the worker
+ * handles them, and checks that the RX queue drops the oldest ones.
+ */
+
+#include <nuttx/config.h>
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sched.h>
+#include <semaphore.h>
+
+#include <arch/byteorder.h>
+#include <nuttx/hires_tmr.h>
+#include <nuttx/util.h>
+#include <nuttx/unipro/unipro.h>
+#include <nuttx/greybus/greybus.h>
+#include <nuttx/greybus/loopback.h>
+
+#define GB_BENCH_RESPONSE_FLAG      0x80
+#define GB_BENCH_DEFAULT_CPORTS     4
+#define GB_BENCH_DEFAULT_OPS        1000
+#define GB_BENCH_HEAP_SAMPLE_US     1000
+#define GB_BENCH_FLOOD_SETTLE_US    50000
+
+struct gb_bench_transfer_request {
+    __le32 len;
+    __u8 data[0];
+};
+
+#define GB_BENCH_MAX_SIZE \
+    (CPORT_BUF_SIZE - sizeof(struct gb_operation_hdr) - \
+     sizeof(struct gb_bench_transfer_request))
+
+struct gb_bench_cport {
+    unsigned int cport;
+    pthread_t thread;
+    sem_t response_sem;
+    uint8_t *request;
+    uint16_t id;
+    uint32_t send_usec;
+    uint32_t *latency;
+    unsigned int count;
+    unsigned int errors;
+};
+
+struct gb_bench_run {
+    const char *name;
+    uint8_t type;
+    size_t size;
+    unsigned int ops;
+    unsigned int cports;
+};
+
+struct gb_bench_result {
+    unsigned int ops;
+    unsigned int errors;
+    uint32_t elapsed;
+    uint32_t p50;
+    uint32_t p99;
+    uint32_t max;
+    int heap;
+};
+
+static const struct gb_bench_run gb_bench_types[] = {
+    { .name = "ping", .type = GB_LOOPBACK_TYPE_PING },
+    { .name = "xfer", .type = GB_LOOPBACK_TYPE_TRANSFER },
+    { .name = "sink", .type = GB_LOOPBACK_TYPE_SINK },
+};
+
+static const size_t gb_bench_default_sizes[] = { 16, 256, 1024 };
+
+static struct gb_bench_cport *bench_cports;
+static unsigned int bench_cport_count;
+static struct gb_bench_run bench_run;
+static sem_t bench_done_sem;
+static bool bench_flood;
+
+static void gb_bench_backend_init(void)
+{
+}
+
+static int gb_bench_listen(unsigned int cport)
+{
+    return 0;
+}
+
+/* Messages sent by the Greybus core: responses of the loopback drivers */
+static int gb_bench_send(unsigned int cport, const void *buf, size_t len)
+{
+    const struct gb_operation_hdr *hdr = buf;
+    uint32_t now = hrt_getusec();
+    struct gb_bench_cport *ctx;
+
+    if (cport >= bench_cport_count || len < sizeof(*hdr))
+        return -EINVAL;
+
+    ctx = &bench_cports[cport];
+
+    /* Flooded requests are not waited for, only count their responses */
+    if (bench_flood) {
+        ctx->count++;
+        return 0;
+    }
+
+    if (!(hdr->type & GB_BENCH_RESPONSE_FLAG) ||
+        le16_to_cpu(hdr->id) != ctx->id) {
+        ctx->errors++;
+        return 0;
+    }
+
+    if (hdr->result)
+        ctx->errors++;
+
+    ctx->latency[ctx->count++] = now - ctx->send_usec;
+    sem_post(&ctx->response_sem);
+
+    return 0;
+}
+
+static struct gb_transport_backend gb_bench_backend = {
+    .init = gb_bench_backend_init,
+    .listen = gb_bench_listen,
+    .send = gb_bench_send,
+};
+
+static int gb_bench_setup(unsigned int cports)
+{
+    struct gb_bench_cport *ctx;
+    int retval;
+
+    if (!bench_cports) {
+        bench_cports = zalloc(unipro_cport_count() * sizeof(*bench_cports));
+        if (!bench_cports)
+            return -ENOMEM;
+
+        sem_init(&bench_done_sem, 0, 0);
+
+        retval = gb_init(&gb_bench_backend);
+        if (retval) {
+            free(bench_cports);
+            bench_cports = NULL;
+            return retval;
+        }
+    }
+
+    while (bench_cport_count < cports) {
+        ctx = &bench_cports[bench_cport_count];
+
+        ctx->request = malloc(CPORT_BUF_SIZE);
+        if (!ctx->request)
+            return -ENOMEM;
+
+        memset(ctx->request, 0x5a, CPORT_BUF_SIZE);
+        sem_init(&ctx->response_sem, 0, 0);
+        ctx->cport = bench_cport_count;
+
+        gb_loopback_register(ctx->cport);
+        gb_listen(ctx->cport);
+        bench_cport_count++;
+    }
+
+    return 0;
+}
+
+static void *gb_bench_worker(void *data)
+{
+    struct gb_bench_cport *ctx = data;
+    struct gb_operation_hdr *hdr = (struct gb_operation_hdr *) ctx->request;
+    struct gb_bench_transfer_request *request =
+        (struct gb_bench_transfer_request *) (hdr + 1);
+    size_t size = sizeof(*hdr);
+    unsigned int i;
+
+    if (bench_run.type != GB_LOOPBACK_TYPE_PING) {
+        request->len = cpu_to_le32(bench_run.size);
+        size += sizeof(*request) + bench_run.size;
+    }
+
+    hdr->size = cpu_to_le16(size);
+    hdr->type = bench_run.type;
+    hdr->result = 0;
+
+    for (i = 0; i < bench_run.ops; i++) {
+        if (++ctx->id == 0) /* ID 0 is for requests without response */
+            ctx->id = 1;
+        hdr->id = cpu_to_le16(ctx->id);
+
+        ctx->send_usec = hrt_getusec();
+        if (greybus_rx_handler(ctx->cport, ctx->request, size) < 0) {
+            ctx->errors++;
+            continue;
+        }
+
+        while (sem_wait(&ctx->response_sem) < 0 && errno == EINTR)
+            ;
+    }
+
+    sem_post(&bench_done_sem);
+    return NULL;
+}
+
+/*
+ * Queue requests on CPort 0 while the worker can't run, then check that every
+ * request accepted by the core was either handled or counted as dropped, and
+ * that some were dropped.
+ */
+static int gb_bench_flood(unsigned int ops)
+{
+    struct gb_bench_cport *ctx = &bench_cports[0];
+    struct gb_operation_hdr *hdr = (struct gb_operation_hdr *) ctx->request;
+    struct gb_rx_queue_stats before;
+    struct gb_rx_queue_stats after;
+    unsigned long dropped;
+    unsigned int handled;
+    unsigned int sent = 0;
+    unsigned int i;
+
+    if (!gb_rx_queue_get_stats(ctx->cport, &before))
+        return -EINVAL;
+
+    hdr->size = cpu_to_le16(sizeof(*hdr));
+    hdr->type = GB_LOOPBACK_TYPE_PING;
+    hdr->result = 0;
+
+    ctx->count = 0;
+    bench_flood = true;
+
+    sched_lock();
+    for (i = 0; i < ops; i++) {
+        if (++ctx->id == 0) /* ID 0 is for requests without response */
+            ctx->id = 1;
+        hdr->id = cpu_to_le16(ctx->id);
+
+        if (greybus_rx_handler(ctx->cport, ctx->request, sizeof(*hdr)) >= 0)
+            sent++;
+    }
+    sched_unlock();
+
+    /* Wait for the worker to handle what is left in the queue */
+    do {
+        handled = ctx->count;
+        usleep(GB_BENCH_FLOOD_SETTLE_US);
+    } while (handled != ctx->count);
+
+    bench_flood = false;
+
+    gb_rx_queue_get_stats(ctx->cport, &after);
+    dropped = after.dropped - before.dropped;
+
+    printf("flood: %u requests, %u handled, %lu dropped\n", sent, handled,
+           dropped);
+
+    if (!dropped || handled + dropped != sent)
+        return -EIO;
+
+    return 0;
+}
+
+static int gb_bench_heap_used(void)
+{
+#ifdef CONFIG_CAN_PASS_STRUCTS
+    struct mallinfo info = mallinfo();
+#else
+    struct mallinfo info;
+
+    mallinfo(&info);
+#endif
+    return info.uordblks;
+}
+
+static int gb_bench_compare(const void *data1, const void *data2)
+{
+    uint32_t value1 = *(const uint32_t *) data1;
+    uint32_t value2 = *(const uint32_t *) data2;
+
+    return value1 < value2 ? -1 : value1 > value2;
+}
+
+static int gb_bench_execute(struct gb_bench_result *result)
+{
+    struct gb_bench_cport *ctx;
+    uint32_t *latency;
+    unsigned int finished;
+    unsigned int started;
+    unsigned int i;
+    uint32_t start;
+    int baseline;
+    int heap;
+    int retval = 0;
+
+    memset(result, 0, sizeof(*result));
+
+    for (i = 0; i < bench_run.cports; i++) {
+        ctx = &bench_cports[i];
+        ctx->count = 0;
+        ctx->errors = 0;
+        ctx->latency = malloc(bench_run.ops * sizeof(*ctx->latency));
+        if (!ctx->latency) {
+            retval = -ENOMEM;
+            goto out;
+        }
+    }
+
+    baseline = gb_bench_heap_used();
+    result->heap = 0;
+    start = hrt_getusec();
+
+    for (started = 0; started < bench_run.cports; started++) {
+        ctx = &bench_cports[started];
+        retval = pthread_create(&ctx->thread, NULL, gb_bench_worker, ctx);
+        if (retval) {
+            retval = -retval;
+            break;
+        }
+    }
+
+    /* Sample the heap usage while the workers run */
+    for (finished = 0; finished < started;) {
+        heap = gb_bench_heap_used() - baseline;
+        if (heap > result->heap)
+            result->heap = heap;
+
+        if (!sem_trywait(&bench_done_sem))
+            finished++;
+        else
+            usleep(GB_BENCH_HEAP_SAMPLE_US);
+    }
+
+    result->elapsed = hrt_getusec() - start;
+
+    for (i = 0; i < started; i++)
+        pthread_join(bench_cports[i].thread, NULL);
+
+    if (retval)
+        goto out;
+
+    for (i = 0; i < bench_run.cports; i++) {
+        result->ops += bench_cports[i].count;
+        result->errors += bench_cports[i].errors;
+    }
+
+    if (!result->ops)
+        goto out;
+
+    latency = malloc(result->ops * sizeof(*latency));
+    if (!latency) {
+        retval = -ENOMEM;
+        goto out;
+    }
+
+    for (result->ops = 0, i = 0; i < bench_run.cports; i++) {
+        memcpy(&latency[result->ops], bench_cports[i].latency,
+               bench_cports[i].count * sizeof(*latency));
+        result->ops += bench_cports[i].count;
+    }
+
+    qsort(latency, result->ops, sizeof(*latency), gb_bench_compare);
+    result->p50 = latency[(result->ops - 1) * 50 / 100];
+    result->p99 = latency[(result->ops - 1) * 99 / 100];
+    result->max = latency[result->ops - 1];
+    free(latency);
+
+out:
+    for (i = 0; i < bench_run.cports; i++) {
+        free(bench_cports[i].latency);
+        bench_cports[i].latency = NULL;
+    }
+
+    return retval;
+}
+
+static void gb_bench_print(const struct gb_bench_result *result, bool csv)
+{
+    unsigned long ops_per_sec = 0;
+
+    if (result->elapsed)
+        ops_per_sec = (uint64_t) result->ops * 1000000 / result->elapsed;
+
+    if (csv) {
+        printf("%s,%zu,%u,%u,%lu,%u,%u,%u,%d,%u\n", bench_run.name,
+               bench_run.size, bench_run.cports, result->ops, ops_per_sec,
+               result->p50, result->p99, result->max, result->heap,
+               result->errors);
+    } else {
+        printf("%-5s %6zu %6u %8u %8lu %8u %8u %8u %8d %6u\n", bench_run.name,
+               bench_run.size, bench_run.cports, result->ops, ops_per_sec,
+               result->p50, result->p99, result->max, result->heap,
+               result->errors);
+    }
+}
+
+static void gb_bench_print_header(bool csv)
+{
+    if (csv) {
+        printf("; generated by gbbench\n");
+        printf("; type, size, cports, operations, operations per second, "
+               "latency p50, p99, max (us), heap high-water (bytes), "
+               "errors\n");
+    } else {
+        printf("%-5s %6s %6s %8s %8s %8s %8s %8s %8s %6s\n", "type", "size",
+               "cports", "ops", "ops/s", "p50 us", "p99 us", "max us",
+               "heap B", "errors");
+    }
+}
+
+static int gb_bench_type_from_str(const char *str)
+{
+    int i;
+
+    for (i = 0; i < ARRAY_SIZE(gb_bench_types); i++) {
+        if (!strcmp(str, gb_bench_types[i].name))
+            return i;
+    }
+
+    return -1;
+}
+
+static void gb_bench_usage(void)
+{
+    printf("Usage: gbbench [-c cports] [-n ops] [-t ping|xfer|sink] "
+           "[-s size] [-f csv] [-d]\n");
+    printf("  -c: number of CPorts driven concurrently (default %d)\n",
+           GB_BENCH_DEFAULT_CPORTS);
+    printf("  -n: number of operations per CPort (default %d)\n",
+           GB_BENCH_DEFAULT_OPS);
+    printf("  -t: operation type (default: all of them)\n");
+    printf("  -s: payload size, up to %zu bytes (default: %zu, %zu and %zu)\n",
+           GB_BENCH_MAX_SIZE, gb_bench_default_sizes[0],
+           gb_bench_default_sizes[1], gb_bench_default_sizes[2]);
+    printf("  -f: output format, 'csv' for comma separated values\n");
+    printf("  -d: flood CPort 0 with ops requests and check that the oldest "
+           "get dropped\n");
+}
+
+#ifdef CONFIG_BUILD_KERNEL
+int main(int argc, FAR char *argv[])
+#else
+int gbbench_main(int argc, char *argv[])
+#endif
+{
+    struct gb_bench_result result;
+    unsigned int cports = GB_BENCH_DEFAULT_CPORTS;
+    unsigned int ops = GB_BENCH_DEFAULT_OPS;
+    size_t size = 0;
+    bool csv = false;
+    bool flood = false;
+    int type = -1;
+    int opt;
+    int retval;
+    int i;
+    int j;
+
+    optind = -1;
+    while ((opt = getopt(argc, argv, "c:n:t:s:f:d")) != -1) {
+        switch (opt) {
+        case 'c':
+            cports = strtoul(optarg, NULL, 10);
+            break;
+        case 'n':
+            ops = strtoul(optarg, NULL, 10);
+            break;
+        case 't':
+            type = gb_bench_type_from_str(optarg);
+            if (type < 0)
+                goto help;
+            break;
+        case 's':
+            size = strtoul(optarg, NULL, 10);
+            break;
+        case 'f':
+            csv = !strcmp(optarg, "csv");
+            break;
+        case 'd':
+            flood = true;
+            break;
+        default:
+            goto help;
+        }
+    }
+
+    if (!cports || cports > unipro_cport_count() || !ops ||
+        size > GB_BENCH_MAX_SIZE)
+        goto help;
+
+    retval = gb_bench_setup(cports);
+    if (retval) {
+        fprintf(stderr, "cannot set up the Greybus core: %d\n", retval);
+        return EXIT_FAILURE;
+    }
+
+    if (flood) {
+        retval = gb_bench_flood(ops);
+        if (retval)
+            fprintf(stderr, "flood: check failed: %d\n", retval);
+        return retval ? EXIT_FAILURE : EXIT_SUCCESS;
+    }
+
+    gb_bench_print_header(csv);
+
+    for (i = 0; i < ARRAY_SIZE(gb_bench_types); i++) {
+        if (type >= 0 && type != i)
+            continue;
+
+        for (j = 0; j < ARRAY_SIZE(gb_bench_default_sizes); j++) {
+            bench_run = gb_bench_types[i];
+            bench_run.ops = ops;
+            bench_run.cports = cports;
+
+            if (bench_run.type == GB_LOOPBACK_TYPE_PING)
+                bench_run.size = 0;
+            else if (size)
+                bench_run.size = size;
+            else
+                bench_run.size = gb_bench_default_sizes[j];
+
+            retval = gb_bench_execute(&result);
+            if (retval) {
+                fprintf(stderr, "%s: benchmark failed: %d\n", bench_run.name,
+                        retval);
+                return EXIT_FAILURE;
+            }
+
+            gb_bench_print(&result, csv);
+
+            /* Ping has no payload, and -s selects a single size */
+            if (bench_run.type == GB_LOOPBACK_TYPE_PING || size)
+                break;
+        }
+    }
+
+    return EXIT_SUCCESS;
+
+help:
+    gb_bench_usage();
+    return EXIT_FAILURE;
+}
@@ -29,17 +29,46 @@
  */
 
 #include <getopt.h>
+#include <stdbool.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include <nuttx/greybus/tape.h>
 
 static void show_usage(const char *appname)
 {
-    printf("%s [-r filepath] [-p filepath]\n", appname);
+    printf("%s [-z] [-r filepath] [-s] [-t] [-o offset] [-p filepath] "
+           "[-i filepath]\n", appname);
     printf("\t-r: tape greybus communication into 'filepath'\n");
+    printf("\t-z: compress the tape being recorded\n");
     printf("\t-s: stop current taping\n");
     printf("\t-p: replay greybus tape from 'filepath'\n");
+    printf("\t-t: replay with the recorded timing instead of max speed\n");
+    printf("\t-o: start replaying 'offset' ms into the tape\n");
+    printf("\t-i: show information about the tape 'filepath'\n");
+}
+
+static int show_info(const char *pathname)
+{
+    struct gb_tape_info info;
+    int retval;
+
+    retval = gb_tape_get_info(pathname, &info);
+    if (retval)
+        return retval;
+
+    printf("version: %u%s\n", info.version,
+           info.flags & GB_TAPE_COMPRESS ? " (compressed)" : "");
+    if (info.version < 2)
+        return 0;
+
+    printf("records: %u\n", info.records);
+    printf("dropped: %u\n", info.dropped);
+    printf("duration: %u ms\n", info.duration / 1000);
+    printf("index entries: %u\n", info.index_entries);
+
+    return 0;
 }
 
 #ifdef CONFIG_BUILD_KERNEL
@@ -48,6 +77,13 @@ int main(int argc, FAR char *argv[])
 int gb_tape_main(int argc, char *argv[])
 #endif
 {
+    enum gb_tape_replay_mode mode = GB_TAPE_REPLAY_MAX_SPEED;
+    const char *record_path = NULL;
+    const char *replay_path = NULL;
+    const char *info_path = NULL;
+    uint32_t start_ms = 0;
+    bool stop = false;
+    int flags = 0;
     int c;
     int retval;
 
@@ -60,30 +96,34 @@ int gb_tape_main(int argc, char *argv[])
 
     gb_tape_arm_semihosting_register();
 
-    while ((c = getopt(argc, argv, "r:p:s")) != -1) {
+    while ((c = getopt(argc, argv, "r:p:i:o:szt")) != -1) {
         switch (c) {
         case 'r':
-            retval = gb_tape_communication(optarg);
-            if (retval) {
-                fprintf(stderr, "gb_tape: taping error: %s\n",
-                        strerror(retval));
-            }
+            record_path = optarg;
+            break;
+
+        case 'z':
+            flags |= GB_TAPE_COMPRESS;
             break;
 
         case 's':
-            retval = gb_tape_stop();
-            if (retval) {
-                fprintf(stderr, "gb_tape: stop taping error: %s\n",
-                        strerror(retval));
-            }
+            stop = true;
             break;
 
         case 'p':
-            retval = gb_tape_replay(optarg);
-            if (retval) {
-                fprintf(stderr, "gb_tape: tape replay error: %s\n",
-                        strerror(retval));
-            }
+            replay_path = optarg;
+            break;
+
+        case 't':
+            mode = GB_TAPE_REPLAY_REALTIME;
+            break;
+
+        case 'o':
+            start_ms = strtoul(optarg, NULL, 0);
+            break;
+
+        case 'i':
+            info_path = optarg;
             break;
 
         case '?':
@@ -94,5 +134,37 @@ int gb_tape_main(int argc, char *argv[])
         }
     }
 
+    if (stop) {
+        retval = gb_tape_stop();
+        if (retval) {
+            fprintf(stderr, "gb_tape: stop taping error: %s\n",
+                    strerror(-retval));
+        }
+    }
+
+    if (info_path) {
+        retval = show_info(info_path);
+        if (retval) {
+            fprintf(stderr, "gb_tape: tape info error: %s\n",
+                    strerror(-retval));
+        }
+    }
+
+    if (record_path) {
+        retval = gb_tape_communication(record_path, flags);
+        if (retval) {
+            fprintf(stderr, "gb_tape: taping error: %s\n",
+                    strerror(-retval));
+        }
+    }
+
+    if (replay_path) {
+        retval = gb_tape_replay_mode(replay_path, mode, start_ms);
+        if (retval) {
+            fprintf(stderr, "gb_tape: tape replay error: %s\n",
+                    strerror(-retval));
+        }
+    }
+
     return 0;
 }
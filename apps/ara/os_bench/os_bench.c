@@ -0,0 +1,828 @@
+/*
+ * Copyright (c) 2015 Google Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * OS services benchmark
+ *
+ * Each test exercises one kernel service the way the Greybus stack loads it
+ * and reports its cost, measured with the high resolution timer. Results
+ * are meant to be compared between builds with different kernel options.
+ */
+
+#include <nuttx/config.h>
+
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <semaphore.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+
+#include <nuttx/hires_tmr.h>
+#include <nuttx/util.h>
+#include <nuttx/wdog.h>
+#include <nuttx/wqueue.h>
+
+#define OS_BENCH_WDOG_PROBES        256
+#define OS_BENCH_WDOG_BATCH         64
+/* Armed watchdogs expire between 1x and 2x this many ticks from now */
+#define OS_BENCH_WDOG_FAR_TICKS     10000
+
+#define OS_BENCH_CTXSW_ROUNDS       1000
+
+#define OS_BENCH_MUTEX_ROUNDS       10000
+#define OS_BENCH_MUTEX_HANDOFFS     1000
+#define OS_BENCH_MUTEX_ALLOC_SIZE   64
+
+/* Stands for a flash erase: the worker thread is blocked, not spinning */
+#define OS_BENCH_WORK_SLOW_USEC     20000
+
+struct os_bench_test {
+    const char *name;
+    int (*run)(unsigned int size, bool csv);
+    const unsigned int *sizes;
+    size_t nsizes;
+};
+
+struct os_bench_wdog_result {
+    uint32_t start_sum;
+    uint32_t start_max;
+    uint32_t cancel_sum;
+    uint32_t cancel_max;
+    uint32_t expiry;
+};
+
+struct os_bench_ctxsw {
+    sem_t ping;                 /* benchmark -> partner */
+    sem_t wake;                 /* benchmark -> waiter */
+    sem_t done;                 /* waiter -> benchmark */
+    volatile uint32_t ran_usec;
+    volatile bool stop;
+};
+
+struct os_bench_ctxsw_result {
+    uint32_t switch_sum;
+    uint32_t switch_max;
+    uint32_t wake_sum;
+    uint32_t wake_max;
+};
+
+struct os_bench_mutex {
+    pthread_mutex_t mutex;
+    sem_t go;                   /* benchmark -> waiters */
+    volatile bool stop;
+};
+
+struct os_bench_mutex_result {
+    uint32_t mutex_usec;
+    uint32_t sem_usec;
+    uint32_t malloc_usec;
+    uint32_t handoff_usec;
+};
+
+#ifdef CONFIG_SCHED_WORKQUEUE
+struct os_bench_work_item {
+    struct work_s work;
+    struct os_bench_work *ctx;
+    uint32_t queued_usec;
+};
+
+struct os_bench_work {
+    struct os_bench_work_item slow;
+    struct os_bench_work_item *items;
+    sem_t done;                 /* work items -> benchmark */
+    uint32_t latency_sum;
+    uint32_t latency_max;
+};
+#endif
+
+static const unsigned int os_bench_wdog_sizes[] = { 16, 256, 1024, 4096 };
+/* Bounded by CONFIG_MAX_TASKS */
+static const unsigned int os_bench_ctxsw_sizes[] = { 0, 8, 32, 48 };
+static const unsigned int os_bench_mutex_sizes[] = { 0, 1, 4, 16 };
+#ifdef CONFIG_SCHED_WORKQUEUE
+static const unsigned int os_bench_work_sizes[] = { 1, 8, 32 };
+#endif
+
+static volatile unsigned int wdog_fired;
+static volatile uint32_t wdog_first_usec;
+static volatile uint32_t wdog_last_usec;
+
+static void os_bench_wdog_far(int argc, uint32_t arg)
+{
+    /* Armed watchdogs are deleted before they can expire */
+}
+
+static void os_bench_wdog_expired(int argc, uint32_t arg)
+{
+    uint32_t now = hrt_getusec();
+
+    if (!wdog_fired++)
+        wdog_first_usec = now;
+    wdog_last_usec = now;
+}
+
+static int os_bench_wdog_measure(WDOG_ID *wdogs, unsigned int count,
+                                 struct os_bench_wdog_result *result)
+{
+    WDOG_ID probe;
+    uint32_t t0, t1, t2;
+    unsigned int i;
+    int retries;
+
+    probe = wd_create();
+    if (!probe)
+        return -ENOMEM;
+
+    /*
+     * wd_start() and wd_cancel() run entirely with interrupts disabled,
+     * so the time spent in each call bounds the interrupt latency they
+     * add.
+     */
+    for (i = 0; i < OS_BENCH_WDOG_PROBES; i++) {
+        int delay = OS_BENCH_WDOG_FAR_TICKS +
+                    rand() % OS_BENCH_WDOG_FAR_TICKS;
+
+        t0 = hrt_getusec();
+        wd_start(probe, delay, (wdentry_t) os_bench_wdog_far, 1, i);
+        t1 = hrt_getusec();
+        wd_cancel(probe);
+        t2 = hrt_getusec();
+
+        result->start_sum += t1 - t0;
+        result->cancel_sum += t2 - t1;
+        if (t1 - t0 > result->start_max)
+            result->start_max = t1 - t0;
+        if (t2 - t1 > result->cancel_max)
+            result->cancel_max = t2 - t1;
+    }
+
+    wd_delete(probe);
+
+    /*
+     * Let a batch of the armed watchdogs expire on the same tick: the
+     * timer interrupt runs them back to back with interrupts disabled.
+     */
+    wdog_fired = 0;
+    count = MIN(count, OS_BENCH_WDOG_BATCH);
+    for (i = 0; i < count; i++)
+        wd_start(wdogs[i], 1, (wdentry_t) os_bench_wdog_expired, 1, i);
+
+    for (retries = 100; wdog_fired < count && retries; retries--)
+        usleep(10000);
+
+    if (wdog_fired < count)
+        return -ETIMEDOUT;
+
+    result->expiry = wdog_last_usec - wdog_first_usec;
+    return 0;
+}
+
+static int os_bench_wdog(unsigned int count, bool csv)
+{
+    struct os_bench_wdog_result result;
+    WDOG_ID *wdogs;
+    unsigned int armed;
+    int retval = 0;
+
+    wdogs = zalloc(count * sizeof(*wdogs));
+    if (!wdogs)
+        return -ENOMEM;
+
+    memset(&result, 0, sizeof(result));
+
+    for (armed = 0; armed < count; armed++) {
+        wdogs[armed] = wd_create();
+        if (!wdogs[armed]) {
+            retval = -ENOMEM;
+            goto out;
+        }
+
+        wd_start(wdogs[armed],
+                 OS_BENCH_WDOG_FAR_TICKS + rand() % OS_BENCH_WDOG_FAR_TICKS,
+                 (wdentry_t) os_bench_wdog_far, 1, armed);
+    }
+
+    retval = os_bench_wdog_measure(wdogs, count, &result);
+    if (retval)
+        goto out;
+
+    if (csv) {
+        printf("wdog,%u,%u,%u,%u,%u,%u,%u\n", count,
+               result.start_sum * 1000 / OS_BENCH_WDOG_PROBES,
+               result.start_max,
+               result.cancel_sum * 1000 / OS_BENCH_WDOG_PROBES,
+               result.cancel_max, MIN(count, OS_BENCH_WDOG_BATCH),
+               result.expiry);
+    } else {
+        printf("%-6s %6u %10u %9u %10u %9u %6u %9u\n", "wdog", count,
+               result.start_sum * 1000 / OS_BENCH_WDOG_PROBES,
+               result.start_max,
+               result.cancel_sum * 1000 / OS_BENCH_WDOG_PROBES,
+               result.cancel_max, MIN(count, OS_BENCH_WDOG_BATCH),
+               result.expiry);
+    }
+
+out:
+    while (armed > 0)
+        wd_delete(wdogs[--armed]);
+    free(wdogs);
+    return retval;
+}
+
+static void *os_bench_ctxsw_partner(void *data)
+{
+    struct os_bench_ctxsw *ctx = data;
+
+    for (;;) {
+        sem_wait(&ctx->ping);
+        if (ctx->stop)
+            break;
+        ctx->ran_usec = hrt_getusec();
+    }
+
+    return NULL;
+}
+
+static void *os_bench_ctxsw_waiter(void *data)
+{
+    struct os_bench_ctxsw *ctx = data;
+
+    for (;;) {
+        sem_wait(&ctx->wake);
+        if (ctx->stop)
+            break;
+        sem_post(&ctx->done);
+    }
+
+    return NULL;
+}
+
+static void *os_bench_ctxsw_filler(void *data)
+{
+    struct os_bench_ctxsw *ctx = data;
+
+    /* Stay in the ready-to-run list until the test is over */
+    while (!ctx->stop)
+        sched_yield();
+
+    return NULL;
+}
+
+static int os_bench_ctxsw_spawn(pthread_t *thread, int priority,
+                                void *(*entry)(void *), void *data)
+{
+    struct sched_param param;
+    pthread_attr_t attr;
+    int retval;
+
+    pthread_attr_init(&attr);
+    param.sched_priority = priority;
+    pthread_attr_setschedparam(&attr, &param);
+    retval = pthread_create(thread, &attr, entry, data);
+    pthread_attr_destroy(&attr);
+
+    return -retval;
+}
+
+static void os_bench_ctxsw_measure(struct os_bench_ctxsw *ctx,
+                                   struct os_bench_ctxsw_result *result)
+{
+    uint32_t t0, t1;
+    int i;
+
+    /*
+     * The partner has a higher priority than we do, so posting its
+     * semaphore switches to it immediately and it switches straight back
+     * when it blocks again: the time until it runs is the wakeup plus
+     * context switch latency.
+     */
+    for (i = 0; i < OS_BENCH_CTXSW_ROUNDS; i++) {
+        t0 = hrt_getusec();
+        sem_post(&ctx->ping);
+        t1 = ctx->ran_usec - t0;
+
+        result->switch_sum += t1;
+        if (t1 > result->switch_max)
+            result->switch_max = t1;
+    }
+
+    /*
+     * The waiter has the same priority as the fillers, so waking it
+     * appends it behind all of them in the ready-to-run list. sem_post()
+     * does not switch, so its duration is the cost of that insertion.
+     */
+    for (i = 0; i < OS_BENCH_CTXSW_ROUNDS; i++) {
+        t0 = hrt_getusec();
+        sem_post(&ctx->wake);
+        t1 = hrt_getusec() - t0;
+
+        result->wake_sum += t1;
+        if (t1 > result->wake_max)
+            result->wake_max = t1;
+
+        sem_wait(&ctx->done);
+    }
+}
+
+static int os_bench_ctxsw(unsigned int nready, bool csv)
+{
+    struct os_bench_ctxsw_result result;
+    struct os_bench_ctxsw ctx;
+    struct sched_param param;
+    pthread_t *fillers;
+    pthread_t partner;
+    pthread_t waiter;
+    unsigned int nfillers = 0;
+    int priority;
+    int retval;
+
+    retval = sched_getparam(0, &param);
+    if (retval)
+        return -errno;
+
+    /* Run above the fillers, with room for the partner above us */
+    priority = param.sched_priority;
+    if (priority + 2 > SCHED_PRIORITY_MAX)
+        return -EINVAL;
+
+    fillers = zalloc((nready + 1) * sizeof(*fillers));
+    if (!fillers)
+        return -ENOMEM;
+
+    memset(&ctx, 0, sizeof(ctx));
+    memset(&result, 0, sizeof(result));
+    sem_init(&ctx.ping, 0, 0);
+    sem_init(&ctx.wake, 0, 0);
+    sem_init(&ctx.done, 0, 0);
+
+    param.sched_priority = priority + 1;
+    sched_setparam(0, &param);
+
+    retval = os_bench_ctxsw_spawn(&partner, priority + 2,
+                                  os_bench_ctxsw_partner, &ctx);
+    if (retval)
+        goto out_partner;
+
+    retval = os_bench_ctxsw_spawn(&waiter, priority,
+                                  os_bench_ctxsw_waiter, &ctx);
+    if (retval)
+        goto out_waiter;
+
+    for (; nfillers < nready; nfillers++) {
+        retval = os_bench_ctxsw_spawn(&fillers[nfillers], priority,
+                                      os_bench_ctxsw_filler, &ctx);
+        if (retval)
+            goto out;
+    }
+
+    os_bench_ctxsw_measure(&ctx, &result);
+
+    if (csv) {
+        printf("ctxsw,%u,%u,%u,%u,%u\n", nready,
+               result.switch_sum * 1000 / OS_BENCH_CTXSW_ROUNDS,
+               result.switch_max,
+               result.wake_sum * 1000 / OS_BENCH_CTXSW_ROUNDS,
+               result.wake_max);
+    } else {
+        printf("%-6s %6u %10u %10u %10u %9u\n", "ctxsw", nready,
+               result.switch_sum * 1000 / OS_BENCH_CTXSW_ROUNDS,
+               result.switch_max,
+               result.wake_sum * 1000 / OS_BENCH_CTXSW_ROUNDS,
+               result.wake_max);
+    }
+
+out:
+    /* Joining blocks us, which lets the fillers run and see the flag */
+    ctx.stop = true;
+    while (nfillers > 0)
+        pthread_join(fillers[--nfillers], NULL);
+    sem_post(&ctx.wake);
+    pthread_join(waiter, NULL);
+out_waiter:
+    ctx.stop = true;
+    sem_post(&ctx.ping);
+    pthread_join(partner, NULL);
+out_partner:
+    param.sched_priority = priority;
+    sched_setparam(0, &param);
+    sem_destroy(&ctx.done);
+    sem_destroy(&ctx.wake);
+    sem_destroy(&ctx.ping);
+    free(fillers);
+    return retval;
+}
+
+static void *os_bench_mutex_waiter(void *data)
+{
+    struct os_bench_mutex *ctx = data;
+
+    for (;;) {
+        sem_wait(&ctx->go);
+        if (ctx->stop)
+            break;
+        pthread_mutex_lock(&ctx->mutex);
+        pthread_mutex_unlock(&ctx->mutex);
+    }
+
+    return NULL;
+}
+
+static void os_bench_mutex_measure(struct os_bench_mutex *ctx,
+                                   unsigned int nwaiters,
+                                   struct os_bench_mutex_result *result)
+{
+    sem_t sem;
+    void *ptr;
+    uint32_t t0;
+    unsigned int i;
+    unsigned int j;
+
+    /* Uncontended: the cost every pthread mutex user pays */
+    t0 = hrt_getusec();
+    for (i = 0; i < OS_BENCH_MUTEX_ROUNDS; i++) {
+        pthread_mutex_lock(&ctx->mutex);
+        pthread_mutex_unlock(&ctx->mutex);
+    }
+    result->mutex_usec = hrt_getusec() - t0;
+
+    /* The Greybus locks are semaphores used as mutexes */
+    sem_init(&sem, 0, 1);
+    t0 = hrt_getusec();
+    for (i = 0; i < OS_BENCH_MUTEX_ROUNDS; i++) {
+        sem_wait(&sem);
+        sem_post(&sem);
+    }
+    result->sem_usec = hrt_getusec() - t0;
+    sem_destroy(&sem);
+
+    /*
+     * Each allocation takes and gives the heap lock, which disables
+     * interrupts; the mutex fast path does not change it.
+     */
+    t0 = hrt_getusec();
+    for (i = 0; i < OS_BENCH_MUTEX_ROUNDS; i++) {
+        ptr = malloc(OS_BENCH_MUTEX_ALLOC_SIZE);
+        free(ptr);
+    }
+    result->malloc_usec = hrt_getusec() - t0;
+
+    if (!nwaiters)
+        return;
+
+    /*
+     * The waiters have a higher priority than we do, so they block on the
+     * mutex we hold as soon as they are released, boosting us. Unlocking
+     * then hands the mutex down the chain of waiters, and we only run
+     * again once the last of them has released it.
+     */
+    for (i = 0; i < OS_BENCH_MUTEX_HANDOFFS; i++) {
+        pthread_mutex_lock(&ctx->mutex);
+        for (j = 0; j < nwaiters; j++)
+            sem_post(&ctx->go);
+
+        t0 = hrt_getusec();
+        pthread_mutex_unlock(&ctx->mutex);
+        result->handoff_usec += hrt_getusec() - t0;
+    }
+}
+
+static int os_bench_mutex(unsigned int nwaiters, bool csv)
+{
+    struct os_bench_mutex_result result;
+    struct os_bench_mutex ctx;
+    struct sched_param param;
+    pthread_t *waiters;
+    unsigned int nspawned = 0;
+    uint32_t handoff_ns = 0;
+    int retval;
+
+    retval = sched_getparam(0, &param);
+    if (retval)
+        return -errno;
+
+    if (param.sched_priority + 1 > SCHED_PRIORITY_MAX)
+        return -EINVAL;
+
+    waiters = zalloc((nwaiters + 1) * sizeof(*waiters));
+    if (!waiters)
+        return -ENOMEM;
+
+    memset(&ctx, 0, sizeof(ctx));
+    memset(&result, 0, sizeof(result));
+    pthread_mutex_init(&ctx.mutex, NULL);
+    sem_init(&ctx.go, 0, 0);
+
+    for (; nspawned < nwaiters; nspawned++) {
+        retval = os_bench_ctxsw_spawn(&waiters[nspawned],
+                                      param.sched_priority + 1,
+                                      os_bench_mutex_waiter, &ctx);
+        if (retval)
+            goto out;
+    }
+
+    os_bench_mutex_measure(&ctx, nwaiters, &result);
+
+    if (nwaiters) {
+        handoff_ns = result.handoff_usec * 1000 /
+                     (OS_BENCH_MUTEX_HANDOFFS * nwaiters);
+    }
+
+    if (csv) {
+        printf("mutex,%u,%u,%u,%u,%u\n", nwaiters,
+               result.mutex_usec * 1000 / OS_BENCH_MUTEX_ROUNDS,
+               result.sem_usec * 1000 / OS_BENCH_MUTEX_ROUNDS,
+               result.malloc_usec * 1000 / OS_BENCH_MUTEX_ROUNDS,
+               handoff_ns);
+    } else {
+        printf("%-6s %6u %10u %10u %10u %10u\n", "mutex", nwaiters,
+               result.mutex_usec * 1000 / OS_BENCH_MUTEX_ROUNDS,
+               result.sem_usec * 1000 / OS_BENCH_MUTEX_ROUNDS,
+               result.malloc_usec * 1000 / OS_BENCH_MUTEX_ROUNDS,
+               handoff_ns);
+    }
+
+out:
+    ctx.stop = true;
+    while (nspawned > 0) {
+        sem_post(&ctx.go);
+        pthread_join(waiters[--nspawned], NULL);
+    }
+    sem_destroy(&ctx.go);
+    pthread_mutex_destroy(&ctx.mutex);
+    free(waiters);
+    return retval;
+}
+
+#ifdef CONFIG_SCHED_WORKQUEUE
+static void os_bench_work_slow(void *data)
+{
+    struct os_bench_work_item *item = data;
+
+    usleep(OS_BENCH_WORK_SLOW_USEC);
+    sem_post(&item->ctx->done);
+}
+
+static void os_bench_work_quick(void *data)
+{
+    struct os_bench_work_item *item = data;
+    struct os_bench_work *ctx = item->ctx;
+    uint32_t latency = hrt_getusec() - item->queued_usec;
+
+    ctx->latency_sum += latency;
+    if (latency > ctx->latency_max)
+        ctx->latency_max = latency;
+
+    sem_post(&ctx->done);
+}
+
+static int os_bench_work(unsigned int nitems, bool csv)
+{
+    struct os_bench_work ctx;
+    uint32_t exec_max = 0;
+    unsigned int i;
+    int retval;
+
+#ifdef CONFIG_SCHED_WORKSTATS
+    struct work_stats_s stats;
+
+    /* Only count the work queued below */
+    work_stats(LPWORK, &stats);
+#endif
+
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.items = zalloc(nitems * sizeof(*ctx.items));
+    if (!ctx.items)
+        return -ENOMEM;
+
+    sem_init(&ctx.done, 0, 0);
+
+    /*
+     * Queue work that keeps a worker thread blocked for a while, then
+     * short work behind it. With a single worker thread, the short work
+     * has to wait for the slow one to finish.
+     */
+    ctx.slow.ctx = &ctx;
+    retval = work_queue(LPWORK, &ctx.slow.work, os_bench_work_slow,
+                        &ctx.slow, 0);
+    if (retval)
+        goto out;
+
+    for (i = 0; i < nitems; i++) {
+        ctx.items[i].ctx = &ctx;
+        ctx.items[i].queued_usec = hrt_getusec();
+        retval = work_queue(LPWORK, &ctx.items[i].work, os_bench_work_quick,
+                            &ctx.items[i], 0);
+        if (retval)
+            break;
+    }
+
+    /* Wait for everything that was queued, even after a failure */
+    for (nitems = i + 1; nitems > 0; nitems--)
+        sem_wait(&ctx.done);
+
+    if (retval)
+        goto out;
+
+#ifdef CONFIG_SCHED_WORKSTATS
+    work_stats(LPWORK, &stats);
+    exec_max = stats.exec_max;
+#endif
+
+    if (csv) {
+        printf("work,%u,%u,%u,%u\n", i, ctx.latency_sum / i,
+               ctx.latency_max, exec_max);
+    } else {
+        printf("%-6s %6u %10u %10u %10u\n", "work", i,
+               ctx.latency_sum / i, ctx.latency_max, exec_max);
+    }
+
+out:
+    sem_destroy(&ctx.done);
+    free(ctx.items);
+    return retval;
+}
+#endif
+
+static const struct os_bench_test os_bench_tests[] = {
+    {
+        .name = "wdog",
+        .run = os_bench_wdog,
+        .sizes = os_bench_wdog_sizes,
+        .nsizes = ARRAY_SIZE(os_bench_wdog_sizes),
+    },
+    {
+        .name = "ctxsw",
+        .run = os_bench_ctxsw,
+        .sizes = os_bench_ctxsw_sizes,
+        .nsizes = ARRAY_SIZE(os_bench_ctxsw_sizes),
+    },
+    {
+        .name = "mutex",
+        .run = os_bench_mutex,
+        .sizes = os_bench_mutex_sizes,
+        .nsizes = ARRAY_SIZE(os_bench_mutex_sizes),
+    },
+#ifdef CONFIG_SCHED_WORKQUEUE
+    {
+        .name = "work",
+        .run = os_bench_work,
+        .sizes = os_bench_work_sizes,
+        .nsizes = ARRAY_SIZE(os_bench_work_sizes),
+    },
+#endif
+};
+
+static void os_bench_print_header(const struct os_bench_test *test, bool csv)
+{
+    if (!strcmp(test->name, "wdog")) {
+        if (csv) {
+            printf("; generated by osbench\n");
+            printf("; test, armed watchdogs, wd_start avg (ns), max (us), "
+                   "wd_cancel avg (ns), max (us), expired batch, "
+                   "batch run time (us)\n");
+        } else {
+            printf("%-6s %6s %10s %9s %10s %9s %6s %9s\n", "test", "armed",
+                   "start ns", "start max", "cancel ns", "cancel max",
+                   "batch", "expiry us");
+        }
+    } else if (!strcmp(test->name, "ctxsw")) {
+        if (csv) {
+            printf("; generated by osbench\n");
+            printf("; test, ready tasks, switch avg (ns), max (us), "
+                   "wakeup avg (ns), max (us)\n");
+        } else {
+            printf("%-6s %6s %10s %10s %10s %9s\n", "test", "ready",
+                   "switch ns", "switch max", "wakeup ns", "wake max");
+        }
+    } else if (!strcmp(test->name, "mutex")) {
+        if (csv) {
+            printf("; generated by osbench\n");
+            printf("; test, waiters, mutex lock+unlock (ns), "
+                   "sem wait+post (ns), malloc+free (ns), handoff (ns)\n");
+        } else {
+            printf("%-6s %6s %10s %10s %10s %10s\n", "test", "wait",
+                   "mutex ns", "sem ns", "malloc ns", "handoff ns");
+        }
+    } else if (!strcmp(test->name, "work")) {
+        if (csv) {
+            printf("; generated by osbench\n");
+            printf("; test, work items, latency avg (us), max (us), "
+                   "slowest work (us)\n");
+        } else {
+            printf("%-6s %6s %10s %10s %10s\n", "test", "items",
+                   "latency us", "lat max", "slowest us");
+        }
+    }
+}
+
+static void os_bench_usage(void)
+{
+    int i;
+
+    printf("Usage: osbench [-t test] [-n size] [-f csv]\n");
+    printf("  -t: test to run (default: all of them):");
+    for (i = 0; i < ARRAY_SIZE(os_bench_tests); i++)
+        printf(" %s", os_bench_tests[i].name);
+    printf("\n");
+    printf("  -n: test size, e.g. number of armed watchdogs for 'wdog'\n"
+           "      or of ready-to-run tasks for 'ctxsw'\n"
+           "      or of threads waiting for the mutex for 'mutex'\n"
+           "      or of work items queued behind a slow one for 'work'\n"
+           "      (default: a range of sizes)\n");
+    printf("  -f: output format, 'csv' for comma separated values\n");
+}
+
+#ifdef CONFIG_BUILD_KERNEL
+int main(int argc, FAR char *argv[])
+#else
+int osbench_main(int argc, char *argv[])
+#endif
+{
+    const struct os_bench_test *test;
+    const char *name = NULL;
+    unsigned int size = 0;
+    bool csv = false;
+    bool ran = false;
+    int opt;
+    int retval;
+    int i;
+    int j;
+
+    optind = -1;
+    while ((opt = getopt(argc, argv, "t:n:f:")) != -1) {
+        switch (opt) {
+        case 't':
+            name = optarg;
+            break;
+        case 'n':
+            size = strtoul(optarg, NULL, 10);
+            break;
+        case 'f':
+            csv = !strcmp(optarg, "csv");
+            break;
+        default:
+            goto help;
+        }
+    }
+
+    for (i = 0; i < ARRAY_SIZE(os_bench_tests); i++) {
+        test = &os_bench_tests[i];
+        if (name && strcmp(name, test->name))
+            continue;
+
+        ran = true;
+        os_bench_print_header(test, csv);
+
+        for (j = 0; j < test->nsizes; j++) {
+            retval = test->run(size ? size : test->sizes[j], csv);
+            if (retval) {
+                fprintf(stderr, "%s: benchmark failed: %d\n", test->name,
+                        retval);
+                return EXIT_FAILURE;
+            }
+
+            /* -n selects a single size */
+            if (size)
+                break;
+        }
+    }
+
+    if (!ran)
+        goto help;
+
+    return EXIT_SUCCESS;
+
+help:
+    os_bench_usage();
+    return EXIT_FAILURE;
+}
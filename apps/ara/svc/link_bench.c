@@ -0,0 +1,202 @@
+/*
+ * Copyright (c) 2015 Google Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <nuttx/config.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+#include "link_bench.h"
+
+/*
+ * Each port sends to the next connected port and receives from the
+ * previous one, so every port is exercised in both directions and all
+ * links carry traffic at the same time.
+ */
+static inline unsigned int link_bench_next(unsigned int i, unsigned int n) {
+    return (i + 1) % n;
+}
+
+static const char *link_bench_series(const struct link_bench_mode *mode) {
+    if (!mode->hs) {
+        return "-";
+    }
+    return mode->series == UNIPRO_HS_SERIES_B ? "B" : "A";
+}
+
+static void link_bench_print_row(const struct link_bench_mode *mode,
+                                 const struct link_bench_port *src,
+                                 const struct link_bench_port *dst,
+                                 int rc, uint32_t msgs, unsigned int msgsize,
+                                 uint32_t usecs,
+                                 const struct link_bench_counters *errs) {
+    uint64_t bytes = (uint64_t)msgs * msgsize;
+    uint32_t kbps = usecs ? (uint32_t)(bytes * 8000 / usecs) : 0;
+
+    printf("%s,%u,%s,%u,%d,%s,%s,%d,%u,%llu,%u,%u,%u,%u,%u,%u\n",
+           mode->hs ? "HS" : "PWM", mode->gear, link_bench_series(mode),
+           mode->nlanes, mode->auto_variant,
+           src->name, dst->name, rc, msgs, (unsigned long long)bytes, usecs,
+           kbps, errs->phy_errors, errs->pa_errors, errs->dl_errors,
+           errs->t_errors);
+}
+
+/*
+ * Run one power mode on every link: configure all the ports, start the
+ * traffic on all of them, let it run for one measurement window, and
+ * only then sample and stop everything.
+ */
+static int link_bench_step(const struct link_bench_ops *ops, void *priv,
+                           const struct link_bench_params *params,
+                           const struct link_bench_port *ports,
+                           unsigned int nports,
+                           const struct link_bench_mode *mode) {
+    struct link_bench_counters start[LINK_BENCH_PORTS_MAX];
+    struct link_bench_counters end[LINK_BENCH_PORTS_MAX];
+    int cfg_rc[LINK_BENCH_PORTS_MAX];
+    int rc[LINK_BENCH_PORTS_MAX];
+    uint32_t usecs;
+    unsigned int i, j;
+    int ret = 0;
+
+    for (i = 0; i < nports; i++) {
+        cfg_rc[i] = ops->configure(priv, &ports[i], mode);
+    }
+
+    for (i = 0; i < nports; i++) {
+        j = link_bench_next(i, nports);
+        rc[i] = cfg_rc[i] ? cfg_rc[i] : cfg_rc[j];
+        if (!rc[i]) {
+            rc[i] = ops->traffic_start(priv, &ports[i], &ports[j],
+                                       params->msgsize);
+        }
+    }
+
+    /* Receive side baseline; this also clears the error indications. */
+    for (i = 0; i < nports; i++) {
+        j = link_bench_next(i, nports);
+        memset(&start[j], 0, sizeof(start[j]));
+        if (!rc[i]) {
+            rc[i] = ops->read_counters(priv, &ports[j], &start[j]);
+        }
+    }
+
+    usecs = ops->run(priv, params->window_usecs);
+
+    for (i = 0; i < nports; i++) {
+        j = link_bench_next(i, nports);
+        memset(&end[j], 0, sizeof(end[j]));
+        if (!rc[i]) {
+            rc[i] = ops->read_counters(priv, &ports[j], &end[j]);
+        }
+        if (!cfg_rc[i] && !cfg_rc[j]) {
+            int rc2 = ops->traffic_stop(priv, &ports[i], &ports[j],
+                                        params->msgsize);
+            if (!rc[i]) {
+                rc[i] = rc2;
+            }
+        }
+    }
+
+    for (i = 0; i < nports; i++) {
+        j = link_bench_next(i, nports);
+        link_bench_print_row(mode, &ports[i], &ports[j], rc[i],
+                             rc[i] ? 0 : end[j].rx_msgs - start[j].rx_msgs,
+                             params->msgsize, usecs, &end[j]);
+        if (rc[i] || end[j].phy_errors || end[j].pa_errors ||
+            end[j].dl_errors || end[j].t_errors) {
+            ret = -EIO;
+        }
+    }
+
+    return ret;
+}
+
+/**
+ * @brief Sweep all power modes over all connected ports
+ *
+ * Prints one CSV row per link and power mode. Lines starting with '#'
+ * are comments.
+ *
+ * @return 0 if every step ran without error, -EIO if any link failed or
+ *         reported errors, or another negative errno if the benchmark
+ *         could not run at all.
+ */
+int link_bench_run(const struct link_bench_ops *ops, void *priv,
+                   const struct link_bench_params *params) {
+    struct link_bench_port ports[LINK_BENCH_PORTS_MAX];
+    struct link_bench_mode mode;
+    unsigned int maxgear, nseries, s;
+    int nports;
+    int hs;
+    int rc = 0;
+
+    if (!ops || !params || !params->msgsize || !params->max_lanes) {
+        return -EINVAL;
+    }
+
+    nports = ops->get_ports(priv, ports, LINK_BENCH_PORTS_MAX);
+    if (nports < 0) {
+        return nports;
+    }
+    if (nports < 2) {
+        printf("# linkbench: need at least two connected ports, found %d\n",
+               nports);
+        return -ENODEV;
+    }
+
+    printf("# linkbench: %d ports, %u byte messages, %u us window\n",
+           nports, params->msgsize, params->window_usecs);
+    printf("mode,gear,series,lanes,auto,src,dst,status,msgs,bytes,usecs,"
+           "kbps,phy_err,pa_err,dl_err,t_err\n");
+
+    for (hs = 0; hs <= 1; hs++) {
+        maxgear = hs ? params->hs_maxgear : params->pwm_maxgear;
+        nseries = hs ? 2 : 1;
+        mode.hs = hs;
+        for (mode.gear = 1; mode.gear <= maxgear; mode.gear++) {
+            for (s = 0; s < nseries; s++) {
+                mode.series = !hs ? UNIPRO_HS_SERIES_UNCHANGED :
+                              s ? UNIPRO_HS_SERIES_B : UNIPRO_HS_SERIES_A;
+                for (mode.nlanes = 1; mode.nlanes <= params->max_lanes;
+                     mode.nlanes++) {
+                    for (mode.auto_variant = 0; mode.auto_variant <= 1;
+                         mode.auto_variant++) {
+                        if (link_bench_step(ops, priv, params, ports, nports,
+                                            &mode)) {
+                            rc = -EIO;
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    printf("# linkbench: %s\n", rc ? "errors detected" : "all links clean");
+    return rc;
+}
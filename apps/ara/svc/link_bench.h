@@ -0,0 +1,129 @@
+/*
+ * Copyright (c) 2015 Google Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @brief Parallel UniPro link benchmark
+ *
+ * The benchmark sweeps every power mode combination (PWM/HS gear, HS
+ * rate series, lane count and "auto" variant), applies each one to
+ * all connected ports at once, runs test feature traffic on every
+ * port concurrently, and reports the error counters and effective
+ * throughput of each link as a CSV table.
+ *
+ * Hardware access goes through struct link_bench_ops so that the same
+ * sweep can run against the real switch or against the simulated
+ * back-end, which lets the table format and the sweep logic be
+ * regression tested without a board.
+ */
+
+#ifndef __SVC_LINK_BENCH_H_
+#define __SVC_LINK_BENCH_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <nuttx/greybus/unipro.h>
+
+/* Upper bound on the number of ports taking part in a run */
+#define LINK_BENCH_PORTS_MAX    (14)
+
+/**
+ * @brief Power mode applied to every port during one benchmark step
+ */
+struct link_bench_mode {
+    int hs;                         /* HS if nonzero, PWM otherwise */
+    unsigned int gear;
+    unsigned int nlanes;
+    int auto_variant;               /* Use the "auto" mode variant */
+    enum unipro_hs_series series;
+};
+
+/**
+ * @brief A connected port taking part in the benchmark
+ */
+struct link_bench_port {
+    uint8_t portid;
+    const char *name;
+    void *priv;                     /* Back-end private data */
+};
+
+/**
+ * @brief Counters sampled on the receiving end of a test link
+ *
+ * rx_msgs is a running count of the test messages received. The error
+ * counters report the errors seen since the previous sample.
+ */
+struct link_bench_counters {
+    uint32_t rx_msgs;
+    uint32_t phy_errors;
+    uint32_t pa_errors;
+    uint32_t dl_errors;
+    uint32_t t_errors;
+};
+
+/**
+ * @brief Back-end used by the benchmark to reach the switch
+ */
+struct link_bench_ops {
+    /** Fill @a ports with the connected ports, return how many */
+    int (*get_ports)(void *priv, struct link_bench_port *ports, size_t max);
+    /** Apply @a mode to the link of @a port */
+    int (*configure)(void *priv, const struct link_bench_port *port,
+                     const struct link_bench_mode *mode);
+    /** Start endless test traffic of @a msgsize byte messages */
+    int (*traffic_start)(void *priv, const struct link_bench_port *src,
+                         const struct link_bench_port *dst,
+                         unsigned int msgsize);
+    int (*traffic_stop)(void *priv, const struct link_bench_port *src,
+                        const struct link_bench_port *dst,
+                        unsigned int msgsize);
+    /** Sample the receive side counters of @a port */
+    int (*read_counters)(void *priv, const struct link_bench_port *port,
+                         struct link_bench_counters *counters);
+    /** Let the traffic run for about @a usecs, return the time elapsed */
+    uint32_t (*run)(void *priv, uint32_t usecs);
+};
+
+/**
+ * @brief Parameters of a benchmark run
+ */
+struct link_bench_params {
+    unsigned int pwm_maxgear;       /* 0 skips the PWM gears */
+    unsigned int hs_maxgear;        /* 0 skips the HS gears */
+    unsigned int max_lanes;
+    unsigned int msgsize;
+    uint32_t window_usecs;
+};
+
+int link_bench_run(const struct link_bench_ops *ops, void *priv,
+                   const struct link_bench_params *params);
+
+extern const struct link_bench_ops link_bench_sim_ops;
+void *link_bench_sim_init(unsigned int nports, uint32_t seed);
+
+#endif
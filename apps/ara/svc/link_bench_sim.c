@@ -0,0 +1,233 @@
+/*
+ * Copyright (c) 2015 Google Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Simulated switch back-end for the link benchmark.
+ *
+ * Every port is modelled as a two lane link to a bridge that implements
+ * the UniPro test feature. Throughput follows the nominal M-PHY rates
+ * and the time is virtual, so results are deterministic and a run takes
+ * no longer than the sweep itself.
+ */
+
+#include <nuttx/config.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+#include "link_bench.h"
+
+#define SIM_LANES_MAX       (2)
+#define SIM_PWM_GEAR_MAX    (7)
+#define SIM_HS_GEAR_MAX     (3)
+/* Largest L4 segment payload, and the L2/L3/L4 overhead around it */
+#define SIM_SEGMENT_SIZE    (272)
+#define SIM_SEGMENT_HDR     (8)
+
+struct sim_port {
+    char name[8];
+    struct link_bench_mode mode;
+    int configured;
+    int tx_dst;                     /* Port receiving our traffic, or -1 */
+    unsigned int tx_msgsize;
+    uint32_t rx_msgs;
+    uint32_t rx_remainder;          /* Bits of a partially received message */
+    struct link_bench_counters errors;
+};
+
+struct sim_switch {
+    unsigned int nports;
+    uint32_t seed;
+    struct sim_port ports[LINK_BENCH_PORTS_MAX];
+};
+
+static struct sim_switch sim;
+
+static uint32_t sim_random(struct sim_switch *s) {
+    s->seed = s->seed * 1103515245 + 12345;
+    return s->seed >> 16;
+}
+
+/*
+ * Raw line rate of one lane, in kbit/s. HS gears double the rate of the
+ * previous one; PWM gears start at the top of the PWM-G1 range.
+ */
+static uint32_t sim_lane_kbps(const struct link_bench_mode *mode) {
+    uint32_t base;
+
+    if (!mode->hs) {
+        return 9000U << (mode->gear - 1);
+    }
+    base = mode->series == UNIPRO_HS_SERIES_B ? 1457600 : 1248000;
+    return base << (mode->gear - 1);
+}
+
+/* Bits of test messages delivered over the link in @a usecs */
+static uint64_t sim_payload_bits(const struct link_bench_mode *mode,
+                                 unsigned int msgsize, uint32_t usecs) {
+    unsigned int nsegs = (msgsize + SIM_SEGMENT_SIZE - 1) / SIM_SEGMENT_SIZE;
+    uint64_t bits = (uint64_t)sim_lane_kbps(mode) * mode->nlanes * usecs / 1000;
+
+    /* 8b10b line coding, then the per segment framing */
+    bits = bits * 8 / 10;
+    bits = bits * msgsize / (msgsize + nsegs * SIM_SEGMENT_HDR);
+    /* BURST/SLEEP transitions cost the "auto" variants some bandwidth */
+    if (mode->auto_variant) {
+        bits = bits * 9 / 10;
+    }
+    return bits;
+}
+
+static int sim_get_ports(void *priv, struct link_bench_port *ports,
+                         size_t max) {
+    struct sim_switch *s = priv;
+    unsigned int i;
+
+    for (i = 0; i < s->nports && i < max; i++) {
+        ports[i].portid = i;
+        ports[i].name = s->ports[i].name;
+        ports[i].priv = &s->ports[i];
+    }
+    return i;
+}
+
+static int sim_configure(void *priv, const struct link_bench_port *port,
+                         const struct link_bench_mode *mode) {
+    struct sim_port *p = port->priv;
+    unsigned int maxgear = mode->hs ? SIM_HS_GEAR_MAX : SIM_PWM_GEAR_MAX;
+
+    if (!mode->gear || mode->gear > maxgear ||
+        !mode->nlanes || mode->nlanes > SIM_LANES_MAX) {
+        p->configured = 0;
+        return -EINVAL;
+    }
+
+    p->mode = *mode;
+    p->configured = 1;
+    return 0;
+}
+
+static int sim_traffic_start(void *priv, const struct link_bench_port *src,
+                             const struct link_bench_port *dst,
+                             unsigned int msgsize) {
+    struct sim_port *p = src->priv;
+
+    if (!p->configured || p->tx_dst >= 0) {
+        return -EBUSY;
+    }
+    p->tx_dst = dst->portid;
+    p->tx_msgsize = msgsize;
+    return 0;
+}
+
+static int sim_traffic_stop(void *priv, const struct link_bench_port *src,
+                            const struct link_bench_port *dst,
+                            unsigned int msgsize) {
+    struct sim_port *p = src->priv;
+
+    if (p->tx_dst != dst->portid) {
+        return -EINVAL;
+    }
+    p->tx_dst = -1;
+    return 0;
+}
+
+static int sim_read_counters(void *priv, const struct link_bench_port *port,
+                             struct link_bench_counters *counters) {
+    struct sim_port *p = port->priv;
+
+    *counters = p->errors;
+    counters->rx_msgs = p->rx_msgs;
+    memset(&p->errors, 0, sizeof(p->errors));
+    return 0;
+}
+
+static uint32_t sim_run(void *priv, uint32_t usecs) {
+    struct sim_switch *s = priv;
+    unsigned int i;
+
+    for (i = 0; i < s->nports; i++) {
+        struct sim_port *src = &s->ports[i];
+        struct sim_port *dst;
+        uint64_t bits;
+
+        if (src->tx_dst < 0) {
+            continue;
+        }
+        dst = &s->ports[src->tx_dst];
+        bits = sim_payload_bits(&src->mode, src->tx_msgsize, usecs) +
+               dst->rx_remainder;
+        dst->rx_msgs += bits / (src->tx_msgsize * 8);
+        dst->rx_remainder = bits % (src->tx_msgsize * 8);
+
+        /*
+         * With a nonzero seed, HS-G3 links see occasional line errors,
+         * recovered by the PA and DL layers.
+         */
+        if (s->seed && src->mode.hs && src->mode.gear == SIM_HS_GEAR_MAX &&
+            !(sim_random(s) % 4)) {
+            dst->errors.phy_errors++;
+            dst->errors.pa_errors++;
+            dst->errors.dl_errors++;
+        }
+    }
+    return usecs;
+}
+
+const struct link_bench_ops link_bench_sim_ops = {
+    .get_ports      = sim_get_ports,
+    .configure      = sim_configure,
+    .traffic_start  = sim_traffic_start,
+    .traffic_stop   = sim_traffic_stop,
+    .read_counters  = sim_read_counters,
+    .run            = sim_run,
+};
+
+/**
+ * @brief Reset the simulated switch
+ *
+ * @param nports number of connected ports to simulate
+ * @param seed nonzero to inject line errors on the fastest gear
+ * @return back-end private data to pass to link_bench_run()
+ */
+void *link_bench_sim_init(unsigned int nports, uint32_t seed) {
+    unsigned int i;
+
+    if (nports > LINK_BENCH_PORTS_MAX) {
+        nports = LINK_BENCH_PORTS_MAX;
+    }
+
+    memset(&sim, 0, sizeof(sim));
+    sim.nports = nports;
+    sim.seed = seed;
+    for (i = 0; i < nports; i++) {
+        snprintf(sim.ports[i].name, sizeof(sim.ports[i].name), "sim%u", i);
+        sim.ports[i].tx_dst = -1;
+    }
+    return &sim;
+}
@@ -31,6 +31,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <time.h>
 #include <nuttx/util.h>
 #include <nuttx/greybus/unipro.h>
 
@@ -39,6 +40,7 @@
 #include "ara_board.h"
 #include "interface.h"
 #include "attr_names.h"
+#include "link_bench.h"
 
 #define DBG_COMP DBG_SVC
 #include "up_debug.h"
@@ -57,6 +59,7 @@ enum {
     LINKSTATUS,
     DME_IO,
     TESTFEATURE,
+    LINKBENCH,
     MAX_CMD,
 };
 
@@ -75,6 +78,8 @@ static const struct command commands[] = {
     [LINKSTATUS] = {'s', "linkstatus", "print UniPro link status bit mask"},
     [DME_IO]  = {'d', "dme", "get/set DME attributes"},
     [TESTFEATURE] = {'t', "testfeature", "UniPro test feature"},
+    [LINKBENCH] = {'b', "linkbench",
+                   "benchmark all UniPro links in every power mode"},
 };
 
 static void usage(int exit_status) {
@@ -1020,6 +1025,268 @@ static int test_feature(int argc, char* argv[]) {
     return 0;
 }
 
+/*
+ * Link benchmark back-end driving the real switch. Every port sends on
+ * LINK_BENCH_SRC_CPORT and receives on LINK_BENCH_DST_CPORT, so a port
+ * can source and sink test traffic at the same time.
+ */
+#define LINK_BENCH_SRC_CPORT    (0)
+#define LINK_BENCH_DST_CPORT    (1)
+
+static bool link_bench_connected[SWITCH_PORT_MAX];
+
+static void link_bench_cfg(struct unipro_test_feature_cfg *cfg,
+                           unsigned int msgsize) {
+    memset(cfg, 0, sizeof(*cfg));
+    cfg->tf_src = 0;
+    cfg->tf_src_cportid = LINK_BENCH_SRC_CPORT;
+    cfg->tf_src_inc = 1;
+    cfg->tf_src_size = msgsize;
+    cfg->tf_src_count = 0;
+    cfg->tf_src_gap_us = 0;
+    cfg->tf_dst = 0;
+    cfg->tf_dst_cportid = LINK_BENCH_DST_CPORT;
+}
+
+static int link_bench_get_ports(void *priv, struct link_bench_port *ports,
+                                size_t max) {
+    struct tsb_switch *sw = priv;
+    struct interface *iface;
+    uint32_t link_status;
+    int i, rc, n = 0;
+
+    rc = switch_internal_getattr(sw, SWSTA, &link_status);
+    if (rc) {
+        return rc;
+    }
+
+    interface_foreach(iface, i) {
+        uint8_t port = (uint8_t)iface->switch_portid;
+
+        if (n == max || port >= SWITCH_UNIPORT_MAX ||
+            !(link_status & (1 << port))) {
+            continue;
+        }
+
+        /* Device ID 0 is reserved by the switch. */
+        rc = switch_if_dev_id_set(sw, port, port + 1);
+        if (rc) {
+            printk("svc %s: can't assign device id to %s: %d\n",
+                   commands[LINKBENCH].longc, iface->name, rc);
+            return rc;
+        }
+
+        ports[n].portid = port;
+        ports[n].name = iface->name;
+        ports[n].priv = iface;
+        n++;
+    }
+
+    memset(link_bench_connected, 0, sizeof(link_bench_connected));
+    return n;
+}
+
+static int link_bench_configure(void *priv,
+                                const struct link_bench_port *port,
+                                const struct link_bench_mode *mode) {
+    unsigned int flags = mode->auto_variant ? UNIPRO_LINK_CFGF_AUTO : 0;
+
+    return link_test_port(port->portid, mode->hs, mode->gear, mode->nlanes,
+                          flags, mode->series);
+}
+
+static int link_bench_traffic_start(void *priv,
+                                    const struct link_bench_port *src,
+                                    const struct link_bench_port *dst,
+                                    unsigned int msgsize) {
+    struct tsb_switch *sw = priv;
+    struct unipro_test_feature_cfg cfg;
+    int rc;
+
+    link_bench_cfg(&cfg, msgsize);
+
+    /* Connections survive power mode changes; set them up only once. */
+    if (!link_bench_connected[src->portid]) {
+        rc = svc_connect_interfaces(src->priv, LINK_BENCH_SRC_CPORT,
+                                    dst->priv, LINK_BENCH_DST_CPORT,
+                                    CPORT_TC0,
+                                    CPORT_FLAGS_CSD_N | CPORT_FLAGS_CSV_N);
+        if (rc) {
+            return rc;
+        }
+        link_bench_connected[src->portid] = true;
+    }
+
+    /* Count the received messages at the destination. */
+    rc = switch_dme_peer_set(sw, dst->portid, T_TSTDSTON, cfg.tf_dst, 1);
+    if (rc) {
+        return rc;
+    }
+
+    return switch_enable_test_traffic(sw, src->portid, dst->portid, &cfg);
+}
+
+static int link_bench_traffic_stop(void *priv,
+                                   const struct link_bench_port *src,
+                                   const struct link_bench_port *dst,
+                                   unsigned int msgsize) {
+    struct tsb_switch *sw = priv;
+    struct unipro_test_feature_cfg cfg;
+    int rc;
+
+    link_bench_cfg(&cfg, msgsize);
+
+    rc = switch_disable_test_traffic(sw, src->portid, dst->portid, &cfg);
+    if (rc) {
+        return rc;
+    }
+    return switch_dme_peer_set(sw, dst->portid, T_TSTDSTON, cfg.tf_dst, 0);
+}
+
+/*
+ * Sample the bridge side of the link: the test feature message count
+ * and the error indications, which clear when read.
+ */
+static int link_bench_read_counters(void *priv,
+                                    const struct link_bench_port *port,
+                                    struct link_bench_counters *counters) {
+    static const uint16_t attrs[] = {
+        T_TSTDSTMESSAGECOUNT,
+        TSB_DME_ERRORPHYIND,
+        TSB_DME_ERRORPAIND,
+        TSB_DME_ERRORDIND,
+        TSB_DME_ERRORTIND,
+    };
+    struct switch_dme_op ops[ARRAY_SIZE(attrs)];
+    int i, rc;
+
+    for (i = 0; i < ARRAY_SIZE(attrs); i++) {
+        ops[i].portid = port->portid;
+        ops[i].flags = SWITCH_DME_OP_GET | SWITCH_DME_OP_PEER;
+        ops[i].attrid = attrs[i];
+        ops[i].select_index = UNIPRO_SELINDEX_NULL;
+        ops[i].value = 0;
+    }
+
+    rc = switch_dme_batch(priv, ops, ARRAY_SIZE(ops));
+    if (rc) {
+        return rc;
+    }
+
+    counters->rx_msgs = ops[0].value;
+    counters->phy_errors = !!ops[1].value;
+    counters->pa_errors = !!ops[2].value;
+    counters->dl_errors = !!ops[3].value;
+    counters->t_errors = !!ops[4].value;
+    return 0;
+}
+
+static uint32_t link_bench_wait(void *priv, uint32_t usecs) {
+    struct timespec start, end;
+
+    clock_gettime(CLOCK_REALTIME, &start);
+    usleep(usecs);
+    clock_gettime(CLOCK_REALTIME, &end);
+
+    return (end.tv_sec - start.tv_sec) * 1000000 +
+           (end.tv_nsec - start.tv_nsec) / 1000;
+}
+
+static const struct link_bench_ops link_bench_switch_ops = {
+    .get_ports      = link_bench_get_ports,
+    .configure      = link_bench_configure,
+    .traffic_start  = link_bench_traffic_start,
+    .traffic_stop   = link_bench_traffic_stop,
+    .read_counters  = link_bench_read_counters,
+    .run            = link_bench_wait,
+};
+
+static void link_bench_usage(int exit_status) {
+    printk("svc %s: usage:\n", commands[LINKBENCH].longc);
+    printk("    -h: print this message and exit\n");
+    printk("    -w <msec>   : Measurement window per power mode. Default is 1000.\n");
+    printk("    -m <size>   : Test message size. Default is 272.\n");
+    printk("    -l <lanes>  : Sweep 1 to <lanes> lanes. Default is 2.\n");
+    printk("    -p <gear>   : Sweep PWM gears 1 to <gear>, 0 to skip. Default is 4.\n");
+    printk("    -g <gear>   : Sweep HS gears 1 to <gear>, 0 to skip. Default is 3.\n");
+    printk("    -S <ports>  : Run against a simulated switch with <ports>\n"
+           "                  connected ports instead of the real one.\n");
+    printk("    -e <seed>   : With -S, inject line errors in HS-G3 using\n"
+           "                  the given nonzero random seed.\n");
+    printk("\n");
+    printk("All connected ports run test traffic at the same time, each one\n"
+           "sending to the next. One CSV row is printed per link and mode.\n");
+    exit(exit_status);
+}
+
+static int link_bench(int argc, char *argv[]) {
+    struct link_bench_params params = {
+        .pwm_maxgear = 4,
+        .hs_maxgear = HS_GEAR_MAX,
+        .max_lanes = 2,
+        .msgsize = 272,
+        .window_usecs = 1000000,
+    };
+    const struct link_bench_ops *ops = &link_bench_switch_ops;
+    void *priv = svc->sw;
+    unsigned int sim_ports = 0;
+    uint32_t sim_seed = 0;
+    char **args = argv + 1;
+    int c;
+
+    const char opts[] = "hw:m:l:p:g:S:e:";
+
+    argc--;
+    optind = -1; /* Force NuttX's getopt() to reinitialize. */
+    while ((c = getopt(argc, args, opts)) != -1) {
+        switch (c) {
+        case 'h':
+            link_bench_usage(EXIT_SUCCESS);
+            break;
+        case 'w':
+            params.window_usecs = strtoul(optarg, NULL, 10) * 1000;
+            break;
+        case 'm':
+            params.msgsize = strtoul(optarg, NULL, 10);
+            break;
+        case 'l':
+            params.max_lanes = strtoul(optarg, NULL, 10);
+            break;
+        case 'p':
+            params.pwm_maxgear = strtoul(optarg, NULL, 10);
+            break;
+        case 'g':
+            params.hs_maxgear = strtoul(optarg, NULL, 10);
+            break;
+        case 'S':
+            sim_ports = strtoul(optarg, NULL, 10);
+            break;
+        case 'e':
+            sim_seed = strtoul(optarg, NULL, 10);
+            break;
+        case '?':
+        default:
+            printf("Unrecognized argument '%c'.\n", (char)c);
+            link_bench_usage(EXIT_FAILURE);
+        }
+    }
+
+    if (params.pwm_maxgear > PWM_GEAR_MAX || params.hs_maxgear > HS_GEAR_MAX ||
+        !params.max_lanes || !params.msgsize) {
+        printk("svc %s: invalid parameters.\n", commands[LINKBENCH].longc);
+        link_bench_usage(EXIT_FAILURE);
+    }
+
+    if (sim_ports) {
+        ops = &link_bench_sim_ops;
+        priv = link_bench_sim_init(sim_ports, sim_seed);
+    } else if (!priv) {
+        return -ENODEV;
+    }
+
+    return link_bench_run(ops, priv, &params);
+}
+
 #ifdef CONFIG_BUILD_KERNEL
 int main(int argc, FAR char *argv[])
 #else
@@ -1074,6 +1341,9 @@ int svc_main(int argc, char *argv[])
     case TESTFEATURE:
         rc = test_feature(argc, argv);
         break;
+    case LINKBENCH:
+        rc = link_bench(argc, argv);
+        break;
     default:
         usage(EXIT_FAILURE);
     }
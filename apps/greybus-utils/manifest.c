@@ -57,8 +57,62 @@ extern void gb_hid_register(int cport);
 struct greybus {
     struct list_head cports;
     struct greybus_driver *drv;
+    /* CPorts of the list above, indexed by id and chained by device */
+    struct gb_cport **cport_table;
+    int cport_table_size;
 };
 
+#ifdef CONFIG_GREYBUS
+struct gb_protocol_driver {
+    const char *name;
+    void (*register_cport)(int cport);
+};
+
+/* Indexed by protocol id */
+static const struct gb_protocol_driver gb_protocol_drivers[] = {
+#ifdef CONFIG_GREYBUS_CONTROL_PROTOCOL
+    [GREYBUS_PROTOCOL_CONTROL] = { "CONTROL", gb_control_register },
+#endif
+#ifdef CONFIG_GREYBUS_GPIO_PHY
+    [GREYBUS_PROTOCOL_GPIO] = { "GPIO", gb_gpio_register },
+#endif
+#ifdef CONFIG_GREYBUS_I2C_PHY
+    [GREYBUS_PROTOCOL_I2C] = { "I2C", gb_i2c_register },
+#endif
+#ifdef CONFIG_GREYBUS_UART_PHY
+    [GREYBUS_PROTOCOL_UART] = { "Uart", gb_uart_register },
+#endif
+#ifdef CONFIG_GREYBUS_HID
+    [GREYBUS_PROTOCOL_HID] = { "HID", gb_hid_register },
+#endif
+#ifdef CONFIG_GREYBUS_USB_HOST_PHY
+    [GREYBUS_PROTOCOL_USB] = { "USB", gb_usb_register },
+#endif
+#ifdef CONFIG_GREYBUS_BATTERY
+    [GREYBUS_PROTOCOL_BATTERY] = { "BATTERY", gb_battery_register },
+#endif
+#ifdef CONFIG_GREYBUS_PWM_PHY
+    [GREYBUS_PROTOCOL_PWM] = { "PWM", gb_pwm_register },
+#endif
+#ifdef CONFIG_GREYBUS_I2S_PHY
+    [GREYBUS_PROTOCOL_I2S_MGMT] = { "I2S MGMT", gb_i2s_mgmt_register },
+    [GREYBUS_PROTOCOL_I2S_RECEIVER] =
+        { "I2S RECEIVER", gb_i2s_receiver_register },
+    [GREYBUS_PROTOCOL_I2S_TRANSMITTER] =
+        { "I2S TRANSMITTER", gb_i2s_transmitter_register },
+#endif
+#ifdef CONFIG_GREYBUS_SPI_PHY
+    [GREYBUS_PROTOCOL_SPI] = { "SPI", gb_spi_register },
+#endif
+#ifdef CONFIG_GREYBUS_VIBRATOR
+    [GREYBUS_PROTOCOL_VIBRATOR] = { "VIBRATOR", gb_vibrator_register },
+#endif
+#ifdef CONFIG_GREYBUS_LOOPBACK
+    [GREYBUS_PROTOCOL_LOOPBACK] = { "Loopback", gb_loopback_register },
+#endif
+};
+#endif
+
 struct greybus g_greybus = {
     .cports = LIST_INIT(g_greybus.cports),
 };
@@ -73,27 +127,82 @@ void foreach_manifest(manifest_handler handler)
         handler(manifest_files[i].bin, manifest_files[i].id, i);
 }
 
-static void *alloc_cport(void)
+/*
+ * Make room in the CPort table for the given id. The table grows to the
+ * highest id declared so far, which is small since CPort ids are allocated
+ * densely from 0.
+ */
+static int grow_cport_table(int cportid)
+{
+    struct gb_cport **table;
+    int size;
+
+    if (cportid < g_greybus.cport_table_size)
+        return 0;
+
+    size = MAX(cportid + 1, 2 * g_greybus.cport_table_size);
+    table = realloc(g_greybus.cport_table, size * sizeof(*table));
+    if (!table)
+        return -ENOMEM;
+
+    memset(table + g_greybus.cport_table_size, 0,
+           (size - g_greybus.cport_table_size) * sizeof(*table));
+    g_greybus.cport_table = table;
+    g_greybus.cport_table_size = size;
+
+    return 0;
+}
+
+/*
+ * A CPort id is unique for a device: the first declaration wins and a later
+ * one is reported and ignored, as its driver could not be registered anyway.
+ */
+static int alloc_cport(int device_id, int cportid, int protocol)
 {
+    struct gb_cport **link;
     struct gb_cport *gb_cport;
 
+    if (cportid < 0 || grow_cport_table(cportid))
+        return -ENOMEM;
+
+    for (link = &g_greybus.cport_table[cportid]; *link;
+         link = &(*link)->next) {
+        if ((*link)->device_id == device_id) {
+            gb_error("cport %d declared again, ignoring protocol %d\n",
+                     cportid, protocol);
+            return 0;
+        }
+    }
+
     gb_cport = malloc(sizeof(struct gb_cport));
     if (!gb_cport)
-        return NULL;
+        return -ENOMEM;
 
+    gb_cport->id = cportid;
+    gb_cport->protocol = protocol;
+    gb_cport->device_id = device_id;
+    gb_cport->next = NULL;
     list_add(&g_greybus.cports, &gb_cport->list);
-    return gb_cport;
+    *link = gb_cport;
+    return 0;
 }
 
-static void free_cport(int cportid)
+static void free_cport(int device_id, int cportid)
 {
+    struct gb_cport **link;
     struct gb_cport *gb_cport;
-    struct list_head *iter, *next;
-    list_foreach_safe(&g_greybus.cports, iter, next) {
-        gb_cport = list_entry(iter, struct gb_cport, list);
-        if (gb_cport->id == cportid) {
-            list_del(iter);
+
+    if (cportid < 0 || cportid >= g_greybus.cport_table_size)
+        return;
+
+    for (link = &g_greybus.cport_table[cportid]; *link;
+         link = &(*link)->next) {
+        gb_cport = *link;
+        if (gb_cport->device_id == device_id) {
+            *link = gb_cport->next;
+            list_del(&gb_cport->list);
             free(gb_cport);
+            return;
         }
     }
 }
@@ -103,102 +212,20 @@ void enable_cports(void)
 {
     struct list_head *iter;
     struct gb_cport *gb_cport;
-    __attribute__((unused)) int id;
-    __attribute__((unused)) int protocol;
+    const struct gb_protocol_driver *driver;
+
     list_foreach(&g_greybus.cports, iter) {
         gb_cport = list_entry(iter, struct gb_cport, list);
-        id = gb_cport->id;
-        protocol = gb_cport->protocol;
+        if (gb_cport->protocol >= ARRAY_SIZE(gb_protocol_drivers))
+            continue;
 
-#ifdef CONFIG_GREYBUS_CONTROL_PROTOCOL
-        if (protocol == GREYBUS_PROTOCOL_CONTROL) {
-            gb_info("Registering CONTROL greybus driver.\n");
-            gb_control_register(id);
-        }
-#endif
+        driver = &gb_protocol_drivers[gb_cport->protocol];
+        if (!driver->register_cport)
+            continue;
 
-#ifdef CONFIG_GREYBUS_GPIO_PHY
-        if (protocol == GREYBUS_PROTOCOL_GPIO) {
-            gb_info("Registering GPIO greybus driver.\n");
-            gb_gpio_register(id);
-        }
-#endif
-
-#ifdef CONFIG_GREYBUS_I2C_PHY
-        if (protocol == GREYBUS_PROTOCOL_I2C) {
-            gb_info("Registering I2C greybus driver.\n");
-            gb_i2c_register(id);
-        }
-#endif
-
-#ifdef CONFIG_GREYBUS_BATTERY
-        if (protocol == GREYBUS_PROTOCOL_BATTERY) {
-            gb_info("Registering BATTERY greybus driver.\n");
-            gb_battery_register(id);
-        }
-#endif
-
-#ifdef CONFIG_GREYBUS_LOOPBACK
-        if (protocol == GREYBUS_PROTOCOL_LOOPBACK) {
-            gb_info("Registering Loopback greybus driver.\n");
-            gb_loopback_register(id);
-        }
-#endif
-
-#ifdef CONFIG_GREYBUS_VIBRATOR
-        if (protocol == GREYBUS_PROTOCOL_VIBRATOR) {
-            gb_info("Registering VIBRATOR greybus driver.\n");
-            gb_vibrator_register(id);
-        }
-#endif
-
-#ifdef CONFIG_GREYBUS_USB_HOST_PHY
-        if (protocol == GREYBUS_PROTOCOL_USB) {
-            gb_info("Registering USB greybus driver.\n");
-            gb_usb_register(id);
-        }
-#endif
-
-#ifdef CONFIG_GREYBUS_PWM_PHY
-        if (protocol == GREYBUS_PROTOCOL_PWM) {
-            gb_info("Registering PWM greybus driver.\n");
-            gb_pwm_register(id);
-        }
-#endif
-
-#ifdef CONFIG_GREYBUS_I2S_PHY
-        if (protocol == GREYBUS_PROTOCOL_I2S_MGMT) {
-            gb_info("Registering I2S MGMT greybus driver.\n");
-            gb_i2s_mgmt_register(id);
-        } else if (protocol == GREYBUS_PROTOCOL_I2S_RECEIVER) {
-            gb_info("Registering I2S RECEIVER greybus driver.\n");
-            gb_i2s_receiver_register(id);
-        } else if (protocol == GREYBUS_PROTOCOL_I2S_TRANSMITTER) {
-            gb_info("Registering I2S TRANSMITTER greybus driver.\n");
-            gb_i2s_transmitter_register(id);
-        }
-#endif
-
-#ifdef CONFIG_GREYBUS_SPI_PHY
-        if (protocol == GREYBUS_PROTOCOL_SPI) {
-            gb_info("Registering SPI greybus driver.\n");
-            gb_spi_register(id);
-        }
-#endif
-
-#ifdef CONFIG_GREYBUS_UART_PHY
-        if (protocol == GREYBUS_PROTOCOL_UART) {
-            gb_info("Registering Uart greybus driver. id= %d\n", id);
-            gb_uart_register(id);
-        }
-#endif
-
-#ifdef CONFIG_GREYBUS_HID
-        if (protocol == GREYBUS_PROTOCOL_HID) {
-            gb_info("Registering HID greybus driver. id= %d\n", id);
-            gb_hid_register(id);
-        }
-#endif
+        gb_info("Registering %s greybus driver. id= %d\n", driver->name,
+                gb_cport->id);
+        driver->register_cport(gb_cport->id);
     }
 }
 #endif
@@ -219,7 +246,7 @@ static int identify_descriptor(struct greybus_descriptor *desc, size_t size,
     struct greybus_descriptor_header *desc_header = &desc->header;
     size_t expected_size;
     size_t desc_size;
-    struct gb_cport *cport;
+    int retval;
 
     if (size < sizeof(*desc_header)) {
         gb_error("manifest too small\n");
@@ -253,13 +280,15 @@ static int identify_descriptor(struct greybus_descriptor *desc, size_t size,
         expected_size += sizeof(struct greybus_descriptor_cport);
         if (desc_size >= expected_size) {
             if (!release) {
-                cport = alloc_cport();
-                cport->id = desc->cport.id;
-                cport->protocol = desc->cport.protocol_id;
-                cport->device_id = g_device_id;
-                gb_debug("cport_id = %d\n", cport->id);
+                retval = alloc_cport(g_device_id, desc->cport.id,
+                                     desc->cport.protocol_id);
+                if (retval) {
+                    gb_error("cannot allocate cport %d\n", desc->cport.id);
+                    return retval;
+                }
+                gb_debug("cport_id = %d\n", desc->cport.id);
             } else {
-                free_cport(desc->cport.id);
+                free_cport(g_device_id, desc->cport.id);
             }
         }
         break;
@@ -425,6 +454,22 @@ struct list_head *get_manifest_cports(void)
     return &g_greybus.cports;
 }
 
+struct gb_cport *get_manifest_cport(int device_id, int cportid)
+{
+    struct gb_cport *gb_cport;
+
+    if (cportid < 0 || cportid >= g_greybus.cport_table_size)
+        return NULL;
+
+    for (gb_cport = g_greybus.cport_table[cportid]; gb_cport;
+         gb_cport = gb_cport->next) {
+        if (gb_cport->device_id == device_id)
+            return gb_cport;
+    }
+
+    return NULL;
+}
+
 int get_manifest_size(void)
 {
     struct greybus_manifest_header *mh = get_manifest_blob();
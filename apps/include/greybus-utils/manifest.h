@@ -36,6 +36,7 @@ struct gb_cport {
     int id;
     int protocol;
     int device_id;
+    struct gb_cport *next;      /* same id, declared by another device */
 };
 
 struct manifest_file {
@@ -53,6 +54,7 @@ void enable_manifest(char *name, void *manifest, int device_id);
 void disable_manifest(char *name, void *priv, int device_id);
 void release_manifest_blob(void *manifest);
 struct list_head *get_manifest_cports(void);
+struct gb_cport *get_manifest_cport(int device_id, int cportid);
 int get_manifest_size(void);
 
 #endif
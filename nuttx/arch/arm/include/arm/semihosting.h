@@ -43,5 +43,6 @@ int semihosting_close(int fd);
 
 ssize_t semihosting_read(int fd, const char *buffer, size_t buflen);
 ssize_t semihosting_write(int fd, const char *buffer, size_t buflen);
+int semihosting_seek(int fd, off_t offset);
 
 #endif /* __ARCH_ARM_SEMIHOSTING_H__ */
@@ -45,5 +45,8 @@ uint32_t atomic_add(atomic_t *atomic, int n);
 uint32_t atomic_inc(atomic_t *atomic);
 uint32_t atomic_dec(atomic_t *atomic);
 
+/* Store new if the value is old; returns the value found */
+uint32_t atomic_cmpxchg(atomic_t *atomic, uint32_t old, uint32_t new);
+
 #endif /* __ATOMIC_H__ */
 
@@ -61,6 +61,7 @@ enum semihosting_syscall {
     SYSCALL_WRITEC = 0x3,
     SYSCALL_WRITE = 0x5,
     SYSCALL_READ = 0x6,
+    SYSCALL_SEEK = 0xa,
 };
 
 struct semihosting_priv {
@@ -136,6 +137,16 @@ ssize_t semihosting_write(int fd, const char *buffer, size_t buflen)
     return buflen - not_written;
 }
 
+int semihosting_seek(int fd, off_t offset)
+{
+    uint32_t params[2];
+
+    params[0] = (uint32_t) fd;
+    params[1] = (uint32_t) offset;
+
+    return semihosting_syscall(SYSCALL_SEEK, &params[0]) ? -EIO : 0;
+}
+
 static ssize_t semihosting_consoleread(struct file *filep, char *buffer,
                                        size_t buflen)
 {
@@ -76,7 +76,11 @@
 
 #define GPIO_TRIGGER                    0   /* Trigger GPIO pin for testing */
 #define DEFAULT_DEBOUNCE_TIME           25  /* 250ms (1 SysTick = 10ms) */
+#ifdef CONFIG_ARCH_CHIP_HID_DUMMY_TOUCH_SAMPLE_USEC
+#define TOUCH_SAMPLE_RATE   CONFIG_ARCH_CHIP_HID_DUMMY_TOUCH_SAMPLE_USEC
+#else
 #define TOUCH_SAMPLE_RATE               20000 /* 20ms */
+#endif
 
 static int tsb_hid_get_report_length(struct device *dev, uint8_t report_type,
                                      uint8_t report_id);
@@ -385,8 +389,14 @@ void tsb_hid_thread_func(void *context)
     srand(time(NULL));
 
     while (1) {
-        /* wait for gpio trigger event */
-        pthread_cond_wait(&info->wq.cond, &info->wq.mutex);
+#ifdef CONFIG_ARCH_CHIP_HID_DUMMY_TOUCH_BENCHMARK
+        /* generate touch packets back to back while the device is powered */
+        if (!(info->state & HID_DEVICE_FLAG_POWERON))
+#endif
+        {
+            /* wait for gpio trigger event */
+            pthread_cond_wait(&info->wq.cond, &info->wq.mutex);
+        }
         if (info->wq.abort) {
             /* exit tsb_hid_thread_func loop */
             break;
@@ -619,6 +629,12 @@ static int tsb_hid_power_on(struct device *dev)
         info->state |= HID_DEVICE_FLAG_POWERON;
         /* enable interrupt */
         gpio_unmask_irq(GPIO_TRIGGER);
+#ifdef CONFIG_ARCH_CHIP_HID_DUMMY_TOUCH_BENCHMARK
+        /* start generating without waiting for the trigger */
+        pthread_mutex_lock(&info->wq.mutex);
+        pthread_cond_signal(&info->wq.cond);
+        pthread_mutex_unlock(&info->wq.mutex);
+#endif
     } else {
         ret = -EBUSY;
     }
@@ -332,6 +332,35 @@ static int tsb_spi_setbits(struct device *dev, int nbits)
     return 0;
 }
 
+/**
+ * @brief Move one block of data through the SPI controller
+ *
+ * @param info pointer to the data of tsb_spi_info
+ * @param txbuf data to be written, or NULL
+ * @param rxbuf buffer receiving the read data, or NULL
+ * @param nwords number of words to transfer
+ */
+static void tsb_spi_transfer(struct tsb_spi_info *info, uint8_t *txbuf,
+                             uint8_t *rxbuf, size_t nwords)
+{
+    size_t i;
+
+    /* TODO: Implement SPI transfer function
+     *
+     * Because SPI master only supported on Toshiba ES3 chip, the hardware
+     * isn't ready, so we only add dummy code for testing.
+     */
+
+    /* for test only */
+    for (i = 0; i < nwords; i++) {
+        if (txbuf && rxbuf) {
+            rxbuf[i] = ~txbuf[i];
+        } else if (rxbuf) {
+            rxbuf[i] = (uint8_t)i;
+        }
+    }
+}
+
 /**
  * @brief Exchange a block of data from SPI
  *
@@ -349,9 +378,7 @@ static int tsb_spi_exchange(struct device *dev,
                              struct device_spi_transfer *transfer)
 {
     struct tsb_spi_info *info = NULL;
-    int i = 0, ret = 0;
-    uint8_t *txbuf = NULL, *rxbuf = NULL;
-
+    int ret = 0;
 
     /* check input parameters */
     if (!dev || !device_get_private(dev) || !transfer) {
@@ -372,22 +399,8 @@ static int tsb_spi_exchange(struct device *dev,
         goto err_unlock;
     }
 
-    /* TODO: Implement SPI transfer function
-     *
-     * Because SPI master only supported on Toshiba ES3 chip, the hardware
-     * isn't ready, so we only add dummy code for testing.
-     */
-
-    /* for test only */
-    txbuf = transfer->txbuffer;
-    rxbuf = transfer->rxbuffer;
-    for (i=0; i < transfer->nwords; i++) {
-        if (txbuf && rxbuf) {
-            rxbuf[i] = ~txbuf[i];
-        } else if (rxbuf) {
-            rxbuf[i] = (uint8_t)i;
-        }
-    }
+    tsb_spi_transfer(info, transfer->txbuffer, transfer->rxbuffer,
+                     transfer->nwords);
 err_unlock:
     sem_post(&info->lock);
     return ret;
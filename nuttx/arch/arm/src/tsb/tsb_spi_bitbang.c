@@ -29,6 +29,7 @@
 #include <stddef.h>
 #include <string.h>
 #include <errno.h>
+#include <unistd.h>
 
 #include <nuttx/lib.h>
 #include <nuttx/util.h>
@@ -508,6 +509,58 @@ static int tsb_spi_unlock(struct device *dev)
     return 0;
 }
 
+/**
+ * @brief Drive the chip-select pins
+ *
+ * @param info pointer to the data of tsb_spi_info
+ * @param devid identifier of the SPI slave device to activate, or -1 to
+ *        deactivate all of them
+ */
+static void tsb_spi_drive_cs(struct tsb_spi_info *info, int devid)
+{
+    bool active = (info->modes & SPI_MODE_CS_HIGH)? true : false;
+    int i;
+
+    info->selected = devid;
+
+    for (i = 0; i < info->caps.csnum; i++) {
+        /* only selected pin can be actived */
+        gpio_set_value(info->chipselect[i], (i == devid)? active : !active);
+    }
+}
+
+/**
+ * @brief Compute the bit hold time for a SPI frequency
+ *
+ * @param info pointer to the data of tsb_spi_info
+ * @param frequency SPI frequency requested (unit: Hz)
+ * @return the frequency actually selected
+ */
+static uint32_t tsb_spi_apply_frequency(struct tsb_spi_info *info,
+                                        uint32_t frequency)
+{
+    info->frequency = frequency;
+
+    /* We only supported SPI frequency from 1KHz to 500KHz */
+    if (info->frequency <= 1000) {
+        info->frequency = 1000;
+    }
+
+    if (info->frequency >= 500000) {
+        info->frequency = 500000;
+    }
+
+    /* calc holdtime */
+    info->holdtime = 500000 / info->frequency;
+    if (info->holdtime > XFER_OVERHEAD) {
+        info->holdtime = info->holdtime - XFER_OVERHEAD;
+    } else {
+        info->holdtime = 0;
+    }
+
+    return info->frequency;
+}
+
 /**
  * @brief Enable the SPI chip select pin
  *
@@ -524,8 +577,7 @@ static int tsb_spi_unlock(struct device *dev)
 static int tsb_spi_select(struct device *dev, int devid)
 {
     struct tsb_spi_info *info = NULL;
-    int i = 0, ret = 0;
-    bool selected = true;
+    int ret = 0;
 
     /* check input parameters */
     if (!dev || !device_get_private(dev)) {
@@ -551,16 +603,7 @@ static int tsb_spi_select(struct device *dev, int devid)
         goto err_unlock;
     }
 
-    info->selected = devid;
-
-    if (!(info->modes & SPI_MODE_CS_HIGH)) {
-        selected = false;
-    }
-
-    for (i = 0; i < info->caps.csnum; i++) {
-        /* only selected pin can be actived */
-        gpio_set_value(info->chipselect[i], (i == devid)? selected : !selected);
-    }
+    tsb_spi_drive_cs(info, devid);
 err_unlock:
     sem_post(&info->lock);
     return ret;
@@ -582,8 +625,7 @@ err_unlock:
 static int tsb_spi_deselect(struct device *dev, int devid)
 {
     struct tsb_spi_info *info = NULL;
-    int i = 0, ret = 0;
-    bool selected = false;
+    int ret = 0;
 
     /* check input parameters */
     if (!dev || !device_get_private(dev)) {
@@ -609,16 +651,8 @@ static int tsb_spi_deselect(struct device *dev, int devid)
         goto err_unlock;
     }
 
-    info->selected = -1;
-
-    if (!(info->modes & SPI_MODE_CS_HIGH)) {
-        selected = true;
-    }
-
-    for (i = 0; i < info->caps.csnum; i++) {
-        /* deactive all chip-select pin */
-        gpio_set_value(info->chipselect[i], selected);
-    }
+    /* deactive all chip-select pin */
+    tsb_spi_drive_cs(info, -1);
 err_unlock:
     sem_post(&info->lock);
     return ret;
@@ -655,26 +689,7 @@ static int tsb_spi_setfrequency(struct device *dev, uint32_t *frequency)
         return -EPERM;
     }
 
-    info->frequency = *frequency;
-
-    /* We only supported SPI frequency from 1KHz to 500KHz */
-    if (info->frequency <= 1000) {
-        info->frequency = 1000;
-    }
-
-    if (info->frequency >= 500000) {
-        info->frequency = 500000;
-    }
-
-    /* calc holdtime */
-    info->holdtime = 500000 / info->frequency;
-    if (info->holdtime > XFER_OVERHEAD) {
-        info->holdtime = info->holdtime - XFER_OVERHEAD;
-    } else {
-        info->holdtime = 0;
-    }
-
-    *frequency = info->frequency;
+    *frequency = tsb_spi_apply_frequency(info, *frequency);
     sem_post(&info->lock);
     return 0;
 }
@@ -793,6 +808,26 @@ err_unlock:
     return ret;
 }
 
+/**
+ * @brief Transfer a block of words with the current word size
+ *
+ * @param info pointer to the data of tsb_spi_info
+ * @param transfer pointer to the spi transfer request
+ * @return 0 on success, negative errno on error
+ */
+static int tsb_spi_transfer(struct tsb_spi_info *info,
+                            struct device_spi_transfer *transfer)
+{
+    if (info->bpw <= 8) {
+        return tsb_spi_transfer_8(info, transfer);
+    } else if (info->bpw <= 16) {
+        return tsb_spi_transfer_16(info, transfer);
+    } else if (info->bpw <= 32) {
+        return tsb_spi_transfer_32(info, transfer);
+    }
+    return -EINVAL;
+}
+
 /**
  * @brief Exchange a block of data from SPI
  *
@@ -830,14 +865,103 @@ static int tsb_spi_exchange(struct device *dev,
         goto err_unlock;
     }
 
-    if (info->bpw <= 8) {
-        tsb_spi_transfer_8(info, transfer);
-    } else if (info->bpw <= 16) {
-        tsb_spi_transfer_16(info, transfer);
-    } else if (info->bpw <= 32) {
-        tsb_spi_transfer_32(info, transfer);
-    } else {
+    ret = tsb_spi_transfer(info, transfer);
+
+err_unlock:
+    sem_post(&info->lock);
+    return ret;
+}
+
+/**
+ * @brief Exchange a chain of transfers as a single job
+ *
+ * The whole chain runs under one acquisition of the operation lock, and the
+ * word size and clock are only reprogrammed when a step changes them. This
+ * function should be called after lock(), if the driver is not in lock
+ * state, it returns -EPERM error code.
+ *
+ * @param dev pointer to structure of device data
+ * @param devid identifier of a selected SPI slave device
+ * @param chain array of transfer steps
+ * @param count number of entries in chain
+ * @return 0 on success, negative errno on error
+ */
+static int tsb_spi_exchange_chain(struct device *dev, int devid,
+                                  struct device_spi_chain_entry *chain,
+                                  unsigned int count)
+{
+    struct tsb_spi_info *info = NULL;
+    struct device_spi_transfer transfer;
+    bool use_cs;
+    unsigned int i;
+    int ret = 0;
+
+    /* check input parameters */
+    if (!dev || !device_get_private(dev) || (count && !chain)) {
+        return -EINVAL;
+    }
+
+    info = device_get_private(dev);
+    sem_wait(&info->lock);
+
+    if (info->state != TSB_SPI_STATE_LOCKED) {
+        ret = -EPERM;
+        goto err_unlock;
+    }
+
+    use_cs = !(info->modes & SPI_MODE_NO_CS);
+    if (use_cs && devid >= info->caps.csnum) {
         ret = -EINVAL;
+        goto err_unlock;
+    }
+
+    /* validate the whole chain before touching the bus */
+    for (i = 0; i < count; i++) {
+        if (!chain[i].txbuffer && !chain[i].rxbuffer) {
+            ret = -EINVAL;
+            goto err_unlock;
+        }
+        /* -ENOSYS would tell the caller that chaining is not supported */
+        if (chain[i].bpw && !(BIT(chain[i].bpw - 1) & info->caps.bpw)) {
+            ret = -EINVAL;
+            goto err_unlock;
+        }
+    }
+
+    memset(&transfer, 0, sizeof(transfer));
+
+    for (i = 0; i < count; i++) {
+        if (chain[i].bpw) {
+            info->bpw = chain[i].bpw;
+        }
+        if (chain[i].frequency && chain[i].frequency != info->frequency) {
+            tsb_spi_apply_frequency(info, chain[i].frequency);
+        }
+
+        if (use_cs && info->selected != devid) {
+            tsb_spi_drive_cs(info, devid);
+        }
+
+        transfer.txbuffer = chain[i].txbuffer;
+        transfer.rxbuffer = chain[i].rxbuffer;
+        transfer.nwords = chain[i].nwords;
+        ret = tsb_spi_transfer(info, &transfer);
+        if (ret) {
+            break;
+        }
+
+        /* delays can reach 65ms: sleep rather than spin */
+        if (chain[i].delay_usecs) {
+            usleep(chain[i].delay_usecs);
+        }
+
+        if (use_cs && chain[i].cs_change) {
+            tsb_spi_drive_cs(info, -1);
+        }
+    }
+
+    if (use_cs && info->selected >= 0) {
+        tsb_spi_drive_cs(info, -1);
     }
 
 err_unlock:
@@ -1023,6 +1147,7 @@ static struct device_spi_type_ops tsb_spi_type_ops = {
     .setmode        = tsb_spi_setmode,
     .setbits        = tsb_spi_setbits,
     .exchange       = tsb_spi_exchange,
+    .exchange_chain = tsb_spi_exchange_chain,
     .getcaps        = tsb_spi_getcaps,
 };
 
@@ -32,6 +32,8 @@
 #include <nuttx/lib.h>
 #include <nuttx/kmalloc.h>
 #include <nuttx/wqueue.h>
+#include <nuttx/wdog.h>
+#include <nuttx/clock.h>
 #include <nuttx/device.h>
 #include <nuttx/device_uart.h>
 
@@ -213,6 +215,12 @@ struct tsb_uart_info {
     void            (*rx_callback)(uint8_t *buffer, int length, int error);
     /** Transmit callback function */
     void            (*tx_callback)(uint8_t *buffer, int length, int error);
+    /** Bytes that complete a receive in coalescing mode, 0 if disabled */
+    int             rx_threshold;
+    /** Idle time in ticks that completes a receive in coalescing mode */
+    int             rx_idle_ticks;
+    /** Watchdog detecting the end of a burst in coalescing mode */
+    WDOG_ID         rx_idle_wdog;
 };
 
 /** device structure for interrupt handler */
@@ -389,6 +397,83 @@ static void ua_xmitchars(struct tsb_uart_info *uart_info)
     }
 }
 
+/**
+ * @brief Complete the pending receive.
+ *
+ * Disables the receive interrupt and reports the received data to the caller,
+ * either through the callback or by waking up the blocked receiver.
+ *
+ * @param uart_info The UART driver info structure.
+ * @return None.
+ */
+static void ua_rx_complete(struct tsb_uart_info *uart_info)
+{
+    /* Disable receive interrupt */
+    ua_reg_bit_clr(uart_info->reg_base, UA_IER_DLH, UA_IER_ERBFI | UA_IER_ELSI);
+
+    if (uart_info->rx_threshold) {
+        wd_cancel(uart_info->rx_idle_wdog);
+    }
+
+    uart_info->flags &= ~TSB_UART_FLAG_RECV;
+
+    if (uart_info->rx_callback) {
+        uart_info->rx_callback(uart_info->recv.buffer, uart_info->recv.head,
+                               uart_info->line_err);
+    }
+    else {
+        sem_post(&uart_info->rx_sem);
+    }
+}
+
+/**
+ * @brief Move characters from FIFO to the receive buffer.
+ *
+ * @param uart_info The UART driver info structure.
+ * @return true if the receive was completed (buffer full or line error).
+ */
+static bool ua_rx_drain(struct tsb_uart_info *uart_info)
+{
+    while (!ua_is_rx_fifo_empty(uart_info->reg_base)) {
+        uart_info->recv.buffer[uart_info->recv.head] =
+                        ua_getreg(uart_info->reg_base, UA_RBR_THR_DLL);
+        uart_info->recv.head++;
+
+        if (uart_info->recv.head == uart_info->recv.tail ||
+            uart_info->line_err) {
+            ua_rx_complete(uart_info);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * @brief Coalescing idle timer handler.
+ *
+ * Called when no character was received for the configured idle time, it
+ * reports whatever is buffered so far.
+ *
+ * @param argc The number of arguments.
+ * @param arg The UART driver info structure.
+ * @return None.
+ */
+static void ua_rx_idle_timeout(int argc, uint32_t arg)
+{
+    struct tsb_uart_info *uart_info = (struct tsb_uart_info *)arg;
+    irqstate_t flags;
+
+    flags = irqsave();
+
+    if ((uart_info->flags & TSB_UART_FLAG_RECV) &&
+        !ua_rx_drain(uart_info) && uart_info->recv.head > 0) {
+        ua_rx_complete(uart_info);
+    }
+
+    irqrestore(flags);
+}
+
 /**
  * @brief Receive characters from FIFO to buffer.
  *
@@ -414,39 +499,43 @@ static void ua_recvchars(struct tsb_uart_info *uart_info, uint8_t int_id)
         return;
     }
 
-    while (!ua_is_rx_fifo_empty(uart_info->reg_base)) {
-        uart_info->recv.buffer[uart_info->recv.head] =
-                        ua_getreg(uart_info->reg_base, UA_RBR_THR_DLL);
-        uart_info->recv.head++;
-        /*
-         * Three conditions will pause receiving and return to caller.
-         * 1. When given buffer is full, caller should prepare another buffer.
-         * 2. When receiving time out, it returns for the short data, for
-         *    instance, the OK response for modem. The time out is 4 characters
-         *    interval by hardware design.
-         * 3. Line err such as overrun, frame, parity and break;
-         * The FIFO still keeps data and receiving until FIFO get full, in auto
-         * flow control mode, UART controller will clean RTS to stop peer or the
-         * caller can use next tsb_uart_start_receiver() to continue data
-         * receiving by enalbing interrupt.
-         * It never clean the FIFO. Only stop_receiver() will clean the FIFO.
-         */
-        if (uart_info->recv.head == uart_info->recv.tail ||
-            int_id == UA_INTERRUPT_ID_TO || uart_info->line_err) {
-            /* Disable receive interrupt */
-            ua_reg_bit_clr(uart_info->reg_base, UA_IER_DLH,
-                           UA_IER_ERBFI | UA_IER_ELSI);
-
-            if (uart_info->rx_callback) {
-                uart_info->flags &= ~TSB_UART_FLAG_RECV;
-                uart_info->rx_callback(uart_info->recv.buffer,
-                                       uart_info->recv.head,
-                                       uart_info->line_err);
-            }
-            else {
-                sem_post(&uart_info->rx_sem);
-            }
+    /*
+     * Three conditions will pause receiving and return to caller.
+     * 1. When given buffer is full, caller should prepare another buffer.
+     * 2. When receiving time out, it returns for the short data, for
+     *    instance, the OK response for modem. The time out is 4 characters
+     *    interval by hardware design. In coalescing mode, the data is only
+     *    returned once rx_threshold bytes are buffered, or after the line
+     *    stayed idle for rx_idle_ticks.
+     * 3. Line err such as overrun, frame, parity and break;
+     * The FIFO still keeps data and receiving until FIFO get full, in auto
+     * flow control mode, UART controller will clean RTS to stop peer or the
+     * caller can use next tsb_uart_start_receiver() to continue data
+     * receiving by enalbing interrupt.
+     * It never clean the FIFO. Only stop_receiver() will clean the FIFO.
+     */
+    while (uart_info->flags & TSB_UART_FLAG_RECV) {
+        if (!ua_rx_drain(uart_info)) {
+            break;
         }
+        /* the callback may have provided a new buffer, keep draining */
+    }
+
+    if (!(uart_info->flags & TSB_UART_FLAG_RECV) ||
+        uart_info->recv.head == 0) {
+        return;
+    }
+
+    if (!uart_info->rx_threshold) {
+        if (int_id == UA_INTERRUPT_ID_TO) {
+            ua_rx_complete(uart_info);
+        }
+    } else if (uart_info->recv.head >= uart_info->rx_threshold) {
+        ua_rx_complete(uart_info);
+    } else {
+        /* (re)arm the idle timer from the last received character */
+        wd_start(uart_info->rx_idle_wdog, uart_info->rx_idle_ticks,
+                 (wdentry_t)ua_rx_idle_timeout, 1, (uint32_t)uart_info);
     }
 }
 
@@ -1064,6 +1153,9 @@ static int tsb_uart_stop_receiver(struct device *dev)
 
     /* Disable receive interrupt. */
     ua_reg_bit_clr(uart_info->reg_base, UA_IER_DLH, UA_IER_ERBFI | UA_IER_ELSI);
+    if (uart_info->rx_threshold) {
+        wd_cancel(uart_info->rx_idle_wdog);
+    }
     /* Clean FIFO */
     uart_info->fcr |= UA_RX_FIFO_RESET;
     ua_putreg(uart_info->reg_base, UA_FCR_IIR, uart_info->fcr);
@@ -1082,6 +1174,53 @@ static int tsb_uart_stop_receiver(struct device *dev)
     return 0;
 }
 
+/**
+* @brief Configure receive coalescing.
+*
+* In coalescing mode a receive is not completed on the hardware time out, but
+* once threshold bytes are buffered or the line stayed idle for idle_usecs,
+* so bursts of data are returned in fewer, fuller buffers. The idle time is
+* rounded up to the system tick.
+*
+* @param dev The pointer to the UART device structure.
+* @param threshold Number of bytes completing a receive, 0 to disable.
+* @param idle_usecs Idle time in microseconds completing a receive.
+* @return 0 for success, -errno for failure.
+*/
+static int tsb_uart_set_rx_coalescing(struct device *dev, int threshold,
+                                      int idle_usecs)
+{
+    struct tsb_uart_info *uart_info = NULL;
+    irqstate_t flags;
+
+    if (dev == NULL || threshold < 0 || idle_usecs < 0) {
+        return -EINVAL;
+    }
+
+    uart_info = device_get_private(dev);
+
+    if (threshold && !uart_info->rx_idle_wdog) {
+        return -ENOMEM;
+    }
+
+    flags = irqsave();
+
+    if (uart_info->rx_threshold) {
+        wd_cancel(uart_info->rx_idle_wdog);
+    }
+
+    uart_info->rx_threshold = threshold;
+    uart_info->rx_idle_ticks = (idle_usecs + USEC_PER_TICK - 1) /
+                               USEC_PER_TICK;
+    if (uart_info->rx_idle_ticks < 1) {
+        uart_info->rx_idle_ticks = 1;
+    }
+
+    irqrestore(flags);
+
+    return 0;
+}
+
 /**
 * @brief The device open function.
 *
@@ -1189,6 +1328,9 @@ static int tsb_uart_dev_probe(struct device *dev)
         goto err_destroy_tx_sem;
     }
 
+    /* Only needed in coalescing mode, set_rx_coalescing() checks for it */
+    uart_info->rx_idle_wdog = wd_create();
+
     flags = irqsave();
 
     ret = irq_attach(uart_info->uart_irq, ua_irq_handler);
@@ -1213,6 +1355,9 @@ static int tsb_uart_dev_probe(struct device *dev)
 
 err_destroy_rx_sem:
     irqrestore(flags);
+    if (uart_info->rx_idle_wdog) {
+        wd_delete(uart_info->rx_idle_wdog);
+    }
     sem_destroy(&uart_info->rx_sem);
 err_destroy_tx_sem:
     sem_destroy(&uart_info->tx_sem);
@@ -1239,6 +1384,10 @@ static void tsb_uart_dev_remove(struct device *dev)
 
     flags = irqsave();
 
+    if (uart_info->rx_idle_wdog) {
+        wd_delete(uart_info->rx_idle_wdog);
+    }
+
     sem_destroy(&uart_info->rx_sem);
 
     sem_destroy(&uart_info->tx_sem);
@@ -1266,6 +1415,7 @@ static struct device_uart_type_ops tsb_uart_type_ops = {
     .stop_transmitter   = tsb_uart_stop_transmitter,
     .start_receiver     = tsb_uart_start_receiver,
     .stop_receiver      = tsb_uart_stop_receiver,
+    .set_rx_coalescing  = tsb_uart_set_rx_coalescing,
 };
 
 static struct device_driver_ops tsb_uart_driver_ops = {
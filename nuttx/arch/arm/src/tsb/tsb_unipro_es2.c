@@ -29,9 +29,12 @@
  */
 
 #include <string.h>
+#include <unistd.h>
+#include <sched.h>
 #include <nuttx/util.h>
 #include <nuttx/irq.h>
 #include <nuttx/arch.h>
+#include <nuttx/clock.h>
 #include <nuttx/list.h>
 
 #include <nuttx/unipro/unipro.h>
@@ -76,11 +79,41 @@ struct cport {
     int connected;
 
     struct list_head tx_fifo;
+    enum unipro_tx_priority tx_prio;
 };
 
+#define APBRIDGE_CPORT_MAX 44 // number of CPorts available on the APBridges
+#define GPBRIDGE_CPORT_MAX 16 // number of CPorts available on the GPBridges
+
+#define TX_READY_WORDS     ((APBRIDGE_CPORT_MAX + 31) / 32)
+
+/*
+ * Bounds of the time the TX worker sleeps when no CPort TX FIFO can take
+ * any data. The interval doubles after each pass without progress, but
+ * never exceeds one system tick: nothing wakes the worker early when a
+ * FIFO drains, so this is also the worst latency added to a send.
+ */
+#define TX_BACKOFF_MIN_USEC MIN(100, USEC_PER_TICK)
+#define TX_BACKOFF_MAX_USEC USEC_PER_TICK
+
 struct worker {
     pthread_t thread;
     sem_t tx_fifo_lock;
+
+    /* CPorts with pending TX buffers, one bitmap per priority class */
+    uint32_t tx_ready[UNIPRO_TX_PRIO_COUNT][TX_READY_WORDS];
+    /* Next CPort to serve in each class, for round-robin */
+    unsigned int tx_next[UNIPRO_TX_PRIO_COUNT];
+};
+
+/*
+ * Number of times a ready CPort of each priority class gets to refill its
+ * TX FIFO during one scheduling pass.
+ */
+static const unsigned int tx_prio_weight[UNIPRO_TX_PRIO_COUNT] = {
+    [UNIPRO_TX_PRIO_HIGH]   = 4,
+    [UNIPRO_TX_PRIO_NORMAL] = 2,
+    [UNIPRO_TX_PRIO_LOW]    = 1,
 };
 
 static struct worker worker;
@@ -117,9 +150,6 @@ static struct device *dma_dev;
 static unsigned int dma_channel = DEVICE_DMA_INVALID_CHANNEL;
 #endif
 
-#define APBRIDGE_CPORT_MAX 44 // number of CPorts available on the APBridges
-#define GPBRIDGE_CPORT_MAX 16 // number of CPorts available on the GPBridges
-
 unsigned int unipro_cport_count(void) {
     /*
      * Reduce the run-time CPort count to what's available on the
@@ -150,7 +180,7 @@ static void configure_transfer_mode(int);
 static uint16_t unipro_get_tx_free_buffer_space(struct cport *cport);
 static inline void unipro_set_eom_flag(struct cport *cport);
 static int unipro_send_sync(unsigned int cportid,
-                            const void *buf, size_t len, bool som);
+                            const void *buf, size_t len, bool som, bool eom);
 static void dump_regs(void);
 
 /* irq handlers */
@@ -758,7 +788,24 @@ int unipro_init_cport(unsigned int cportid)
     return 0;
 }
 
-static void unipro_dequeue_tx_buffer(struct unipro_buffer *buffer, int status)
+/**
+ * @brief Mark a CPort as having (or not) TX buffers to send
+ * @note Must be called with interrupts disabled
+ */
+static inline void unipro_set_tx_ready(struct cport *cport, bool ready)
+{
+    uint32_t *word = &worker.tx_ready[cport->tx_prio][cport->cportid / 32];
+    uint32_t bit = 1U << (cport->cportid % 32);
+
+    if (ready) {
+        *word |= bit;
+    } else {
+        *word &= ~bit;
+    }
+}
+
+static void unipro_dequeue_tx_buffer(struct cport *cport,
+                                     struct unipro_buffer *buffer, int status)
 {
     irqstate_t flags;
 
@@ -766,6 +813,9 @@ static void unipro_dequeue_tx_buffer(struct unipro_buffer *buffer, int status)
 
     flags = irqsave();
     list_del(&buffer->list);
+    if (list_is_empty(&cport->tx_fifo)) {
+        unipro_set_tx_ready(cport, false);
+    }
     irqrestore(flags);
 
     if (buffer->callback) {
@@ -777,11 +827,11 @@ static void unipro_dequeue_tx_buffer(struct unipro_buffer *buffer, int status)
 
 /**
  * @brief           send data over given UniPro CPort
- * @return          0 on success, -EINVAL on invalid parameter,
- *                  -EBUSY when buffer could not be completely transferred
- *                  (unipro_send_tx_buffer() shall be called again until
- *                  buffer is entirely sent (return value == 0)).
- * @param[in]       operation: greybus loopback operation
+ * @return          number of bytes written into the CPort TX FIFO (0 when
+ *                  the FIFO is full or there is nothing to send), or
+ *                  -EINVAL on invalid parameter or when the buffer has been
+ *                  dropped.
+ * @param[in]       cport: CPort handle
  */
 static int unipro_send_tx_buffer(struct cport *cport)
 {
@@ -796,6 +846,7 @@ static int unipro_send_tx_buffer(struct cport *cport)
     flags = irqsave();
 
     if (list_is_empty(&cport->tx_fifo)) {
+        unipro_set_tx_ready(cport, false);
         irqrestore(flags);
         return 0;
     }
@@ -806,9 +857,10 @@ static int unipro_send_tx_buffer(struct cport *cport)
 
     retval = unipro_send_sync(cport->cportid,
                               buffer->data + buffer->byte_sent,
-                              buffer->len - buffer->byte_sent, buffer->som);
+                              buffer->len - buffer->byte_sent, buffer->som,
+                              true);
     if (retval < 0) {
-        unipro_dequeue_tx_buffer(buffer, retval);
+        unipro_dequeue_tx_buffer(cport, buffer, retval);
         lldbg("unipro_send_sync failed. Dropping message...\n");
         return -EINVAL;
     }
@@ -824,49 +876,161 @@ static int unipro_send_tx_buffer(struct cport *cport)
 #else
         unipro_set_eom_flag(cport);
 #endif
-        unipro_dequeue_tx_buffer(buffer, 0);
-        return 0;
+        unipro_dequeue_tx_buffer(cport, buffer, 0);
     }
 
-    return -EBUSY;
+    return retval;
+}
+
+/**
+ * @brief           Find the next CPort flagged in a ready bitmap
+ * @return          CPort ID, or -ENOENT if no CPort is flagged
+ * @param[in]       ready: bitmap of CPorts with pending TX buffers
+ * @param[in]       start: first CPort ID to look at, the search wraps around
+ */
+static int unipro_find_tx_ready(const uint32_t *ready, unsigned int start)
+{
+    unsigned int i;
+    unsigned int cportid;
+    uint32_t word;
+
+    for (i = 0; i <= TX_READY_WORDS; i++) {
+        cportid = ((start / 32 + i) % TX_READY_WORDS) * 32;
+        word = ready[cportid / 32];
+
+        /* Only look at CPorts >= start in the first word */
+        if (i == 0) {
+            word &= ~((1U << (start % 32)) - 1);
+        }
+
+        if (word) {
+            return cportid + __builtin_ffs(word) - 1;
+        }
+    }
+
+    return -ENOENT;
+}
+
+/**
+ * @brief           Run one scheduling pass over all ready CPorts
+ *
+ * Classes are served from highest to lowest priority. Within a class, each
+ * CPort ready at the beginning of the pass is served once, in round-robin
+ * order, and may refill its TX FIFO up to the class weight.
+ *
+ * @return          number of bytes written into the CPort TX FIFOs
+ */
+static int unipro_tx_schedule(void)
+{
+    uint32_t ready[TX_READY_WORDS];
+    enum unipro_tx_priority prio;
+    irqstate_t flags;
+    unsigned int w;
+    int cportid;
+    int progress = 0;
+    int retval;
+
+    for (prio = 0; prio < UNIPRO_TX_PRIO_COUNT; prio++) {
+        flags = irqsave();
+        memcpy(ready, worker.tx_ready[prio], sizeof(ready));
+        irqrestore(flags);
+
+        while ((cportid = unipro_find_tx_ready(ready,
+                                               worker.tx_next[prio])) >= 0) {
+            ready[cportid / 32] &= ~(1U << (cportid % 32));
+            worker.tx_next[prio] = (cportid + 1) % unipro_cport_count();
+
+            for (w = 0; w < tx_prio_weight[prio]; w++) {
+                retval = unipro_send_tx_buffer(cport_handle(cportid));
+                if (retval <= 0) {
+                    break;
+                }
+                progress += retval;
+            }
+        }
+    }
+
+    return progress;
+}
+
+static bool unipro_tx_pending(void)
+{
+    unsigned int prio;
+    unsigned int i;
+
+    for (prio = 0; prio < UNIPRO_TX_PRIO_COUNT; prio++) {
+        for (i = 0; i < TX_READY_WORDS; i++) {
+            if (worker.tx_ready[prio][i]) {
+                return true;
+            }
+        }
+    }
+
+    return false;
 }
 
 /**
  * @brief           Send data buffer(s) on CPort whenever ready.
- *                  Ensure that TX queues are reinspected until
- *                  all CPorts have no work available.
+ *                  Only the CPorts flagged in the ready bitmaps are
+ *                  visited, until all of them have no work available.
  *                  Then suspend again until new data is available.
+ *
+ * The ES2 UniPro controller has no interrupt signaling free space in a
+ * CPort TX FIFO, so when no FIFO could take any data during a pass the
+ * worker sleeps before polling the FIFOs again, backing off while they
+ * stay full, so that lower priority tasks get to run. This is a known
+ * limitation: a buffer queued while the FIFOs are full may wait up to one
+ * tick (TX_BACKOFF_MAX_USEC) after space frees up before it is sent.
  */
 static void *unipro_tx_worker(void *data)
 {
-    int i;
-    bool is_busy;
-    int retval;
+    useconds_t backoff;
 
     while (1) {
         /* Block until a buffer is pending on any CPort */
         sem_wait(&worker.tx_fifo_lock);
 
-        do {
-            is_busy = false;
-
-            for (i = 0; i < unipro_cport_count(); i++) {
-                /* Browse all CPorts sending any pending buffers */
-                retval = unipro_send_tx_buffer(cport_handle(i));
-                if (retval == -EBUSY) {
-                    /*
-                     * Buffer only partially sent, have to try again for
-                     * remaining part.
-                     */
-                    is_busy = true;
-                }
+        backoff = TX_BACKOFF_MIN_USEC;
+        while (unipro_tx_pending()) {
+            if (unipro_tx_schedule()) {
+                backoff = TX_BACKOFF_MIN_USEC;
+                continue;
             }
-        } while (is_busy); /* exit when CPort(s) current pending buffer sent */
+
+            usleep(backoff);
+            backoff = MIN(backoff * 2, TX_BACKOFF_MAX_USEC);
+        }
     }
 
     return NULL;
 }
 
+/**
+ * @brief           Set the scheduling class of a CPort for asynchronous TX
+ * @return          0 on success, -EINVAL on invalid parameter
+ * @param[in]       cportid: CPort ID
+ * @param[in]       priority: scheduling class
+ */
+int unipro_set_tx_priority(unsigned int cportid,
+                           enum unipro_tx_priority priority)
+{
+    struct cport *cport;
+    irqstate_t flags;
+
+    cport = cport_handle(cportid);
+    if (!cport || priority >= UNIPRO_TX_PRIO_COUNT) {
+        return -EINVAL;
+    }
+
+    flags = irqsave();
+    unipro_set_tx_ready(cport, false);
+    cport->tx_prio = priority;
+    unipro_set_tx_ready(cport, !list_is_empty(&cport->tx_fifo));
+    irqrestore(flags);
+
+    return 0;
+}
+
 /**
  * @brief Initialize the UniPro core
  */
@@ -905,6 +1069,7 @@ void unipro_init(void)
         cport->rx_buf = CPORT_RX_BUF(i);
         cport->cportid = i;
         cport->connected = 0;
+        cport->tx_prio = UNIPRO_TX_PRIO_NORMAL;
         list_init(&cport->tx_fifo);
     }
 
@@ -1000,6 +1165,7 @@ int unipro_send_async(unsigned int cportid, const void *buf, size_t len,
 
     flags = irqsave();
     list_add(&cport->tx_fifo, &buffer->list);
+    unipro_set_tx_ready(cport, true);
     irqrestore(flags);
 
     sem_post(&worker.tx_fifo_lock);
@@ -1014,11 +1180,46 @@ int unipro_send_async(unsigned int cportid, const void *buf, size_t len,
  * @param 0 on success, <0 on error
  */
 int unipro_send(unsigned int cportid, const void *buf, size_t len)
+{
+    struct iovec iov = {
+        .iov_base = (void *) buf,
+        .iov_len = len,
+    };
+
+    return unipro_send_iov(cportid, &iov, 1);
+}
+
+/**
+ * @brief send a message made of several buffers down a CPort
+ *
+ * The buffers are written one after the other in the CPort TX buffer, each
+ * of them with its own DMA transfer when DMA is in use, and the end of
+ * message is only flagged after the last one.
+ *
+ * @param cportid cport to send down
+ * @param iov buffers to send
+ * @param iovcnt number of buffers
+ * @param 0 on success, <0 on error
+ */
+int unipro_send_iov(unsigned int cportid, const struct iovec *iov, int iovcnt)
 {
     int ret, sent;
-    bool som;
+    int i, last;
+    size_t len;
+    bool som, eom;
     struct cport *cport;
 
+    /*
+     * The end of message is carried by the last non-empty fragment, as
+     * nothing is written to the CPort for an empty one.
+     */
+    for (len = 0, last = -1, i = 0; i < iovcnt; i++) {
+        len += iov[i].iov_len;
+        if (iov[i].iov_len) {
+            last = i;
+        }
+    }
+
     if (len > CPORT_BUF_SIZE) {
         return -EINVAL;
     }
@@ -1028,15 +1229,19 @@ int unipro_send(unsigned int cportid, const void *buf, size_t len)
         return -EINVAL;
     }
 
-    for (som = true, sent = 0; sent < len;) {
-        ret = unipro_send_sync(cportid, buf + sent, len - sent, som);
-        if (ret < 0) {
-            return ret;
-        } else if (ret == 0) {
-            continue;
+    for (som = true, i = 0; i < iovcnt; i++) {
+        eom = i == last;
+        for (sent = 0; sent < iov[i].iov_len;) {
+            ret = unipro_send_sync(cportid, iov[i].iov_base + sent,
+                                   iov[i].iov_len - sent, som, eom);
+            if (ret < 0) {
+                return ret;
+            } else if (ret == 0) {
+                continue;
+            }
+            sent += ret;
+            som = false;
         }
-        sent += ret;
-        som = false;
     }
 #ifdef CONFIG_ARCH_UNIPROTX_USE_DMA
     if (dma_channel == DEVICE_DMA_INVALID_CHANNEL) {
@@ -1056,9 +1261,10 @@ int unipro_send(unsigned int cportid, const void *buf, size_t len)
  * @param[in]       buf: data buffer
  * @param[in]       len: size of data to send
  * @param[in]       som: "start of message" flag
+ * @param[in]       eom: whether buf holds the end of the message
  */
 static int unipro_send_sync(unsigned int cportid,
-                            const void *buf, size_t len, bool som)
+                            const void *buf, size_t len, bool som, bool eom)
 {
     struct cport *cport;
     uint16_t count;
@@ -1105,7 +1311,8 @@ static int unipro_send_sync(unsigned int cportid,
     /* Copy message data in CPort Tx FIFO */
     DBG_UNIPRO("Sending %u bytes to CP%d\n", count, cportid);
 #ifdef CONFIG_ARCH_UNIPROTX_USE_DMA
-    tx_arg.unipro_tx_arg.eom_addr = (count == len) ? CPORT_EOM_BIT(cport) : NULL;
+    tx_arg.unipro_tx_arg.eom_addr = (eom && count == len) ?
+                                    CPORT_EOM_BIT(cport) : NULL;
 
     if (dma_channel == DEVICE_DMA_INVALID_CHANNEL) {
         memcpy(tx_buf, buf, count);
@@ -116,9 +116,18 @@
 #define BULKEP_TO_N(ep) \
   ((USB_EPNO(ep->eplog) - CONFIG_APBRIDGE_EPBULKOUT) >> 1)
 
+#define EPIN_TO_N(epno) \
+  (((int)USB_EPNO(epno) - CONFIG_APBRIDGE_EPBULKIN) >> 1)
+
 #define APBRIDGE_NREQS               (1)
 #define APBRIDGE_REQ_SIZE            (2048)
 
+/* Requests shared by the bulk IN endpoints */
+
+#ifndef CONFIG_APBRIDGE_BULKIN_NREQS
+#define CONFIG_APBRIDGE_BULKIN_NREQS (APBRIDGE_NREQS * APBRIDGE_NBULKS)
+#endif
+
 #define APBRIDGE_CONFIG_ATTR \
   USB_CONFIG_ATTR_ONE | \
   USB_CONFIG_ATTR_SELFPOWER | \
@@ -181,11 +190,14 @@ struct apbridge_req_s {
     struct list_head list;
     struct usbdev_req_s *req;   /* The contained request */
     void *priv;
+    struct usbdev_ep_s *ep;     /* Bulk OUT endpoint of the request */
+    int pending;                /* Messages of a bulk OUT request in use */
 };
 
+/* Message from UniPro waiting for a bulk IN request */
+
 struct apbridge_msg_s {
     struct list_head list;
-    struct usbdev_ep_s *ep;
     const void *buf;
     size_t len;
 };
@@ -204,7 +216,10 @@ struct apbridge_dev_s {
     struct list_head rdreq;
     struct list_head wrreq;
 
-    struct list_head msg_queue;
+    /* Messages waiting for a request, per bulk IN endpoint */
+    struct list_head msg_queue[APBRIDGE_NBULKS];
+    struct apbridge_msg_s *cport_msg;
+    int next_epin_n;            /* Next bulk IN endpoint to serve */
 
     int *cport_to_epin_n;
     int epout_to_cport_n[APBRIDGE_NBULKS];
@@ -448,57 +463,13 @@ static void put_request(struct list_head *list, struct usbdev_req_s *req)
     list_add(list, &reqcontainer->list);
 }
 
-static int apbridge_queue(struct apbridge_dev_s *priv, struct usbdev_ep_s *ep,
-                          const void *payload, size_t len)
-{
-    irqstate_t flags;
-    struct apbridge_msg_s *info;
-
-    info = malloc(sizeof(*info));
-    if (!info) {
-        return -ENOMEM;
-    }
-
-    info->ep = ep;
-    info->buf = payload;
-    info->len = len;
-
-    flags = irqsave();
-    list_add(&priv->msg_queue, &info->list);
-    irqrestore(flags);
-
-    return OK;
-}
-
-static struct apbridge_msg_s *apbridge_dequeue(struct apbridge_dev_s *priv)
-{
-    irqstate_t flags;
-    struct list_head *list;
-
-    flags = irqsave();
-    if (list_is_empty(&priv->msg_queue)) {
-        irqrestore(flags);
-        return NULL;
-    }
-
-    list = priv->msg_queue.next;
-    list_del(list);
-    irqrestore(flags);
-    return list_entry(list, struct apbridge_msg_s, list);
-}
-
 static int _to_usb_submit(struct usbdev_ep_s *ep, struct usbdev_req_s *req,
-                          const void *payload, size_t len)
+                          size_t len)
 {
     int ret;
-    unsigned int cportid;
 
     req->len = len;
     req->flags = USBDEV_REQFLAGS_NULLPKT;
-    memcpy(req->buf, payload, len);
-
-    cportid = get_cportid(payload);
-    unipro_unpause_rx(cportid);
 
     /* Then submit the request to the endpoint */
 
@@ -511,24 +482,91 @@ static int _to_usb_submit(struct usbdev_ep_s *ep, struct usbdev_req_s *req,
     return 0;
 }
 
+/**
+ * @brief Copy a message in a request buffer and resume its cport
+ * @param req request to copy the message to
+ * @param offset offset of the message in the request buffer
+ * @param payload message to copy
+ * @param len size of the message
+ * @return offset of the end of the message in the request buffer
+ */
+
+static size_t apbridge_copy_msg(struct usbdev_req_s *req, size_t offset,
+                                const void *payload, size_t len)
+{
+    memcpy((uint8_t *)req->buf + offset, payload, len);
+    unipro_unpause_rx(get_cportid(payload));
+    return offset + len;
+}
+
+/**
+ * @brief Fill a request with the messages waiting on a bulk IN endpoint
+ * With aggregation, messages are packed in the request as long as they fit,
+ * otherwise only the oldest one is sent.
+ * Must be called with interrupts disabled.
+ * @param priv usb device.
+ * @param n index of the bulk IN endpoint
+ * @param req request to fill
+ * @return size of the transfer
+ */
+
+static size_t apbridge_fill_request(struct apbridge_dev_s *priv, int n,
+                                    struct usbdev_req_s *req)
+{
+    struct apbridge_msg_s *msg;
+    size_t len = 0;
+
+    while (!list_is_empty(&priv->msg_queue[n])) {
+        msg = list_entry(priv->msg_queue[n].next, struct apbridge_msg_s, list);
+        if (len + msg->len > APBRIDGE_REQ_SIZE)
+            break;
+
+        list_del(&msg->list);
+        len = apbridge_copy_msg(req, len, msg->buf, msg->len);
+#ifndef CONFIG_APBRIDGE_USB_AGGREGATION
+        break;
+#endif
+    }
+
+    return len;
+}
+
 static int _to_usb(struct apbridge_dev_s *priv, uint8_t epno,
                    const void *payload, size_t len)
 {
-    struct list_head *list;
+    irqstate_t flags;
+    struct apbridge_msg_s *msg;
     struct usbdev_ep_s *ep;
     struct usbdev_req_s *req;
+    int n = EPIN_TO_N(epno);
 
-    list = epno_to_req_list(priv, epno);
-    if (!list)
+    if (n < 0 || n >= APBRIDGE_NBULKS)
         return -EINVAL;
 
-    req = get_request(list);
-    ep = priv->ep[epno & USB_EPNO_MASK];
+    ep = priv->ep[USB_EPNO(epno)];
+
+    flags = irqsave();
+    req = get_request(&priv->wrreq);
     if (!req) {
-        return apbridge_queue(priv, ep, payload, len);
+        /*
+         * A cport has a single queue entry. The UniPro RX stays paused until
+         * the message is copied, but other senders are not held back, so
+         * make them retry rather than overwrite the waiting message.
+         */
+        msg = &priv->cport_msg[get_cportid(payload)];
+        if (!list_is_empty(&msg->list)) {
+            irqrestore(flags);
+            return -EBUSY;
+        }
+        msg->buf = payload;
+        msg->len = len;
+        list_add(&priv->msg_queue[n], &msg->list);
+        irqrestore(flags);
+        return 0;
     }
+    irqrestore(flags);
 
-    return _to_usb_submit(ep, req, payload, len);
+    return _to_usb_submit(ep, req, apbridge_copy_msg(req, 0, payload, len));
 }
 
 /**
@@ -536,7 +574,8 @@ static int _to_usb(struct apbridge_dev_s *priv, uint8_t epno,
  * priv usb device.
  * param payload data to send from SVC
  * size of data to send on unipro
- * @return 0 in success or -EINVAL if len is too big
+ * @return 0 in success, -EINVAL if len is too big or -EBUSY if a message
+ *         of the same cport is still waiting for a request
  */
 
 int unipro_to_usb(struct apbridge_dev_s *priv, const void *payload,
@@ -554,33 +593,49 @@ int unipro_to_usb(struct apbridge_dev_s *priv, const void *payload,
     return _to_usb(priv, epno, payload, len);
 }
 
+/**
+ * @brief Drop a reference on a bulk OUT request
+ * The request is queued again on its endpoint once all the messages it
+ * holds have been released.
+ * @param priv usb device.
+ * @param req bulk OUT request
+ * @return 0 in success or a negative errno if the request can't be queued
+ */
+
+static int apbridge_put_rdreq(struct apbridge_dev_s *priv,
+                              struct usbdev_req_s *req)
+{
+    struct apbridge_req_s *reqcontainer = req->priv;
+    irqstate_t flags;
+    int ret;
+
+    flags = irqsave();
+    if (--reqcontainer->pending) {
+        irqrestore(flags);
+        return 0;
+    }
+    irqrestore(flags);
+
+    ret = EP_SUBMIT(reqcontainer->ep, req);
+    if (ret != OK) {
+        usbtrace(TRACE_CLSERROR(USBSER_TRACEERR_RDSUBMIT), (uint16_t) -ret);
+    }
+    return ret;
+}
+
 int usb_release_buffer(struct apbridge_dev_s *priv, const void *buf)
 {
-    struct list_head *iter, *next;
+    struct list_head *iter;
     struct usbdev_req_s *req;
     struct apbridge_req_s *reqcontainer;
-    int i, j;
-    int ret = 0;
 
-    iter = priv->rdreq.next;
-    next = iter->next;
-    for (i = 0; i < APBRIDGE_NBULKS; i++) {
-        for (j = 0; j < APBRIDGE_NREQS; j++) {
-            reqcontainer = list_entry(iter, struct apbridge_req_s, list);
-            req = reqcontainer->req;
-
-            if (req->buf == buf) {
-                ret = EP_SUBMIT(priv->ep[CONFIG_APBRIDGE_EPBULKOUT + i * 2],
-                                req);
-                if (ret != OK) {
-                    usbtrace(TRACE_CLSERROR(USBSER_TRACEERR_RDSUBMIT),
-                             (uint16_t) -ret);
-                }
-                return ret;
-            }
+    list_foreach(&priv->rdreq, iter) {
+        reqcontainer = list_entry(iter, struct apbridge_req_s, list);
+        req = reqcontainer->req;
 
-            iter = next;
-            next = next->next;
+        if ((const uint8_t *)buf >= (uint8_t *)req->buf &&
+            (const uint8_t *)buf < (uint8_t *)req->buf + APBRIDGE_REQ_SIZE) {
+            return apbridge_put_rdreq(priv, req);
         }
     }
 
@@ -932,9 +987,9 @@ static int usbclass_setconfig(struct apbridge_dev_s *priv, uint8_t config)
     for (i = 0; i < APBRIDGE_NBULKS; i++) {
         for (j = 0; j < APBRIDGE_NREQS; j++) {
             reqcontainer = list_entry(iter, struct apbridge_req_s, list);
+            reqcontainer->ep = priv->ep[CONFIG_APBRIDGE_EPBULKOUT + i * 2];
             req = reqcontainer->req;
-            ret = EP_SUBMIT(priv->ep[CONFIG_APBRIDGE_EPBULKOUT + i * 2],
-                            req);
+            ret = EP_SUBMIT(reqcontainer->ep, req);
             iter = next;
             next = next->next;
 
@@ -997,14 +1052,65 @@ static void usbclass_ep0incomplete(struct usbdev_ep_s *ep,
  *
  ****************************************************************************/
 
+/**
+ * @brief Hand the Greybus messages of a bulk OUT transfer to the backend
+ * With aggregation, a transfer can hold several messages, each one starting
+ * with its header. The request is queued again once all of them have been
+ * released.
+ * @param priv usb device.
+ * @param ep bulk OUT endpoint
+ * @param req completed request
+ */
+
+static void apbridge_split_transfer(struct apbridge_dev_s *priv,
+                                    struct usbdev_ep_s *ep,
+                                    struct usbdev_req_s *req)
+{
+    struct apbridge_req_s *reqcontainer = req->priv;
+    struct apbridge_usb_driver *drv = priv->driver;
+    struct gb_operation_hdr *hdr;
+    irqstate_t flags;
+    size_t offset = 0;
+    size_t len;
+    int ep_n = BULKEP_TO_N(ep);
+    unsigned int cportid;
+
+    /* Hold the request until all the messages have been handed over */
+    reqcontainer->pending = 1;
+
+    while (offset < req->xfrd) {
+        hdr = (struct gb_operation_hdr *)((uint8_t *)req->buf + offset);
+        len = req->xfrd - offset;
+#ifdef CONFIG_APBRIDGE_USB_AGGREGATION
+        if (len < sizeof(*hdr) || le16_to_cpu(hdr->size) < sizeof(*hdr) ||
+            le16_to_cpu(hdr->size) > len)
+            break;
+        len = le16_to_cpu(hdr->size);
+#endif
+
+        /* Legacy ep: copy from payload cportid */
+        if (ep_n != 0 && len >= sizeof(*hdr)) {
+            cportid = priv->epout_to_cport_n[ep_n];
+            hdr->pad[0] = cportid & 0xff;
+            hdr->pad[1] = (cportid >> 8) & 0xff;
+        }
+
+        flags = irqsave();
+        reqcontainer->pending++;
+        irqrestore(flags);
+
+        if (drv->usb_to_unipro(priv, hdr, len) < 0)
+            apbridge_put_rdreq(priv, req);
+        offset += len;
+    }
+
+    apbridge_put_rdreq(priv, req);
+}
+
 static void usbclass_rdcomplete(struct usbdev_ep_s *ep,
                                 struct usbdev_req_s *req)
 {
     struct apbridge_dev_s *priv;
-    struct apbridge_usb_driver *drv;
-    struct gb_operation_hdr *hdr;
-    int ep_n;
-    unsigned int cportid;
 
     /* Sanity check */
 
@@ -1018,23 +1124,13 @@ static void usbclass_rdcomplete(struct usbdev_ep_s *ep,
     /* Extract references to private data */
 
     priv = (struct apbridge_dev_s *) ep->priv;
-    drv = priv->driver;
 
     /* Process the received data unless this is some unusual condition */
 
     switch (req->result) {
     case OK:                    /* Normal completion */
         usbtrace(TRACE_CLASSRDCOMPLETE, 0);
-        ep_n = BULKEP_TO_N(ep);
-        /* Legacy ep: copy from payload cportid */
-        if (ep_n != 0) {
-            hdr = (struct gb_operation_hdr *)req->buf;
-            cportid = priv->epout_to_cport_n[ep_n];
-            hdr->pad[0] = cportid & 0xff;
-            hdr->pad[1] = (cportid >> 8) & 0xff;
-        }
-
-        drv->usb_to_unipro(priv, req->buf , req->xfrd);
+        apbridge_split_transfer(priv, ep, req);
         break;
 
     case -ESHUTDOWN:           /* Disconnection */
@@ -1051,9 +1147,11 @@ static void usbclass_rdcomplete(struct usbdev_ep_s *ep,
 static void usbclass_wrcomplete(struct usbdev_ep_s *ep,
                               struct usbdev_req_s *req)
 {
-    struct list_head *list;
-    struct apbridge_msg_s *info;
     struct apbridge_dev_s *priv;
+    irqstate_t flags;
+    size_t len = 0;
+    int n;
+    int i;
 
     /* Sanity check */
 #ifdef CONFIG_DEBUG
@@ -1064,14 +1162,23 @@ static void usbclass_wrcomplete(struct usbdev_ep_s *ep,
 #endif
 
     priv = (struct apbridge_dev_s *) ep->priv;
-    info = apbridge_dequeue(priv);
-    if (info) {
-        _to_usb_submit(info->ep, req, info->buf, info->len);
-        free(info);
-    } else {
-        list = epno_to_req_list(priv, USB_EPNO(ep->eplog));
-        put_request(list, req);
+
+    /*
+     * Reuse the request for the next endpoint with waiting messages, in
+     * turn, so that a busy endpoint can't hold back the others.
+     */
+    flags = irqsave();
+    for (i = 0; i < APBRIDGE_NBULKS && !len; i++) {
+        n = priv->next_epin_n;
+        priv->next_epin_n = (n + 1) % APBRIDGE_NBULKS;
+        len = apbridge_fill_request(priv, n, req);
     }
+    if (!len)
+        put_request(&priv->wrreq, req);
+    irqrestore(flags);
+
+    if (len)
+        _to_usb_submit(priv->ep[CONFIG_APBRIDGE_EPBULKIN + n * 2], req, len);
 
     switch (req->result) {
     case OK:                   /* Normal completion */
@@ -1250,7 +1357,7 @@ static int usbclass_bind(struct usbdevclass_driver_s *driver,
     list_init(&priv->wrreq);
     prealloc_request(priv->ep[CONFIG_APBRIDGE_EPBULKIN],
                      usbclass_wrcomplete, APBRIDGE_REQ_SIZE,
-                     APBRIDGE_NREQS * APBRIDGE_NBULKS);
+                     CONFIG_APBRIDGE_BULKIN_NREQS);
 
     /* Report if we are selfpowered */
 
@@ -1713,8 +1820,22 @@ int usbdev_apbinitialize(struct device *dev,
     for (i = 0; i < unipro_cport_count(); i++) {
         priv->cport_to_epin_n[i] = CONFIG_APBRIDGE_EPBULKIN;
     }
+
+    priv->cport_msg = kmm_zalloc(sizeof(struct apbridge_msg_s) *
+                                 unipro_cport_count());
+    if (!priv->cport_msg) {
+        ret = -ENOMEM;
+        goto errout_cport_table;
+    }
+
+    for (i = 0; i < unipro_cport_count(); i++) {
+        list_init(&priv->cport_msg[i].list);
+    }
+
     sem_init(&priv->config_sem, 0, 0);
-    list_init(&priv->msg_queue);
+    for (i = 0; i < APBRIDGE_NBULKS; i++) {
+        list_init(&priv->msg_queue[i]);
+    }
 
     /* Initialize the USB class driver structure */
 
@@ -1740,6 +1861,7 @@ int usbdev_apbinitialize(struct device *dev,
  errout_with_init:
     device_usbdev_unregister_gadget(dev, &drvr->drvr);
 errout_cport_table:
+    kmm_free(priv->cport_msg);
     kmm_free(priv->cport_to_epin_n);
  errout_with_alloc:
     kmm_free(alloc);
@@ -188,6 +188,62 @@ int switch_dme_peer_get(struct tsb_switch *sw,
     return sw->ops->peer_get(sw, portid, attrid, select_index, attr_value);
 }
 
+static int switch_dme_op(struct tsb_switch *sw, struct switch_dme_op *op) {
+    switch (op->flags & (SWITCH_DME_OP_GET | SWITCH_DME_OP_PEER)) {
+    case 0:
+        return switch_dme_set(sw, op->portid, op->attrid, op->select_index,
+                              op->value);
+    case SWITCH_DME_OP_GET:
+        return switch_dme_get(sw, op->portid, op->attrid, op->select_index,
+                              &op->value);
+    case SWITCH_DME_OP_PEER:
+        return switch_dme_peer_set(sw, op->portid, op->attrid,
+                                   op->select_index, op->value);
+    default:
+        return switch_dme_peer_get(sw, op->portid, op->attrid,
+                                   op->select_index, &op->value);
+    }
+}
+
+/**
+ * @brief Perform a sequence of DME attribute accesses
+ *
+ * The switch driver may pipeline the accesses, sending the next requests
+ * before the previous ones are confirmed, so a failed access does not
+ * prevent the following ones from being applied. The result of each access
+ * is stored in its result field; after a communication error, the accesses
+ * that were not performed get the same error.
+ *
+ * @param sw Switch handle
+ * @param ops Accesses to perform, in order
+ * @param count Number of accesses
+ * @return 0 if all accesses succeeded, the first non-zero result otherwise
+ */
+int switch_dme_batch(struct tsb_switch *sw,
+                     struct switch_dme_op *ops,
+                     size_t count) {
+    size_t i;
+    int rc = 0;
+
+    if (sw->ops->dme_batch) {
+        return sw->ops->dme_batch(sw, ops, count);
+    }
+
+    for (i = 0; i < count; i++) {
+        if (rc < 0) {
+            ops[i].result = rc;
+            continue;
+        }
+
+        ops[i].result = switch_dme_op(sw, &ops[i]);
+        if (!rc) {
+            rc = ops[i].result;
+        }
+    }
+
+    return rc;
+}
+
 int switch_port_irq_enable(struct tsb_switch *sw,
                            uint8_t portid,
                            bool enable) {
@@ -478,74 +534,55 @@ int switch_irq_handler(struct tsb_switch *sw) {
     return sw->ops->switch_irq_handler(sw);
 }
 
-static int switch_set_port_l4attr(struct tsb_switch *sw,
-                                  uint8_t portid,
-                                  uint16_t attrid,
-                                  uint16_t selector,
-                                  uint32_t val) {
-    int rc;
-
-    if (portid == SWITCH_PORT_ID) {
-        rc = switch_dme_set(sw, portid, attrid, selector, val);
-    } else {
-        rc = switch_dme_peer_set(sw, portid, attrid, selector, val);
-    }
-
-    return rc;
-}
-
-static int switch_get_port_l4attr(struct tsb_switch *sw,
-                                  uint8_t portid,
-                                  uint16_t attrid,
-                                  uint16_t selector,
-                                  uint32_t *val) {
-    int rc;
-
-    if (portid == SWITCH_PORT_ID) {
-        rc = switch_dme_get(sw, portid, attrid, selector, val);
-    } else {
-        rc = switch_dme_peer_get(sw, portid, attrid, selector, val);
-    }
-
-    return rc;
+/* Max number of DME accesses queued by switch_cport_connect() at once */
+#define SWITCH_CONNECT_MAX_OPS      (16)
+
+static struct switch_dme_op *switch_queue_port_l4attr(struct switch_dme_op *op,
+                                                      uint8_t portid,
+                                                      uint16_t attrid,
+                                                      uint16_t selector,
+                                                      uint32_t val,
+                                                      uint8_t flags) {
+    op->portid = portid;
+    op->flags = flags;
+    if (portid != SWITCH_PORT_ID) {
+        op->flags |= SWITCH_DME_OP_PEER;
+    }
+    op->attrid = attrid;
+    op->select_index = selector;
+    op->value = val;
+
+    return op + 1;
 }
 
-
-static int switch_set_pair_attr(struct tsb_switch *sw,
-                                struct unipro_connection *c,
-                                uint16_t attrid,
-                                uint32_t val0,
-                                uint32_t val1) {
-    int rc;
-    rc = switch_set_port_l4attr(sw,
-            c->port_id0,
-            attrid,
-            c->cport_id0,
-            val0);
-    if (rc) {
-        return rc;
-    }
-
-    rc = switch_set_port_l4attr(sw,
-            c->port_id1,
-            attrid,
-            c->cport_id1,
-            val1);
-    if (rc) {
-        return rc;
-    }
-
-    return 0;
+static struct switch_dme_op *switch_queue_pair_attr(struct switch_dme_op *op,
+                                                    struct unipro_connection *c,
+                                                    uint16_t attrid,
+                                                    uint32_t val0,
+                                                    uint32_t val1) {
+    op = switch_queue_port_l4attr(op, c->port_id0, attrid, c->cport_id0,
+                                  val0, 0);
+    return switch_queue_port_l4attr(op, c->port_id1, attrid, c->cport_id1,
+                                    val1, 0);
 }
 
+/*
+ * The attributes are set in batches, each batch only being sent once the
+ * previous one has succeeded, so that a connection is never established
+ * after a failure.
+ */
 static int switch_cport_connect(struct tsb_switch *sw,
                                 struct unipro_connection *c) {
     int e2efc_enabled = (!!(c->flags & CPORT_FLAGS_E2EFC) == 1);
     int csd_enabled = (!!(c->flags & CPORT_FLAGS_CSD_N) == 0);
+    struct switch_dme_op ops[SWITCH_CONNECT_MAX_OPS];
+    struct switch_dme_op *op;
+    struct switch_dme_op *local = NULL;
     int rc = 0;
 
     /* Disable any existing connection(s). */
-    rc = switch_set_pair_attr(sw, c, T_CONNECTIONSTATE, 0, 0);
+    op = switch_queue_pair_attr(ops, c, T_CONNECTIONSTATE, 0, 0);
+    rc = switch_dme_batch(sw, ops, op - ops);
     if (rc) {
         return rc;
     }
@@ -553,42 +590,31 @@ static int switch_cport_connect(struct tsb_switch *sw,
     /*
      * Point each device at the other.
      */
-    rc = switch_set_pair_attr(sw,
-                              c,
-                              T_PEERDEVICEID,
-                              c->device_id1,
-                              c->device_id0);
-    if (rc) {
-        return rc;
-    }
+    op = switch_queue_pair_attr(ops,
+                                c,
+                                T_PEERDEVICEID,
+                                c->device_id1,
+                                c->device_id0);
 
     /*
      * Point each CPort at the other.
      */
-    rc = switch_set_pair_attr(sw, c, T_PEERCPORTID, c->cport_id1, c->cport_id0);
-    if (rc) {
-        return rc;
-    }
+    op = switch_queue_pair_attr(op, c, T_PEERCPORTID, c->cport_id1,
+                                c->cport_id0);
 
     /*
      * Match up traffic classes.
      */
-    rc = switch_set_pair_attr(sw, c, T_TRAFFICCLASS, c->tc, c->tc);
-    if (rc) {
-        return rc;
-    }
+    op = switch_queue_pair_attr(op, c, T_TRAFFICCLASS, c->tc, c->tc);
 
     /*
      * Make sure the protocol IDs are equal. (We don't use them otherwise.)
      */
-    rc = switch_set_pair_attr(sw,
-                              c,
-                              T_PROTOCOLID,
-                              CPORT_DEFAULT_T_PROTOCOLID,
-                              CPORT_DEFAULT_T_PROTOCOLID);
-    if (rc) {
-        return rc;
-    }
+    op = switch_queue_pair_attr(op,
+                                c,
+                                T_PROTOCOLID,
+                                CPORT_DEFAULT_T_PROTOCOLID,
+                                CPORT_DEFAULT_T_PROTOCOLID);
 
     /*
      * Set default TxTokenValue and RxTokenValue values.
@@ -597,24 +623,16 @@ static int switch_cport_connect(struct tsb_switch *sw,
      * enabled, so don't change them to different values unless you
      * also patch up the E2EFC case, below.
      */
-    rc = switch_set_pair_attr(sw,
-                              c,
-                              T_TXTOKENVALUE,
-                              CPORT_DEFAULT_TOKENVALUE,
-                              CPORT_DEFAULT_TOKENVALUE);
-    if (rc) {
-        return rc;
-    }
-
-    rc = switch_set_pair_attr(sw,
-                              c,
-                              T_RXTOKENVALUE,
-                              CPORT_DEFAULT_TOKENVALUE,
-                              CPORT_DEFAULT_TOKENVALUE);
-    if (rc) {
-        return rc;
-    }
-
+    op = switch_queue_pair_attr(op,
+                                c,
+                                T_TXTOKENVALUE,
+                                CPORT_DEFAULT_TOKENVALUE,
+                                CPORT_DEFAULT_TOKENVALUE);
+    op = switch_queue_pair_attr(op,
+                                c,
+                                T_RXTOKENVALUE,
+                                CPORT_DEFAULT_TOKENVALUE,
+                                CPORT_DEFAULT_TOKENVALUE);
 
     /*
      * Set CPort flags.
@@ -622,10 +640,7 @@ static int switch_cport_connect(struct tsb_switch *sw,
      * (E2EFC needs to be the same on both sides, which is handled by
      * having a single flags value for now.)
      */
-    rc = switch_set_pair_attr(sw, c, T_CPORTFLAGS, c->flags, c->flags);
-    if (rc) {
-        return rc;
-    }
+    op = switch_queue_pair_attr(op, c, T_CPORTFLAGS, c->flags, c->flags);
 
     /*
      * If E2EFC is enabled, or E2EFC is disabled and CSD is enabled,
@@ -633,76 +648,60 @@ static int switch_cport_connect(struct tsb_switch *sw,
      * T_LocalBufferSpace.
      */
     if (e2efc_enabled || (!e2efc_enabled && csd_enabled)) {
-        uint32_t cport0_local = 0;
-        uint32_t cport1_local = 0;
-        rc = switch_get_port_l4attr(sw,
-                c->port_id0,
-                T_LOCALBUFFERSPACE,
-                c->cport_id0,
-                &cport0_local);
-        if (rc) {
-            return rc;
-        }
+        local = op;
+        op = switch_queue_port_l4attr(op, c->port_id0, T_LOCALBUFFERSPACE,
+                                      c->cport_id0, 0, SWITCH_DME_OP_GET);
+        op = switch_queue_port_l4attr(op, c->port_id1, T_LOCALBUFFERSPACE,
+                                      c->cport_id1, 0, SWITCH_DME_OP_GET);
+    }
 
-        rc = switch_get_port_l4attr(sw,
-                c->port_id1,
-                T_LOCALBUFFERSPACE,
-                c->cport_id1,
-                &cport1_local);
-        if (rc) {
-            return rc;
-        }
+    rc = switch_dme_batch(sw, ops, op - ops);
+    if (rc) {
+        return rc;
+    }
 
-        rc = switch_set_pair_attr(sw,
-                                  c,
-                                  T_LOCALBUFFERSPACE,
-                                  cport0_local,
-                                  cport1_local);
-        if (rc) {
-            return rc;
-        }
+    op = ops;
+    if (local) {
+        op = switch_queue_pair_attr(op,
+                                    c,
+                                    T_LOCALBUFFERSPACE,
+                                    local[0].value,
+                                    local[1].value);
     }
 
     /*
      * Ensure the CPorts aren't in test mode.
      */
-    rc = switch_set_pair_attr(sw,
-                              c,
-                              T_CPORTMODE,
-                              CPORT_MODE_APPLICATION,
-                              CPORT_MODE_APPLICATION);
-    if (rc) {
-        return rc;
-    }
+    op = switch_queue_pair_attr(op,
+                                c,
+                                T_CPORTMODE,
+                                CPORT_MODE_APPLICATION,
+                                CPORT_MODE_APPLICATION);
 
     /*
      * Clear out the credits to send on each side.
      */
-    rc = switch_set_pair_attr(sw, c, T_CREDITSTOSEND, 0, 0);
-    if (rc) {
-        return rc;
-    }
+    op = switch_queue_pair_attr(op, c, T_CREDITSTOSEND, 0, 0);
 
     /*
      * XXX Toshiba-specific TSB_MaxSegmentConfig (move to bridge ASIC code.)
      */
-    rc = switch_set_pair_attr(sw,
-                              c,
-                              TSB_MAXSEGMENTCONFIG,
-                              CPORT_DEFAULT_TSB_MAXSEGMENTCONFIG,
-                              CPORT_DEFAULT_TSB_MAXSEGMENTCONFIG);
+    op = switch_queue_pair_attr(op,
+                                c,
+                                TSB_MAXSEGMENTCONFIG,
+                                CPORT_DEFAULT_TSB_MAXSEGMENTCONFIG,
+                                CPORT_DEFAULT_TSB_MAXSEGMENTCONFIG);
+
+    rc = switch_dme_batch(sw, ops, op - ops);
     if (rc) {
         return rc;
     }
+
     /*
      * Establish the connections!
      */
-    rc = switch_set_pair_attr(sw, c, T_CONNECTIONSTATE, 1, 1);
-    if (rc) {
-        return rc;
-    }
-
-    return rc;
+    op = switch_queue_pair_attr(ops, c, T_CONNECTIONSTATE, 1, 1);
+    return switch_dme_batch(sw, ops, op - ops);
 }
 
 static int switch_cport_disconnect(struct tsb_switch *sw,
@@ -188,6 +188,26 @@ struct tsb_link_cfg {
     struct tsb_local_l2_timer_cfg tsb_l2tim_cfg;
 };
 
+/**
+ * @brief DME attribute access queued in a batch
+ *
+ * @see switch_dme_batch()
+ */
+struct switch_dme_op {
+    uint8_t portid;
+    /* Get the attribute instead of setting it */
+#   define SWITCH_DME_OP_GET    (1U << 0)
+    /* Access the attribute of the peer of the port */
+#   define SWITCH_DME_OP_PEER   (1U << 1)
+    uint8_t flags;
+    uint16_t attrid;
+    uint16_t select_index;
+    /* Value to set, or value read */
+    uint32_t value;
+    /* Result code of the access, or negative errno */
+    int result;
+};
+
 /**
  * Switch structs
  */
@@ -216,6 +236,9 @@ struct tsb_switch_ops {
                     uint16_t attrid,
                     uint16_t select_index,
                     uint32_t *attr_value);
+    int (*dme_batch)(struct tsb_switch *,
+                     struct switch_dme_op *ops,
+                     size_t count);
     int (*port_irq_enable)(struct tsb_switch *sw,
                            uint8_t port_id,
                            bool enable);
@@ -515,6 +538,10 @@ int switch_dme_peer_get(struct tsb_switch *sw,
                         uint16_t select_index,
                         uint32_t *attr_value);
 
+int switch_dme_batch(struct tsb_switch *sw,
+                     struct switch_dme_op *ops,
+                     size_t count);
+
 int switch_port_irq_enable(struct tsb_switch *sw,
                            uint8_t portid,
                            bool enable);
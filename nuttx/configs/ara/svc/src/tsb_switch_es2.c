@@ -64,6 +64,9 @@
 #define ES2_CPORT_NCP_MAX_PAYLOAD    (256)
 #define ES2_CPORT_DATA_MAX_PAYLOAD   (272)
 
+/* Max number of NCP requests sent ahead of their confirmation */
+#define ES2_NCP_PIPELINE_DEPTH       (8)
+
 struct es2_cport {
     pthread_mutex_t lock;
     uint8_t rxbuf[ES2_CPORT_RX_MAX_SIZE];
@@ -590,6 +593,43 @@ static uint32_t es2_mphy_trim_fixup_value(uint32_t mphy_trim[4], uint8_t port)
     }
 }
 
+/* Number of M-PHY fixups sent to the switch in a single batch */
+#define ES2_FIXUP_BATCH_SIZE    (16)
+
+/*
+ * Queue a fixup, sending the queued ones to the switch first if the batch
+ * is full or if the fixup must only be applied once the previous ones are
+ * known to have succeeded (i.e. the queue ends with a map change).
+ */
+static int es2_fixup_queue(struct tsb_switch *sw,
+                           struct switch_dme_op *ops, size_t *count,
+                           uint8_t port, uint16_t attrid,
+                           uint16_t select_index, uint32_t value)
+{
+    struct switch_dme_op *op;
+    int rc;
+
+    if (*count == ES2_FIXUP_BATCH_SIZE ||
+        (*count && ops[*count - 1].attrid == TSB_MPHY_MAP)) {
+        rc = switch_dme_batch(sw, ops, *count);
+        *count = 0;
+        if (rc) {
+            return rc;
+        }
+    }
+
+    dbg_verbose("%s: port=%u, attrid=0x%04x, select_index=%u, value=0x%02x\n",
+                __func__, port, attrid, select_index, value);
+
+    op = &ops[(*count)++];
+    op->portid = port;
+    op->flags = 0;
+    op->attrid = attrid;
+    op->select_index = select_index;
+    op->value = value;
+    return 0;
+}
+
 /*
  * Apply M-PHY fixups.
  *
@@ -599,6 +639,7 @@ static uint32_t es2_mphy_trim_fixup_value(uint32_t mphy_trim[4], uint8_t port)
  */
 static int es2_fixup_mphy(struct tsb_switch *sw)
 {
+    struct switch_dme_op ops[ES2_FIXUP_BATCH_SIZE];
     uint32_t mphy_trim[4];
     int rc;
     uint8_t port;
@@ -617,84 +658,53 @@ static int es2_fixup_mphy(struct tsb_switch *sw)
 
     for (port = 0; port < ES2_SWITCH_NUM_UNIPORTS; port++) {
         const struct tsb_mphy_fixup *fu;
+        uint16_t attrid;
+        uint32_t value;
+        size_t count = 0;
 
         /*
          * Apply the "register 2" map fixups.
          */
-        rc = switch_dme_set(sw, port, TSB_MPHY_MAP, 0,
-                            TSB_MPHY_MAP_TSB_REGISTER_2);
-        if (rc) {
-            dbg_error("%s(): failed to set switch map to \"TSB register 2\": %d\n",
-                      __func__, rc);
-            return rc;
-        }
+        rc = es2_fixup_queue(sw, ops, &count, port, TSB_MPHY_MAP, 0,
+                             TSB_MPHY_MAP_TSB_REGISTER_2);
         fu = tsb_register_2_map_mphy_fixups;
         do {
-            dbg_verbose("%s: port=%u, attrid=0x%04x, select_index=%u, value=0x%02x\n",
-                        __func__, port, fu->attrid, fu->select_index,
-                        fu->value);
-            rc = switch_dme_set(sw, port, fu->attrid, fu->select_index,
-                                fu->value);
-            if (rc) {
-                dbg_error("%s(): failed to apply register 2 map fixup: %d\n",
-                          __func__, rc);
-                return rc;
-            }
+            rc = rc ? rc : es2_fixup_queue(sw, ops, &count, port,
+                                           fu->attrid, fu->select_index,
+                                           fu->value);
         } while (!tsb_mphy_fixup_is_last(fu++));
 
-
-        /*
-         * Switch to "normal" map.
-         */
-        rc = switch_dme_set(sw, port, TSB_MPHY_MAP, 0,
-                            TSB_MPHY_MAP_NORMAL);
-        if (rc) {
-            dbg_error("%s(): failed to set switch map to normal: %d\n",
-                      __func__, rc);
-            return rc;
-        }
-
         /*
-         * Apply the "register 1" map fixups.
+         * Switch to "normal" map, then apply the "register 1" map fixups.
          */
-        rc = switch_dme_set(sw, port, TSB_MPHY_MAP, 0,
-                          TSB_MPHY_MAP_TSB_REGISTER_1);
-        if (rc) {
-            dbg_error("%s(): failed to switch to TSB register 1 map: %d\n",
-                      __func__, rc);
-            return rc;
-        }
+        rc = rc ? rc : es2_fixup_queue(sw, ops, &count, port, TSB_MPHY_MAP,
+                                       0, TSB_MPHY_MAP_NORMAL);
+        rc = rc ? rc : es2_fixup_queue(sw, ops, &count, port, TSB_MPHY_MAP,
+                                       0, TSB_MPHY_MAP_TSB_REGISTER_1);
         fu = tsb_register_1_map_mphy_fixups;
         do {
             if (tsb_mphy_r1_fixup_is_magic(fu)) {
                 /* The "magic" fixups for the switch come from the
                  * M-PHY trim values. */
-                uint32_t mpt = es2_mphy_trim_fixup_value(mphy_trim, port);
-                dbg_verbose("%s: port=%u, attrid=0x%04x, select_index=%u, value=0x%02x\n",
-                            __func__, port, 0x8002, 0, mpt);
-                rc = switch_dme_set(sw, port, 0x8002, 0, mpt);
+                attrid = 0x8002;
+                value = es2_mphy_trim_fixup_value(mphy_trim, port);
             } else {
-                dbg_verbose("%s: port=%u, attrid=0x%04x, select_index=%u, value=0x%02x\n",
-                            __func__, port, fu->attrid, fu->select_index,
-                            fu->value);
-                rc = switch_dme_set(sw, port, fu->attrid,
-                                    fu->select_index, fu->value);
-            }
-            if (rc) {
-                dbg_error("%s(): failed to apply register 1 map fixup: %d\n",
-                          __func__, rc);
-                return rc;
+                attrid = fu->attrid;
+                value = fu->value;
             }
+            rc = rc ? rc : es2_fixup_queue(sw, ops, &count, port, attrid,
+                                           fu->select_index, value);
         } while (!tsb_mphy_fixup_is_last(fu++));
 
         /*
          * Switch to "normal" map.
          */
-        rc = switch_dme_set(sw, port, TSB_MPHY_MAP, 0,
-                            TSB_MPHY_MAP_NORMAL);
+        rc = rc ? rc : es2_fixup_queue(sw, ops, &count, port, TSB_MPHY_MAP,
+                                       0, TSB_MPHY_MAP_NORMAL);
+        rc = rc ? rc : switch_dme_batch(sw, ops, count);
         if (rc) {
-            dbg_error("%s(): failed to re-set switch map to normal: %d\n",
-                      __func__, rc);
+            dbg_error("%s(): failed to apply M-PHY fixups to port %u: %d\n",
+                      __func__, port, rc);
             return rc;
         }
     }
@@ -1153,6 +1163,137 @@ static int es2_peer_get(struct tsb_switch *sw,
     return cnf.rc;
 }
 
+/**
+ * @brief Perform a sequence of DME accesses with pipelined NCP requests
+ *
+ * Up to ES2_NCP_PIPELINE_DEPTH requests are written to the NCP CPort before
+ * reading their confirmations back, so that the switch handles a request
+ * while the next ones are transferred. When the switch TX entry FIFO is
+ * full, the pending confirmations are read before writing more requests.
+ */
+static int es2_dme_batch(struct tsb_switch *sw,
+                         struct switch_dme_op *ops,
+                         size_t count)
+{
+    struct sw_es2_priv *priv = sw->priv;
+    struct switch_dme_op *op;
+    size_t sent = 0;
+    size_t done = 0;
+    size_t req_size;
+    size_t cnf_size;
+    uint8_t expected;
+    int first_rc = 0;
+    int rc = 0;
+
+    uint8_t req[11];
+
+    struct __attribute__ ((__packed__)) cnf {
+        uint8_t port_id;
+        uint8_t function_id;
+        uint8_t reserved;
+        uint8_t rc;
+        uint32_t attr_val;
+    } cnf;
+
+    pthread_mutex_lock(&priv->ncp_cport.lock);
+
+    while (done < count) {
+        /* Queue the next requests */
+        while (sent < count && sent - done < ES2_NCP_PIPELINE_DEPTH) {
+            op = &ops[sent];
+
+            req[0] = SWITCH_DEVICE_ID;
+            req[1] = op->portid;
+            req[2] = op->flags & SWITCH_DME_OP_PEER ? NCP_PEERSETREQ :
+                                                      NCP_SETREQ;
+            req[3] = op->attrid >> 8;
+            req[4] = op->attrid & 0xff;
+            req[5] = op->select_index >> 8;
+            req[6] = op->select_index & 0xff;
+            req_size = 7;
+
+            if (op->flags & SWITCH_DME_OP_GET) {
+                /* The GETREQ IDs follow the matching SETREQ IDs */
+                req[2] += NCP_GETREQ - NCP_SETREQ;
+            } else {
+                req[7] = (op->value >> 24) & 0xff;
+                req[8] = (op->value >> 16) & 0xff;
+                req[9] = (op->value >> 8) & 0xff;
+                req[10] = op->value & 0xff;
+                req_size = 11;
+            }
+
+            dbg_verbose("%s(): fid=0x%02x, portId=%d, attrId=0x%04x, selectIndex=%d, val=0x%04x\n",
+                        __func__, req[2], op->portid, op->attrid,
+                        op->select_index, op->value);
+
+            rc = es2_write(sw, CPORT_NCP, req, req_size);
+            if (rc == -EAGAIN && sent > done) {
+                /* Make room by reading the pending confirmations */
+                rc = 0;
+                break;
+            }
+            if (rc) {
+                dbg_error("%s() write failed: rc=%d\n", __func__, rc);
+                goto abort;
+            }
+            sent++;
+        }
+
+        /* Read the confirmation of the oldest request */
+        op = &ops[done];
+        if (op->flags & SWITCH_DME_OP_GET) {
+            expected = op->flags & SWITCH_DME_OP_PEER ? NCP_PEERGETCNF :
+                                                        NCP_GETCNF;
+            cnf_size = sizeof(struct cnf);
+        } else {
+            expected = op->flags & SWITCH_DME_OP_PEER ? NCP_PEERSETCNF :
+                                                        NCP_SETCNF;
+            cnf_size = sizeof(struct cnf) - sizeof(cnf.attr_val);
+        }
+
+        rc = es2_read(sw, CPORT_NCP, (uint8_t *) &cnf, cnf_size);
+        if (rc) {
+            dbg_error("%s() read failed: rc=%d\n", __func__, rc);
+            goto abort;
+        }
+
+        if (cnf.function_id != expected) {
+            dbg_error("%s(): unexpected CNF 0x%x\n", __func__,
+                      cnf.function_id);
+            rc = -EPROTO;
+            goto abort;
+        }
+
+        op->result = cnf.rc;
+        if (op->flags & SWITCH_DME_OP_GET) {
+            op->value = be32_to_cpu(cnf.attr_val);
+        }
+        if (op->result) {
+            dbg_error("%s(): portId=%u, attrId=0x%04x failed: rc=%d\n",
+                      __func__, op->portid, op->attrid, op->result);
+            if (!first_rc) {
+                first_rc = op->result;
+            }
+        }
+        done++;
+    }
+
+    pthread_mutex_unlock(&priv->ncp_cport.lock);
+    return first_rc;
+
+abort:
+    /*
+     * The switch state is unknown after a communication error: flag all
+     * the accesses that were not confirmed.
+     */
+    for (; done < count; done++) {
+        ops[done].result = rc;
+    }
+    pthread_mutex_unlock(&priv->ncp_cport.lock);
+    return first_rc ? first_rc : rc;
+}
+
 static int es2_lut_set(struct tsb_switch *sw,
                        uint8_t unipro_portid,
                        uint8_t lut_address,
@@ -1635,6 +1776,7 @@ static struct tsb_switch_ops es2_ops = {
 
     .peer_set              = es2_peer_set,
     .peer_get              = es2_peer_get,
+    .dme_batch             = es2_dme_batch,
 
     .lut_set               = es2_lut_set,
     .lut_get               = es2_lut_get,
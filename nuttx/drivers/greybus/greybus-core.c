@@ -32,47 +32,70 @@
 #include <nuttx/list.h>
 #include <nuttx/unipro/unipro.h>
 #include <nuttx/greybus/greybus.h>
-#include <nuttx/greybus/tape.h>
 #include <nuttx/greybus/debug.h>
 #include <nuttx/wdog.h>
+#include <nuttx/clock.h>
+#include <nuttx/hires_tmr.h>
 
 #include <arch/atomic.h>
 #include <arch/byteorder.h>
 
 #include <stdio.h>
+#include <stdint.h>
 #include <string.h>
+#include <sched.h>
 #include <errno.h>
 
+#include "greybus-core.h"
+
 #define DEFAULT_STACK_SIZE      2048
 #define TYPE_RESPONSE_FLAG      0x80
-#define TIMEOUT_IN_MS           1000
 #define GB_INVALID_TYPE         0
 
-#define ONE_SEC_IN_MSEC         1000
-#define ONE_MSEC_IN_NSEC        1000000
+#ifndef CONFIG_GREYBUS_RX_QUEUE_DEPTH
+#define CONFIG_GREYBUS_RX_QUEUE_DEPTH 0
+#endif
 
-#define TIMEOUT_WD_DELAY    (TIMEOUT_IN_MS * CLOCKS_PER_SEC) / ONE_SEC_IN_MSEC
+/* Number of buckets of the in-flight request table, must be a power of 2 */
+#define GB_INFLIGHT_HASH_SIZE   32
 
 struct gb_cport_driver {
     struct gb_driver *driver;
-    struct list_head tx_fifo;
+    struct list_head tx_fifo;   /* in-flight requests, sorted by deadline */
     struct list_head rx_fifo;
+    struct list_head rx_dropped; /* freed by the worker, not in the ISR */
     sem_t rx_fifo_lock;
     pthread_t thread;
     struct wdog_s timeout_wd;
     struct gb_operation timedout_operation;
+    struct gb_rx_queue_stats rx_queue; /* depth and is_paused unused */
+    bool is_rx_paused;          /* the transport waits for rx_resume() */
+#ifdef CONFIG_GREYBUS_STATS
+    struct gb_cport_stats stats;
+#endif
+#ifdef CONFIG_GREYBUS_SHARED_WORKERS
+    struct gb_worker_pool *pool; /* shared workers serving the cport */
+    bool is_scheduled;          /* queued on, or served by, a shared worker */
+    struct list_head run_list;
+#endif
 };
 
-struct gb_tape_record_header {
-    uint16_t size;
-    uint16_t cport;
+static atomic_t request_id;
+#ifdef CONFIG_GREYBUS_SHARED_WORKERS
+/* Shared workers running at a given priority */
+struct gb_worker_pool {
+    struct list_head list;
+    struct list_head run_queue;
+    sem_t run_queue_lock;
+    int priority;
+    int nworkers;
 };
 
-static atomic_t request_id;
+static struct list_head gb_worker_pools;
+#endif
+static struct list_head gb_inflight_hash[GB_INFLIGHT_HASH_SIZE];
 static struct gb_cport_driver *g_cport;
 static struct gb_transport_backend *transport_backend;
-static struct gb_tape_mechanism *gb_tape;
-static int gb_tape_fd = -EBADFD;
 static struct gb_operation_hdr timedout_hdr = {
     .size = sizeof(timedout_hdr),
     .result = GB_OP_TIMEOUT,
@@ -86,6 +109,215 @@ static struct gb_operation_hdr oom_hdr = {
 
 static void gb_operation_timeout(int argc, uint32_t cport, ...);
 
+#ifdef CONFIG_GREYBUS_OPERATION_POOL
+/*
+ * Fixed-size block pool. Free blocks are chained through their first word,
+ * and a block is identified as belonging to the pool by its address, so no
+ * per-block header is needed.
+ */
+struct gb_pool {
+    const char *name;
+    void *free_list;
+    char *base;
+    size_t block_size;
+    unsigned int count;
+
+    unsigned int in_use;
+    unsigned int max_in_use;
+    unsigned long hits;
+    unsigned long misses;
+};
+
+static struct gb_pool gb_pools[] = {
+    { .name = "operation" },
+    { .name = "small" },
+    { .name = "large" },
+};
+
+#define gb_operation_pool   (&gb_pools[0])
+#define gb_small_buf_pool   (&gb_pools[1])
+#define gb_large_buf_pool   (&gb_pools[2])
+
+static int gb_pool_init(struct gb_pool *pool, size_t block_size,
+                        unsigned int count)
+{
+    unsigned int i;
+
+    block_size = (block_size + sizeof(void *) - 1) & ~(sizeof(void *) - 1);
+
+    pool->block_size = block_size;
+    pool->count = count;
+    pool->free_list = NULL;
+
+    if (!count)
+        return 0;
+
+    pool->base = malloc(block_size * count);
+    if (!pool->base) {
+        pool->count = 0;
+        return -ENOMEM;
+    }
+
+    for (i = count; i > 0; i--) {
+        void **block = (void **) (pool->base + (i - 1) * block_size);
+        *block = pool->free_list;
+        pool->free_list = block;
+    }
+
+    return 0;
+}
+
+static void *gb_pool_get(struct gb_pool *pool)
+{
+    irqstate_t flags;
+    void **block;
+
+    flags = irqsave();
+
+    block = pool->free_list;
+    if (block) {
+        pool->free_list = *block;
+        pool->hits++;
+        if (++pool->in_use > pool->max_in_use)
+            pool->max_in_use = pool->in_use;
+    } else {
+        pool->misses++;
+    }
+
+    irqrestore(flags);
+
+    return block;
+}
+
+static bool gb_pool_put(struct gb_pool *pool, void *block)
+{
+    irqstate_t flags;
+
+    if ((char *) block < pool->base ||
+        (char *) block >= pool->base + pool->block_size * pool->count)
+        return false;
+
+    flags = irqsave();
+    *(void **) block = pool->free_list;
+    pool->free_list = block;
+    pool->in_use--;
+    irqrestore(flags);
+
+    return true;
+}
+
+static void *gb_buffer_alloc(size_t size)
+{
+    void *buffer = NULL;
+
+    if (size <= gb_small_buf_pool->block_size)
+        buffer = gb_pool_get(gb_small_buf_pool);
+
+    if (!buffer && size <= gb_large_buf_pool->block_size)
+        buffer = gb_pool_get(gb_large_buf_pool);
+
+    if (!buffer)
+        buffer = malloc(size);
+
+    return buffer;
+}
+
+static void gb_buffer_free(void *buffer)
+{
+    if (!buffer)
+        return;
+
+    if (gb_pool_put(gb_small_buf_pool, buffer) ||
+        gb_pool_put(gb_large_buf_pool, buffer))
+        return;
+
+    free(buffer);
+}
+
+static struct gb_operation *gb_operation_alloc(void)
+{
+    struct gb_operation *operation;
+
+    operation = gb_pool_get(gb_operation_pool);
+    if (!operation)
+        operation = malloc(sizeof(*operation));
+
+    return operation;
+}
+
+static void gb_operation_free(struct gb_operation *operation)
+{
+    if (!gb_pool_put(gb_operation_pool, operation))
+        free(operation);
+}
+
+static int gb_pools_init(void)
+{
+    int retval;
+
+    retval = gb_pool_init(gb_operation_pool, sizeof(struct gb_operation),
+                          CONFIG_GREYBUS_OPERATION_POOL_SIZE);
+    if (retval)
+        return retval;
+
+    retval = gb_pool_init(gb_small_buf_pool, CONFIG_GREYBUS_SMALL_BUF_SIZE,
+                          CONFIG_GREYBUS_SMALL_BUF_POOL_SIZE);
+    if (retval)
+        return retval;
+
+    return gb_pool_init(gb_large_buf_pool, CPORT_BUF_SIZE,
+                        CONFIG_GREYBUS_LARGE_BUF_POOL_SIZE);
+}
+
+int gb_pool_get_stats(unsigned int index, struct gb_pool_stats *stats)
+{
+    struct gb_pool *pool;
+    irqstate_t flags;
+
+    if (index >= ARRAY_SIZE(gb_pools) || !stats)
+        return -EINVAL;
+
+    pool = &gb_pools[index];
+
+    flags = irqsave();
+    stats->name = pool->name;
+    stats->block_size = pool->block_size;
+    stats->count = pool->count;
+    stats->in_use = pool->in_use;
+    stats->max_in_use = pool->max_in_use;
+    stats->hits = pool->hits;
+    stats->misses = pool->misses;
+    irqrestore(flags);
+
+    return 0;
+}
+#else
+static inline void *gb_buffer_alloc(size_t size)
+{
+    return malloc(size);
+}
+
+static inline void gb_buffer_free(void *buffer)
+{
+    free(buffer);
+}
+
+static inline struct gb_operation *gb_operation_alloc(void)
+{
+    return malloc(sizeof(struct gb_operation));
+}
+
+static inline void gb_operation_free(struct gb_operation *operation)
+{
+    free(operation);
+}
+
+static inline int gb_pools_init(void)
+{
+    return 0;
+}
+#endif
+
 uint8_t gb_errno_to_op_result(int err)
 {
     switch (err) {
@@ -148,46 +380,187 @@ static void op_mark_send_time(struct gb_operation *operation) { }
 static void op_mark_recv_time(struct gb_operation *operation) { }
 #endif
 
-static int gb_compare_handlers(const void *data1, const void *data2)
+#ifdef CONFIG_GREYBUS_STATS
+static void gb_histogram_add(struct gb_histogram *histogram, uint32_t usec)
 {
-    const struct gb_operation_handler *handler1 = data1;
-    const struct gb_operation_handler *handler2 = data2;
-    return (int)handler1->type - (int)handler2->type;
+    unsigned int bucket = usec ? 32 - __builtin_clz(usec) : 0;
+
+    if (bucket >= GB_HISTOGRAM_BUCKETS)
+        bucket = GB_HISTOGRAM_BUCKETS - 1;
+
+    histogram->buckets[bucket]++;
+    histogram->total += usec;
+    if (usec > histogram->max)
+        histogram->max = usec;
+    histogram->count++;
 }
 
-static struct gb_operation_handler *find_operation_handler(uint8_t type,
-                                                           unsigned int cport)
+static void gb_stats_rx(struct gb_operation *operation, size_t size)
 {
-    struct gb_driver *driver = g_cport[cport].driver;
-    int l,r;
+    struct gb_cport_stats *stats = &g_cport[operation->cport].stats;
+
+    operation->recv_usec = hrt_getusec();
+    stats->rx_messages++;
+    stats->rx_bytes += size;
+}
+
+static void gb_stats_tx(struct gb_operation *operation, size_t size)
+{
+    struct gb_cport_stats *stats = &g_cport[operation->cport].stats;
+
+    operation->send_usec = hrt_getusec();
+    atomic_inc(&stats->tx_messages);
+    atomic_add(&stats->tx_bytes, size);
+}
+
+static void gb_stats_dequeue(struct gb_operation *operation)
+{
+    gb_histogram_add(&g_cport[operation->cport].stats.queue_delay,
+                     hrt_getusec() - operation->recv_usec);
+}
+
+static void gb_stats_response(struct gb_operation *request,
+                              struct gb_operation *response)
+{
+    gb_histogram_add(&g_cport[request->cport].stats.round_trip,
+                     response->recv_usec - request->send_usec);
+}
+
+static uint32_t gb_stats_handler_start(void)
+{
+    return hrt_getusec();
+}
+
+static void gb_stats_handler_end(struct gb_operation *operation,
+                                 struct gb_operation_handler *op_handler,
+                                 uint32_t start)
+{
+    struct gb_cport_driver *cport = &g_cport[operation->cport];
+
+    if (!cport->stats.handler_time)
+        return;
+
+    gb_histogram_add(&cport->stats.handler_time[op_handler -
+                                                cport->driver->op_handlers],
+                     hrt_getusec() - start);
+}
+
+static int gb_stats_register(unsigned int cport, struct gb_driver *driver)
+{
+    if (!driver->op_handlers_count)
+        return 0;
+
+    g_cport[cport].stats.handler_time =
+        zalloc(driver->op_handlers_count * sizeof(struct gb_histogram));
+    return g_cport[cport].stats.handler_time ? 0 : -ENOMEM;
+}
 
-    if (type == GB_INVALID_TYPE || !driver->op_handlers) {
+static void gb_stats_unregister(unsigned int cport)
+{
+    free(g_cport[cport].stats.handler_time);
+    g_cport[cport].stats.handler_time = NULL;
+}
+
+struct gb_driver *gb_stats_get(unsigned int cport,
+                               struct gb_cport_stats **stats)
+{
+    if (!g_cport || cport >= unipro_cport_count())
         return NULL;
+
+    *stats = &g_cport[cport].stats;
+    return g_cport[cport].driver;
+}
+#else
+static void gb_stats_rx(struct gb_operation *operation, size_t size) { }
+static void gb_stats_tx(struct gb_operation *operation, size_t size) { }
+static void gb_stats_dequeue(struct gb_operation *operation) { }
+static void gb_stats_response(struct gb_operation *request,
+                              struct gb_operation *response) { }
+static uint32_t gb_stats_handler_start(void) { return 0; }
+static void gb_stats_handler_end(struct gb_operation *operation,
+                                 struct gb_operation_handler *op_handler,
+                                 uint32_t start) { }
+static int gb_stats_register(unsigned int cport, struct gb_driver *driver)
+{
+    return 0;
+}
+static void gb_stats_unregister(unsigned int cport) { }
+#endif
+
+/**
+ * Build the dispatch table of a driver
+ *
+ * The table maps each operation type to its handler, so that the handler of a
+ * message is found with a single lookup. It is only as large as the highest
+ * operation type of the driver, and is shared by all the cports the driver is
+ * registered on.
+ *
+ * @param driver Driver to build the table for
+ * @return 0 on success, -EINVAL if a handler has an invalid or a duplicated
+ *         operation type, -ENOMEM if the table cannot be allocated
+ */
+static int gb_build_dispatch_table(struct gb_driver *driver)
+{
+    struct gb_operation_handler **table;
+    size_t size = 0;
+    uint8_t type;
+    int i;
+
+    if (driver->dispatch_table || !driver->op_handlers_count)
+        return 0;
+
+    for (i = 0; i < driver->op_handlers_count; i++) {
+        type = driver->op_handlers[i].type;
+        if (type == GB_INVALID_TYPE || (type & TYPE_RESPONSE_FLAG)) {
+            gb_error("%s: invalid operation type %u\n",
+                     gb_driver_name(driver), type);
+            return -EINVAL;
+        }
+
+        if (type >= size)
+            size = type + 1;
     }
 
-    /* binary search -- bsearch from libc is not implemented by nuttx */
-    l = 0;
-    r = driver->op_handlers_count - 1;
-    while (l <= r) {
-        int m = (l + r) / 2;
-        if (driver->op_handlers[m].type < type)
-            l = m + 1;
-        else if (driver->op_handlers[m].type > type)
-            r = m - 1;
-        else
-            return &driver->op_handlers[m];
+    table = zalloc(size * sizeof(*table));
+    if (!table)
+        return -ENOMEM;
+
+    for (i = 0; i < driver->op_handlers_count; i++) {
+        type = driver->op_handlers[i].type;
+        if (table[type]) {
+            gb_error("%s: several handlers for operation type %u\n",
+                     gb_driver_name(driver), type);
+            free(table);
+            return -EINVAL;
+        }
+
+        table[type] = &driver->op_handlers[i];
     }
 
-    return NULL;
+    driver->dispatch_table = table;
+    driver->dispatch_table_size = size;
+
+    return 0;
+}
+
+static inline struct gb_operation_handler *
+find_operation_handler(uint8_t type, unsigned int cport)
+{
+    struct gb_driver *driver = g_cport[cport].driver;
+
+    if (type >= driver->dispatch_table_size)
+        return NULL;
+
+    return driver->dispatch_table[type];
 }
 
 static void gb_process_request(struct gb_operation_hdr *hdr,
                                struct gb_operation *operation)
 {
-    struct gb_operation_handler *op_handler;
+    struct gb_operation_handler *op_handler = operation->handler;
+    uint32_t start;
     uint8_t result;
 
-    op_handler = find_operation_handler(hdr->type, operation->cport);
     if (!op_handler) {
         gb_error("Cport %u: Invalid operation type %u\n",
                  operation->cport, hdr->type);
@@ -195,7 +568,9 @@ static void gb_process_request(struct gb_operation_hdr *hdr,
         return;
     }
 
+    start = gb_stats_handler_start();
     result = op_handler->handler(operation);
+    gb_stats_handler_end(operation, op_handler, start);
     gb_debug("%s: %u\n", gb_handler_name(op_handler), result);
 
     if (hdr->id)
@@ -203,67 +578,111 @@ static void gb_process_request(struct gb_operation_hdr *hdr,
     op_mark_send_time(operation);
 }
 
-static bool gb_operation_has_timedout(struct gb_operation *operation)
+static inline struct list_head *gb_inflight_bucket(uint16_t id)
 {
-    struct timespec current_time;
-    struct timespec timeout_time;
-
-    timeout_time.tv_sec = operation->time.tv_sec +
-                          TIMEOUT_IN_MS / ONE_SEC_IN_MSEC;
-    timeout_time.tv_nsec = operation->time.tv_nsec +
-                          (TIMEOUT_IN_MS % ONE_SEC_IN_MSEC) * ONE_MSEC_IN_NSEC;
-    clock_gettime(CLOCK_MONOTONIC, &current_time);
-
-    if (current_time.tv_sec > timeout_time.tv_sec)
-        return true;
-
-    if (current_time.tv_sec < timeout_time.tv_sec)
-        return false;
-
-    return current_time.tv_nsec > timeout_time.tv_nsec;
+    return &gb_inflight_hash[id & (GB_INFLIGHT_HASH_SIZE - 1)];
 }
 
 /**
  * Update watchdog state
  *
  * Cancel cport watchdog if there is no outgoing message waiting for a response,
- * or update the watchdog if there is still outgoing messages.
- *
- * TODO use fine-grain timeout delay when doing the update
+ * or re-arm it for the deadline of the oldest outgoing message.
  *
  * @note This function should be called from an atomic context
  */
 static void gb_watchdog_update(unsigned int cport)
 {
     irqstate_t flags;
+    struct gb_operation *op;
+    int32_t delay;
 
     flags = irqsave();
 
     if (list_is_empty(&g_cport[cport].tx_fifo)) {
         wd_cancel(&g_cport[cport].timeout_wd);
     } else {
-        wd_start(&g_cport[cport].timeout_wd, TIMEOUT_WD_DELAY,
+        op = list_entry(g_cport[cport].tx_fifo.next, struct gb_operation, list);
+        delay = (int32_t) (op->deadline - clock_systimer());
+        wd_start(&g_cport[cport].timeout_wd, delay > 0 ? delay : 1,
                  gb_operation_timeout, 1, cport);
     }
 
     irqrestore(flags);
 }
 
+/**
+ * Add a request to the in-flight table of its cport
+ *
+ * The request is hashed by ID for response matching, and inserted in the
+ * cport list sorted by deadline. Requests are usually sent with the same
+ * timeout, so the insertion point is found right away from the tail.
+ *
+ * @note This function should be called from an atomic context
+ */
+static void gb_operation_add_inflight(struct gb_operation *operation,
+                                      unsigned int timeout)
+{
+    struct gb_operation_hdr *hdr = operation->request_buffer;
+    struct list_head *tx_fifo = &g_cport[operation->cport].tx_fifo;
+    struct list_head *iter;
+    struct gb_operation *op;
+
+    operation->deadline = clock_systimer() + MSEC2TICK(timeout);
+
+    list_add(gb_inflight_bucket(le16_to_cpu(hdr->id)), &operation->hash_list);
+
+    list_reverse_foreach(tx_fifo, iter) {
+        op = list_entry(iter, struct gb_operation, list);
+        if ((int32_t) (op->deadline - operation->deadline) <= 0)
+            break;
+    }
+    list_add(iter->next, &operation->list);
+
+    if (tx_fifo->next == &operation->list)
+        gb_watchdog_update(operation->cport);
+}
+
+/**
+ * Remove a request from the in-flight table of its cport
+ *
+ * @return true if the request had the earliest deadline of its cport
+ * @note This function should be called from an atomic context
+ */
+static bool gb_operation_del_inflight(struct gb_operation *operation)
+{
+    bool was_first;
+
+    was_first = g_cport[operation->cport].tx_fifo.next == &operation->list;
+
+    list_del(&operation->hash_list);
+    list_del(&operation->list);
+
+    return was_first;
+}
+
 static void gb_clean_timedout_operation(unsigned int cport)
 {
     irqstate_t flags;
-    struct list_head *iter, *iter_next;
     struct gb_operation *op;
+    uint32_t now = clock_systimer();
 
-    list_foreach_safe(&g_cport[cport].tx_fifo, iter, iter_next) {
-        op = list_entry(iter, struct gb_operation, list);
+    while (1) {
+        flags = irqsave();
 
-        if (!gb_operation_has_timedout(op)) {
-            continue;
+        if (list_is_empty(&g_cport[cport].tx_fifo)) {
+            irqrestore(flags);
+            break;
         }
 
-        flags = irqsave();
-        list_del(iter);
+        /* The list is sorted, stop at the first request still in time */
+        op = list_entry(g_cport[cport].tx_fifo.next, struct gb_operation, list);
+        if ((int32_t) (op->deadline - now) > 0) {
+            irqrestore(flags);
+            break;
+        }
+
+        gb_operation_del_inflight(op);
         irqrestore(flags);
 
         if (op->callback) {
@@ -279,80 +698,384 @@ static void gb_process_response(struct gb_operation_hdr *hdr,
                                 struct gb_operation *operation)
 {
     irqstate_t flags;
-    struct list_head *iter, *iter_next;
+    struct list_head *iter;
     struct gb_operation *op;
     struct gb_operation_hdr *op_hdr;
 
-    list_foreach_safe(&g_cport[operation->cport].tx_fifo, iter, iter_next) {
-        op = list_entry(iter, struct gb_operation, list);
-        op_hdr = op->request_buffer;
+    flags = irqsave();
+
+    list_foreach(gb_inflight_bucket(le16_to_cpu(hdr->id)), iter) {
+        op = list_entry(iter, struct gb_operation, hash_list);
+        op_hdr = op->request_buffer;
+
+        if (op->cport != operation->cport || hdr->id != op_hdr->id)
+            continue;
+
+        if (gb_operation_del_inflight(op))
+            gb_watchdog_update(operation->cport);
+        irqrestore(flags);
+
+        /* attach this response with the original request */
+        gb_operation_ref(operation);
+        op->response = operation;
+        op_mark_recv_time(op);
+        gb_stats_response(op, operation);
+        if (op->callback)
+            op->callback(op);
+        gb_operation_unref(op);
+        return;
+    }
+
+    irqrestore(flags);
+
+    gb_error("CPort %u: cannot find matching request for response %hu. Dropping message.\n",
+             operation->cport, le16_to_cpu(hdr->id));
+}
+
+/**
+ * Queue a received message, or a timeout notification, for a cport worker
+ *
+ * @note This function should be called from an atomic context
+ */
+static void gb_cport_queue_message(unsigned int cportid,
+                                   struct gb_operation *operation)
+{
+    struct gb_cport_driver *cport = &g_cport[cportid];
+
+    list_add(&cport->rx_fifo, &operation->list);
+
+#ifdef CONFIG_GREYBUS_SHARED_WORKERS
+    if (cport->pool) {
+        if (!cport->is_scheduled) {
+            cport->is_scheduled = true;
+            list_add(&cport->pool->run_queue, &cport->run_list);
+            sem_post(&cport->pool->run_queue_lock);
+        }
+        return;
+    }
+#endif
+
+    sem_post(&cport->rx_fifo_lock);
+}
+
+static unsigned int gb_rx_queue_depth(struct gb_driver *driver)
+{
+    return driver->rx_queue_depth ? driver->rx_queue_depth :
+                                    CONFIG_GREYBUS_RX_QUEUE_DEPTH;
+}
+
+/**
+ * Queue a received message on a cport, enforcing the depth of its RX queue
+ *
+ * When the RX queue is full, either the oldest queued message gets replaced
+ * or the transport is asked to stop delivering messages until the worker has
+ * made room. Transports that cannot be paused get the new message dropped.
+ * Messages that borrow the RX buffer already hold the transport back.
+ *
+ * @param cportid cport the message has been received on
+ * @param operation operation of the received message
+ * @param borrow whether the message borrows the transport RX buffer
+ * @return 0 if the message has been queued, GB_RX_PAUSED if it has been
+ *         queued but the transport must wait for rx_resume(), -ENOSPC if it
+ *         must be dropped
+ * @note This function should be called from an atomic context
+ */
+static int gb_cport_rx_enqueue(unsigned int cportid,
+                               struct gb_operation *operation, bool borrow)
+{
+    struct gb_cport_driver *cport = &g_cport[cportid];
+    unsigned int depth = gb_rx_queue_depth(cport->driver);
+    struct gb_operation *oldest;
+    struct list_head *iter;
+    int retval = 0;
+
+    if (depth && cport->driver->rx_queue_policy == GB_RX_QUEUE_DROP_OLDEST &&
+        cport->rx_queue.length >= depth) {
+        list_foreach(&cport->rx_fifo, iter) {
+            oldest = list_entry(iter, struct gb_operation, list);
+            if (oldest == &cport->timedout_operation)
+                continue;
+
+            /*
+             * The worker has already been notified of the dropped message,
+             * it will get the new one instead, and destroy the dropped one.
+             */
+            list_del(iter);
+            list_add(&cport->rx_dropped, iter);
+            list_add(&cport->rx_fifo, &operation->list);
+            cport->rx_queue.dropped++;
+            return 0;
+        }
+    } else if (depth && cport->driver->rx_queue_policy == GB_RX_QUEUE_PAUSE &&
+               !borrow && cport->rx_queue.length + 1 >= depth) {
+        if (transport_backend->rx_resume) {
+            cport->is_rx_paused = true;
+            cport->rx_queue.paused++;
+            retval = GB_RX_PAUSED;
+        } else if (cport->rx_queue.length >= depth) {
+            cport->rx_queue.dropped++;
+            return -ENOSPC;
+        }
+    }
+
+    if (++cport->rx_queue.length > cport->rx_queue.max_length)
+        cport->rx_queue.max_length = cport->rx_queue.length;
+    gb_cport_queue_message(cportid, operation);
+
+    return retval;
+}
+
+struct gb_driver *gb_rx_queue_get_stats(unsigned int cport,
+                                        struct gb_rx_queue_stats *stats)
+{
+    struct gb_driver *driver;
+    irqstate_t flags;
+
+    if (!g_cport || cport >= unipro_cport_count() || !stats)
+        return NULL;
+
+    flags = irqsave();
+    driver = g_cport[cport].driver;
+    *stats = g_cport[cport].rx_queue;
+    stats->depth = driver ? gb_rx_queue_depth(driver) : 0;
+    stats->is_paused = g_cport[cport].is_rx_paused;
+    irqrestore(flags);
+
+    return driver;
+}
+
+static void gb_process_message(unsigned int cportid)
+{
+    irqstate_t flags;
+    struct gb_cport_driver *cport = &g_cport[cportid];
+    struct gb_operation *operation;
+    struct list_head *head;
+    struct gb_operation_hdr *hdr;
+    struct list_head dropped;
+    bool resume = false;
+
+    list_init(&dropped);
+
+    flags = irqsave();
+    while (!list_is_empty(&cport->rx_dropped)) {
+        head = cport->rx_dropped.next;
+        list_del(head);
+        list_add(&dropped, head);
+    }
+
+    head = cport->rx_fifo.next;
+    list_del(cport->rx_fifo.next);
+    if (head != &cport->timedout_operation.list) {
+        cport->rx_queue.length--;
+        if (cport->is_rx_paused &&
+            cport->rx_queue.length < gb_rx_queue_depth(cport->driver)) {
+            cport->is_rx_paused = false;
+            resume = true;
+        }
+    }
+    irqrestore(flags);
+
+    if (resume)
+        transport_backend->rx_resume(cportid);
+
+    while (!list_is_empty(&dropped)) {
+        operation = list_entry(dropped.next, struct gb_operation, list);
+        list_del(&operation->list);
+        gb_operation_destroy(operation);
+    }
+
+    operation = list_entry(head, struct gb_operation, list);
+    hdr = operation->request_buffer;
+
+    if (hdr == &timedout_hdr) {
+        gb_clean_timedout_operation(cportid);
+        return;
+    }
+
+    gb_stats_dequeue(operation);
+
+    if (hdr->type & TYPE_RESPONSE_FLAG)
+        gb_process_response(hdr, operation);
+    else
+        gb_process_request(hdr, operation);
+    gb_operation_destroy(operation);
+}
+
+static void *gb_pending_message_worker(void *data)
+{
+    const int cportid = (int) data;
+    int retval;
+
+    while (1) {
+        retval = sem_wait(&g_cport[cportid].rx_fifo_lock);
+        if (retval < 0)
+            continue;
+
+        gb_process_message(cportid);
+    }
+
+    return NULL;
+}
+
+#ifdef CONFIG_GREYBUS_SHARED_WORKERS
+/**
+ * Shared worker
+ *
+ * A cport is on the run queue of its pool at most once and is removed from
+ * it while a worker handles one of its messages, so messages of a given cport
+ * are never handled concurrently and keep their order. The cport goes back to
+ * the tail of the run queue if it still has pending messages.
+ */
+static void *gb_shared_worker(void *data)
+{
+    struct gb_worker_pool *pool = data;
+    struct gb_cport_driver *cport;
+    irqstate_t flags;
+    int retval;
+
+    while (1) {
+        retval = sem_wait(&pool->run_queue_lock);
+        if (retval < 0)
+            continue;
+
+        flags = irqsave();
+        cport = list_entry(pool->run_queue.next, struct gb_cport_driver,
+                           run_list);
+        list_del(&cport->run_list);
+        irqrestore(flags);
+
+        gb_process_message(cport - g_cport);
+
+        flags = irqsave();
+        if (list_is_empty(&cport->rx_fifo)) {
+            cport->is_scheduled = false;
+        } else {
+            list_add(&pool->run_queue, &cport->run_list);
+            sem_post(&pool->run_queue_lock);
+        }
+        irqrestore(flags);
+    }
+
+    return NULL;
+}
+
+/**
+ * Get the pool of shared workers running at the priority of a driver
+ *
+ * Pools are created on first use, one per distinct driver priority, so that
+ * the workers never have to change their own priority.
+ *
+ * @param priority priority of the driver, 0 for default
+ * @return the pool, or NULL if it could not be created
+ */
+static struct gb_worker_pool *gb_worker_pool_get(int priority)
+{
+    struct gb_worker_pool *pool = NULL;
+    pthread_attr_t thread_attr;
+    struct sched_param param;
+    struct list_head *iter;
+    pthread_t thread;
+    int retval;
+
+    retval = pthread_attr_init(&thread_attr);
+    if (retval)
+        return NULL;
+
+    retval = pthread_attr_setstacksize(&thread_attr,
+                                       CONFIG_GREYBUS_SHARED_WORKER_STACK_SIZE);
+    if (retval)
+        goto out;
+
+    if (priority) {
+        param.sched_priority = priority;
+        retval = pthread_attr_setschedparam(&thread_attr, &param);
+        if (retval)
+            goto out;
+    } else {
+        pthread_attr_getschedparam(&thread_attr, &param);
+    }
 
-        if (hdr->id != op_hdr->id)
-            continue;
+    list_foreach(&gb_worker_pools, iter) {
+        pool = list_entry(iter, struct gb_worker_pool, list);
+        if (pool->priority == param.sched_priority)
+            break;
+        pool = NULL;
+    }
 
-        flags = irqsave();
-        list_del(iter);
-        gb_watchdog_update(operation->cport);
-        irqrestore(flags);
+    if (!pool) {
+        pool = zalloc(sizeof(*pool));
+        if (!pool)
+            goto out;
 
-        /* attach this response with the original request */
-        gb_operation_ref(operation);
-        op->response = operation;
-        op_mark_recv_time(op);
-        if (op->callback)
-            op->callback(op);
-        gb_operation_unref(op);
-        return;
+        list_init(&pool->run_queue);
+        sem_init(&pool->run_queue_lock, 0, 0);
+        pool->priority = param.sched_priority;
+        list_add(&gb_worker_pools, &pool->list);
     }
 
-    gb_error("CPort %u: cannot find matching request for response %hu. Dropping message.\n",
-             operation->cport, le16_to_cpu(hdr->id));
+    /* also retries the workers a previous call failed to create */
+    while (pool->nworkers < CONFIG_GREYBUS_SHARED_WORKER_COUNT) {
+        retval = pthread_create(&thread, &thread_attr, gb_shared_worker, pool);
+        if (retval)
+            break;
+        pool->nworkers++;
+    }
+
+    if (!pool->nworkers)
+        pool = NULL;
+
+out:
+    pthread_attr_destroy(&thread_attr);
+    return pool;
 }
 
-static void *gb_pending_message_worker(void *data)
+static int gb_shared_workers_init(void)
 {
-    const int cportid = (int) data;
-    irqstate_t flags;
-    struct gb_operation *operation;
-    struct list_head *head;
-    struct gb_operation_hdr *hdr;
-    int retval;
+    list_init(&gb_worker_pools);
 
-    while (1) {
-        retval = sem_wait(&g_cport[cportid].rx_fifo_lock);
-        if (retval < 0)
-            continue;
+    /* most drivers run at the default priority */
+    return gb_worker_pool_get(0) ? 0 : -ENOMEM;
+}
 
-        flags = irqsave();
-        head = g_cport[cportid].rx_fifo.next;
-        list_del(g_cport[cportid].rx_fifo.next);
-        irqrestore(flags);
+static bool gb_driver_can_share_worker(struct gb_driver *driver)
+{
+    return !driver->dedicated_worker &&
+           driver->stack_size <= CONFIG_GREYBUS_SHARED_WORKER_STACK_SIZE;
+}
+#endif
 
-        operation = list_entry(head, struct gb_operation, list);
-        hdr = operation->request_buffer;
+#ifdef CONFIG_GREYBUS_ZERO_COPY_RX
+static struct gb_operation *gb_operation_borrow(unsigned int cport,
+                                                void *buffer)
+{
+    struct gb_operation *operation;
 
-        if (hdr == &timedout_hdr) {
-            gb_clean_timedout_operation(cportid);
-            continue;
-        }
+    operation = gb_operation_alloc();
+    if (!operation)
+        return NULL;
 
-        if (hdr->type & TYPE_RESPONSE_FLAG)
-            gb_process_response(hdr, operation);
-        else
-            gb_process_request(hdr, operation);
-        gb_operation_destroy(operation);
-    }
+    memset(operation, 0, sizeof(*operation));
+    operation->cport = cport;
+    operation->request_buffer = buffer;
+    operation->is_rx_buffer_borrowed = true;
 
-    return NULL;
+    list_init(&operation->list);
+    list_init(&operation->hash_list);
+    atomic_init(&operation->ref_count, 1);
+
+    return operation;
 }
+#endif
 
-int greybus_rx_handler(unsigned int cport, void *data, size_t size)
+static int _greybus_rx_handler(unsigned int cport, void *data, size_t size,
+                               bool borrow)
 {
     irqstate_t flags;
     struct gb_operation *op;
     struct gb_operation_hdr *hdr = data;
     struct gb_operation_handler *op_handler;
     size_t hdr_size;
+    int retval;
 
     if (cport >= unipro_cport_count() || !data) {
         gb_error("Invalid cport number: %u\n", cport);
@@ -378,15 +1101,7 @@ int greybus_rx_handler(unsigned int cport, void *data, size_t size)
 
     gb_dump(data, size);
 
-    if (gb_tape && gb_tape_fd >= 0) {
-        struct gb_tape_record_header record_hdr = {
-            .size = size,
-            .cport = cport,
-        };
-
-        gb_tape->write(gb_tape_fd, &record_hdr, sizeof(record_hdr));
-        gb_tape->write(gb_tape_fd, data, size);
-    }
+    gb_tape_record(cport, data, size);
 
     op_handler = find_operation_handler(hdr->type, cport);
     if (op_handler && op_handler->fast_handler) {
@@ -395,25 +1110,68 @@ int greybus_rx_handler(unsigned int cport, void *data, size_t size)
         return 0;
     }
 
-    op = gb_operation_create(cport, 0, hdr_size - sizeof(*hdr));
-    if (!op)
-        return -ENOMEM;
+#ifdef CONFIG_GREYBUS_ZERO_COPY_RX
+    if (borrow) {
+        op = gb_operation_borrow(cport, data);
+        if (!op)
+            return -ENOMEM;
+    } else
+#endif
+    {
+        op = gb_operation_create(cport, 0, hdr_size - sizeof(*hdr));
+        if (!op)
+            return -ENOMEM;
 
-    memcpy(op->request_buffer, data, hdr_size);
+        memcpy(op->request_buffer, data, hdr_size);
+    }
+    op->handler = op_handler;
     op_mark_recv_time(op);
+    gb_stats_rx(op, hdr_size);
 
     flags = irqsave();
-    list_add(&g_cport[cport].rx_fifo, &op->list);
-    sem_post(&g_cport[cport].rx_fifo_lock);
+    retval = gb_cport_rx_enqueue(cport, op, borrow);
     irqrestore(flags);
 
-    return 0;
+    if (retval < 0) {
+        gb_operation_destroy(op);
+        return retval;
+    }
+
+    return borrow ? GB_RX_BUFFER_BORROWED : retval;
+}
+
+int greybus_rx_handler(unsigned int cport, void *data, size_t size)
+{
+    return _greybus_rx_handler(cport, data, size, false);
+}
+
+#ifdef CONFIG_GREYBUS_ZERO_COPY_RX
+/**
+ * Receive a message without copying it
+ *
+ * The operation created for the message keeps a reference on @data, which is
+ * handed back to the transport backend through rx_release() once the
+ * operation is destroyed. Messages handled before this function returns (fast
+ * handlers, invalid messages) do not keep the buffer.
+ *
+ * @return GB_RX_BUFFER_BORROWED if the caller must not reuse @data until it
+ *         gets released, 0 if the message has been consumed, or a negative
+ *         errno value if it has been dropped
+ */
+int greybus_rx_handler_nocopy(unsigned int cport, void *data, size_t size)
+{
+    DEBUGASSERT(transport_backend);
+
+    return _greybus_rx_handler(cport, data, size,
+                               transport_backend->rx_release != NULL);
 }
+#endif
 
 int _gb_register_driver(unsigned int cport, struct gb_driver *driver)
 {
     pthread_attr_t thread_attr;
     pthread_attr_t *thread_attr_ptr = &thread_attr;
+    struct sched_param param;
     int retval;
 
     gb_debug("Registering Greybus driver on CP%u\n", cport);
@@ -439,6 +1197,10 @@ int _gb_register_driver(unsigned int cport, struct gb_driver *driver)
         return -EINVAL;
     }
 
+    retval = gb_build_dispatch_table(driver);
+    if (retval)
+        return retval;
+
     if (driver->init) {
         retval = driver->init(cport);
         if (retval) {
@@ -447,14 +1209,25 @@ int _gb_register_driver(unsigned int cport, struct gb_driver *driver)
         }
     }
 
-    if (driver->op_handlers) {
-        qsort(driver->op_handlers, driver->op_handlers_count,
-              sizeof(*driver->op_handlers), gb_compare_handlers);
-    }
-
     if (!driver->stack_size)
         driver->stack_size = DEFAULT_STACK_SIZE;
 
+    retval = gb_stats_register(cport, driver);
+    if (retval)
+        goto gb_stats_register_error;
+
+#ifdef CONFIG_GREYBUS_SHARED_WORKERS
+    if (gb_driver_can_share_worker(driver)) {
+        g_cport[cport].pool = gb_worker_pool_get(driver->priority);
+        if (g_cport[cport].pool) {
+            g_cport[cport].driver = driver;
+            return 0;
+        }
+        gb_error("Can not get shared workers for %s, using a dedicated one\n",
+                 gb_driver_name(driver));
+    }
+#endif
+
     retval = pthread_attr_init(&thread_attr);
     if (retval)
         goto pthread_attr_init_error;
@@ -463,6 +1236,13 @@ int _gb_register_driver(unsigned int cport, struct gb_driver *driver)
     if (retval)
         goto pthread_attr_setstacksize_error;
 
+    if (driver->priority) {
+        param.sched_priority = driver->priority;
+        retval = pthread_attr_setschedparam(&thread_attr, &param);
+        if (retval)
+            goto pthread_attr_setstacksize_error;
+    }
+
     retval = pthread_create(&g_cport[cport].thread, &thread_attr,
                             gb_pending_message_worker, (unsigned*) cport);
     if (retval)
@@ -481,6 +1261,8 @@ pthread_attr_setstacksize_error:
         pthread_attr_destroy(&thread_attr);
 pthread_attr_init_error:
     gb_error("Can not create thread for %s\n: ", gb_driver_name(driver));
+    gb_stats_unregister(cport);
+gb_stats_register_error:
     if (driver->exit)
         driver->exit(cport);
     return retval;
@@ -501,6 +1283,15 @@ int gb_listen(unsigned int cport)
         return -EINVAL;
     }
 
+    if (transport_backend->set_tx_priority) {
+        int retval = transport_backend->set_tx_priority(cport,
+                                            g_cport[cport].driver->tx_priority);
+        if (retval) {
+            gb_error("Can not set the TX priority of CP%u\n", cport);
+            return retval;
+        }
+    }
+
     return transport_backend->listen(cport);
 }
 
@@ -535,14 +1326,95 @@ static void gb_operation_timeout(int argc, uint32_t cport, ...)
         return;
     }
 
-    list_add(&g_cport[cport].rx_fifo, &g_cport[cport].timedout_operation.list);
-    sem_post(&g_cport[cport].rx_fifo_lock);
+    gb_cport_queue_message(cport, &g_cport[cport].timedout_operation);
     irqrestore(flags);
 }
 
-int gb_operation_send_request(struct gb_operation *operation,
-                              gb_operation_callback callback,
-                              bool need_response)
+static size_t gb_iov_length(const struct iovec *iov, int count)
+{
+    size_t len = 0;
+
+    while (count--)
+        len += iov[count].iov_len;
+
+    return len;
+}
+
+/**
+ * Send a message made of a header buffer followed by payload fragments
+ *
+ * The size field of the header covers the fragments while the message is
+ * sent, and is restored afterwards so that the same buffer can be sent again
+ * with another payload. Backends without send_iov get a copy of the whole
+ * message in a single buffer.
+ *
+ * @param cport CPort to send the message on
+ * @param buffer Header, possibly followed by some payload, of hdr->size bytes
+ * @param payload Payload fragments to send after the buffer
+ * @param count Number of payload fragments
+ * @return 0 on success, a negative errno value otherwise
+ */
+static int gb_transport_send_iov(unsigned int cport, void *buffer,
+                                 const struct iovec *payload, int count)
+{
+    struct gb_operation_hdr *hdr = buffer;
+    struct iovec iov[GB_OPERATION_MAX_IOV + 1];
+    size_t size = le16_to_cpu(hdr->size);
+    uint8_t *msg;
+    int retval;
+    int i;
+
+    if (!count) {
+        gb_dump(buffer, size);
+        return transport_backend->send(cport, buffer, size);
+    }
+
+    if (count > GB_OPERATION_MAX_IOV)
+        return -EINVAL;
+
+    iov[0].iov_base = buffer;
+    iov[0].iov_len = size;
+    for (i = 0; i < count; i++) {
+        iov[i + 1] = payload[i];
+        size += payload[i].iov_len;
+    }
+
+    if (size > UINT16_MAX)
+        return -EINVAL;
+
+    hdr->size = cpu_to_le16(size);
+    gb_dump(buffer, iov[0].iov_len);
+
+    if (transport_backend->send_iov) {
+        retval = transport_backend->send_iov(cport, iov, count + 1);
+        goto out;
+    }
+
+    msg = gb_buffer_alloc(size);
+    if (!msg) {
+        retval = -ENOMEM;
+        goto out;
+    }
+
+    for (size = 0, i = 0; i <= count; i++) {
+        memcpy(msg + size, iov[i].iov_base, iov[i].iov_len);
+        size += iov[i].iov_len;
+    }
+
+    retval = transport_backend->send(cport, msg, size);
+    gb_buffer_free(msg);
+
+out:
+    /* so that the operation can be sent again with another payload */
+    hdr->size = cpu_to_le16(iov[0].iov_len);
+    return retval;
+}
+
+static int _gb_operation_send_request(struct gb_operation *operation,
+                                      gb_operation_callback callback,
+                                      bool need_response,
+                                      unsigned int timeout,
+                                      const struct iovec *payload, int count)
 {
     struct gb_operation_hdr *hdr = operation->request_buffer;
     int retval = 0;
@@ -560,24 +1432,20 @@ int gb_operation_send_request(struct gb_operation *operation,
         hdr->id = cpu_to_le16(atomic_inc(&request_id));
         if (hdr->id == 0) /* ID 0 is for request with no response */
             hdr->id = cpu_to_le16(atomic_inc(&request_id));
-        clock_gettime(CLOCK_MONOTONIC, &operation->time);
         operation->callback = callback;
         gb_operation_ref(operation);
-        list_add(&g_cport[operation->cport].tx_fifo, &operation->list);
-        if (!WDOG_ISACTIVE(&g_cport[operation->cport].timeout_wd)) {
-            wd_start(&g_cport[operation->cport].timeout_wd, TIMEOUT_WD_DELAY,
-                     gb_operation_timeout, 1, operation->cport);
-        }
+        gb_operation_add_inflight(operation, timeout);
     }
 
-    gb_dump(operation->request_buffer, hdr->size);
-    retval = transport_backend->send(operation->cport,
-                                     operation->request_buffer,
-                                     le16_to_cpu(hdr->size));
+    retval = gb_transport_send_iov(operation->cport, operation->request_buffer,
+                                   payload, count);
     op_mark_send_time(operation);
+    if (!retval)
+        gb_stats_tx(operation, le16_to_cpu(hdr->size) +
+                               gb_iov_length(payload, count));
     if (need_response && retval) {
-        list_del(&operation->list);
-        gb_watchdog_update(operation->cport);
+        if (gb_operation_del_inflight(operation))
+            gb_watchdog_update(operation->cport);
         gb_operation_unref(operation);
     }
 
@@ -586,19 +1454,111 @@ int gb_operation_send_request(struct gb_operation *operation,
     return retval;
 }
 
+/**
+ * Send a request
+ *
+ * @param operation Operation to send
+ * @param callback Function called when the response is received or the
+ *                 request times out
+ * @param need_response Whether a response is expected
+ * @param timeout Time to wait for the response, in milliseconds
+ * @return 0 on success, a negative errno value otherwise
+ */
+int gb_operation_send_request_timeout(struct gb_operation *operation,
+                                      gb_operation_callback callback,
+                                      bool need_response,
+                                      unsigned int timeout)
+{
+    return _gb_operation_send_request(operation, callback, need_response,
+                                      timeout, NULL, 0);
+}
+
+/**
+ * Send a request whose payload is completed by fragments
+ *
+ * The fragments are sent after the request buffer of the operation, without
+ * being copied into it when the transport supports scatter/gather.
+ *
+ * @param operation Operation to send
+ * @param callback Function called when the response is received or the
+ *                 request times out
+ * @param need_response Whether a response is expected
+ * @param payload Payload fragments, at most GB_OPERATION_MAX_IOV
+ * @param count Number of payload fragments
+ * @return 0 on success, a negative errno value otherwise
+ */
+int gb_operation_send_request_iov(struct gb_operation *operation,
+                                  gb_operation_callback callback,
+                                  bool need_response,
+                                  const struct iovec *payload, int count)
+{
+    return _gb_operation_send_request(operation, callback, need_response,
+                                      GB_OPERATION_TIMEOUT_DEFAULT,
+                                      payload, count);
+}
+
+/**
+ * Send several requests in a row
+ *
+ * The requests are sent without other messages being interleaved, and
+ * sending stops at the first failure.
+ *
+ * @param operations Operations to send
+ * @param count Number of operations
+ * @param callback Function called for each response or timeout
+ * @param need_response Whether responses are expected
+ * @return number of requests sent, or a negative errno value if the first
+ *         one could not be sent
+ */
+int gb_operation_send_request_batch(struct gb_operation **operations,
+                                    int count,
+                                    gb_operation_callback callback,
+                                    bool need_response)
+{
+    irqstate_t flags;
+    int retval = 0;
+    int i;
+
+    flags = irqsave();
+
+    for (i = 0; i < count; i++) {
+        retval = _gb_operation_send_request(operations[i], callback,
+                                            need_response,
+                                            GB_OPERATION_TIMEOUT_DEFAULT,
+                                            NULL, 0);
+        if (retval)
+            break;
+    }
+
+    irqrestore(flags);
+
+    return i ? i : retval;
+}
+
+int gb_operation_send_request(struct gb_operation *operation,
+                              gb_operation_callback callback,
+                              bool need_response)
+{
+    return gb_operation_send_request_timeout(operation, callback,
+                                             need_response,
+                                             GB_OPERATION_TIMEOUT_DEFAULT);
+}
+
 static void gb_operation_callback_sync(struct gb_operation *operation)
 {
     sem_post(&operation->sync_sem);
 }
 
-int gb_operation_send_request_sync(struct gb_operation *operation)
+int gb_operation_send_request_sync_timeout(struct gb_operation *operation,
+                                           unsigned int timeout)
 {
     int retval;
 
     sem_init(&operation->sync_sem, 0, 0);
 
-    retval =
-        gb_operation_send_request(operation, gb_operation_callback_sync, true);
+    retval = gb_operation_send_request_timeout(operation,
+                                               gb_operation_callback_sync,
+                                               true, timeout);
     if (retval)
         return retval;
 
@@ -609,6 +1569,12 @@ int gb_operation_send_request_sync(struct gb_operation *operation)
     return retval;
 }
 
+int gb_operation_send_request_sync(struct gb_operation *operation)
+{
+    return gb_operation_send_request_sync_timeout(operation,
+                                                  GB_OPERATION_TIMEOUT_DEFAULT);
+}
+
 static int gb_operation_send_oom_response(struct gb_operation *operation)
 {
     int retval;
@@ -628,7 +1594,21 @@ static int gb_operation_send_oom_response(struct gb_operation *operation)
     return retval;
 }
 
-int gb_operation_send_response(struct gb_operation *operation, uint8_t result)
+/**
+ * Send a response whose payload is completed by fragments
+ *
+ * The response buffer is allocated with no payload if the handler did not
+ * allocate it. The fragments are sent after it.
+ *
+ * @param operation Operation to respond to
+ * @param result Greybus result of the operation
+ * @param payload Payload fragments, at most GB_OPERATION_MAX_IOV
+ * @param count Number of payload fragments
+ * @return 0 on success, a negative errno value otherwise
+ */
+int gb_operation_send_response_iov(struct gb_operation *operation,
+                                   uint8_t result,
+                                   const struct iovec *payload, int count)
 {
     struct gb_operation_hdr *resp_hdr;
     int retval;
@@ -652,24 +1632,29 @@ int gb_operation_send_response(struct gb_operation *operation, uint8_t result)
     resp_hdr = operation->response_buffer;
     resp_hdr->result = result;
 
-    gb_dump(operation->response_buffer, resp_hdr->size);
-    retval = transport_backend->send(operation->cport,
-                                     operation->response_buffer,
-                                     le16_to_cpu(resp_hdr->size));
+    retval = gb_transport_send_iov(operation->cport, operation->response_buffer,
+                                   payload, count);
     if (retval) {
         gb_error("Greybus backend failed to send: error %d\n", retval);
         if (has_allocated_response) {
             gb_debug("Free the response buffer\n");
-            free(operation->response_buffer);
+            gb_buffer_free(operation->response_buffer);
             operation->response_buffer = NULL;
         }
         return retval;
     }
 
+    gb_stats_tx(operation, le16_to_cpu(resp_hdr->size) +
+                           gb_iov_length(payload, count));
     operation->has_responded = true;
     return retval;
 }
 
+int gb_operation_send_response(struct gb_operation *operation, uint8_t result)
+{
+    return gb_operation_send_response_iov(operation, result, NULL, 0);
+}
+
 void *gb_operation_alloc_response(struct gb_operation *operation, size_t size)
 {
     struct gb_operation_hdr *req_hdr;
@@ -677,7 +1662,7 @@ void *gb_operation_alloc_response(struct gb_operation *operation, size_t size)
 
     DEBUGASSERT(operation);
 
-    operation->response_buffer = malloc(size + sizeof(*resp_hdr));
+    operation->response_buffer = gb_buffer_alloc(size + sizeof(*resp_hdr));
     if (!operation->response_buffer) {
         gb_error("Can not allocate a response_buffer\n");
         return NULL;
@@ -717,12 +1702,18 @@ void gb_operation_unref(struct gb_operation *operation)
         return;
     }
 
-    free(operation->request_buffer);
-    free(operation->response_buffer);
+#ifdef CONFIG_GREYBUS_ZERO_COPY_RX
+    if (operation->is_rx_buffer_borrowed)
+        transport_backend->rx_release(operation->cport,
+                                      operation->request_buffer);
+    else
+#endif
+        gb_buffer_free(operation->request_buffer);
+    gb_buffer_free(operation->response_buffer);
     if (operation->response) {
         gb_operation_unref(operation->response);
     }
-    free(operation);
+    gb_operation_free(operation);
 }
 
 
@@ -735,14 +1726,14 @@ struct gb_operation *gb_operation_create(unsigned int cport, uint8_t type,
     if (cport >= unipro_cport_count())
         return NULL;
 
-    operation = malloc(sizeof(*operation));
+    operation = gb_operation_alloc();
     if (!operation)
         return NULL;
 
     memset(operation, 0, sizeof(*operation));
     operation->cport = cport;
 
-    operation->request_buffer = malloc(req_size + sizeof(*hdr));
+    operation->request_buffer = gb_buffer_alloc(req_size + sizeof(*hdr));
     if (!operation->request_buffer)
         goto malloc_error;
 
@@ -752,11 +1743,12 @@ struct gb_operation *gb_operation_create(unsigned int cport, uint8_t type,
     hdr->type = type;
 
     list_init(&operation->list);
+    list_init(&operation->hash_list);
     atomic_init(&operation->ref_count, 1);
 
     return operation;
 malloc_error:
-    free(operation);
+    gb_operation_free(operation);
     return NULL;
 }
 
@@ -799,18 +1791,40 @@ uint8_t gb_operation_get_request_result(struct gb_operation *operation)
 int gb_init(struct gb_transport_backend *transport)
 {
     int i;
+    int retval;
 
     if (!transport)
         return -EINVAL;
 
+    retval = gb_pools_init();
+    if (retval) {
+        gb_error("Can not allocate the operation pool\n");
+        return retval;
+    }
+
+    for (i = 0; i < GB_INFLIGHT_HASH_SIZE; i++)
+        list_init(&gb_inflight_hash[i]);
+
+#ifdef CONFIG_GREYBUS_SHARED_WORKERS
+    retval = gb_shared_workers_init();
+    if (retval) {
+        gb_error("Can not create the shared workers\n");
+        return retval;
+    }
+#endif
+
     g_cport = zalloc(sizeof(struct gb_cport_driver) * unipro_cport_count());
     for (i = 0; i < unipro_cport_count(); i++) {
         sem_init(&g_cport[i].rx_fifo_lock, 0, 0);
         list_init(&g_cport[i].rx_fifo);
+        list_init(&g_cport[i].rx_dropped);
         list_init(&g_cport[i].tx_fifo);
         wd_static(&g_cport[i].timeout_wd);
         g_cport[i].timedout_operation.request_buffer = &timedout_hdr;
         list_init(&g_cport[i].timedout_operation.list);
+#ifdef CONFIG_GREYBUS_SHARED_WORKERS
+        list_init(&g_cport[i].run_list);
+#endif
     }
 
     atomic_init(&request_id, (uint32_t) 0);
@@ -820,95 +1834,3 @@ int gb_init(struct gb_transport_backend *transport)
 
     return 0;
 }
-
-int gb_tape_register_mechanism(struct gb_tape_mechanism *mechanism)
-{
-    if (!mechanism || !mechanism->open || !mechanism->close ||
-        !mechanism->read || !mechanism->write)
-        return -EINVAL;
-
-    if (gb_tape)
-        return -EBUSY;
-
-    gb_tape = mechanism;
-
-    return 0;
-}
-
-int gb_tape_communication(const char *pathname)
-{
-    if (!gb_tape)
-        return -EINVAL;
-
-    if (gb_tape_fd >= 0)
-        return -EBUSY;
-
-    gb_tape_fd = gb_tape->open(pathname, GB_TAPE_WRONLY);
-    if (gb_tape_fd < 0)
-        return gb_tape_fd;
-
-    return 0;
-}
-
-int gb_tape_stop(void)
-{
-    if (!gb_tape || gb_tape_fd < 0)
-        return -EINVAL;
-
-    gb_tape->close(gb_tape_fd);
-    gb_tape_fd = -EBADFD;
-
-    return 0;
-}
-
-int gb_tape_replay(const char *pathname)
-{
-    struct gb_tape_record_header hdr;
-    char *buffer;
-    ssize_t nread;
-    int retval = 0;
-    int fd;
-
-    if (!pathname || !gb_tape)
-        return -EINVAL;
-
-    lowsyslog("greybus: replaying '%s'...\n", pathname);
-
-    fd = gb_tape->open(pathname, GB_TAPE_RDONLY);
-    if (fd < 0)
-        return fd;
-
-    buffer = malloc(CPORT_BUF_SIZE);
-    if (!buffer) {
-        retval = -ENOMEM;
-        goto error_buffer_alloc;
-    }
-
-    while (1) {
-        nread = gb_tape->read(fd, &hdr, sizeof(hdr));
-        if (!nread)
-            break;
-
-        if (nread != sizeof(hdr)) {
-            gb_error("gb-tape: invalid byte count read, aborting...\n");
-            retval = -EIO;
-            break;
-        }
-
-        nread = gb_tape->read(fd, buffer, hdr.size);
-        if (hdr.size != nread) {
-            gb_error("gb-tape: invalid byte count read, aborting...\n");
-            retval = -EIO;
-            break;
-        }
-
-        greybus_rx_handler(hdr.cport, buffer, nread);
-    }
-
-    free(buffer);
-
-error_buffer_alloc:
-    gb_tape->close(fd);
-
-    return retval;
-}
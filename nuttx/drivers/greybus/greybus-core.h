@@ -0,0 +1,170 @@
+/*
+ * Copyright (c) 2015 Google Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef __GREYBUS_CORE_H__
+#define __GREYBUS_CORE_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <arch/atomic.h>
+#include <nuttx/greybus/greybus.h>
+
+/* Internal interface between the Greybus core and its procfs entries */
+
+struct gb_pool_stats {
+    const char *name;
+    size_t block_size;
+    unsigned int count;
+    unsigned int in_use;
+    unsigned int max_in_use;
+    unsigned long hits;
+    unsigned long misses;
+};
+
+#ifdef CONFIG_GREYBUS_OPERATION_POOL
+/**
+ * Get a snapshot of the usage counters of an operation or buffer pool
+ *
+ * @param index Index of the pool, starting at 0
+ * @param stats Structure filled with the pool counters
+ * @return 0 on success, -EINVAL when there is no pool at that index
+ */
+int gb_pool_get_stats(unsigned int index, struct gb_pool_stats *stats);
+#endif
+
+#ifdef CONFIG_GREYBUS_I2S_PHY
+/* Audio streaming counters of an I2S bundle */
+struct gb_i2s_stats {
+    struct {
+        uint32_t messages;      /* Send Data requests queued for playback */
+        uint32_t copies;        /* requests that could not be played in place */
+        uint32_t overruns;      /* requests discarded, jitter buffer full */
+        uint32_t gap_fills;     /* silence queued for missing samples */
+        uint32_t underrun_fills; /* silence queued to keep the i2s fed */
+        uint32_t underruns;     /* underruns reported by the i2s driver */
+        uint32_t min_level;     /* lowest number of queued messages */
+    } rx;
+    struct {
+        uint32_t messages;      /* Send Data requests sent */
+        uint32_t send_errors;
+        uint32_t overruns;      /* overruns reported by the i2s driver */
+        uint32_t max_level;     /* highest number of messages waiting */
+    } tx;
+};
+
+/**
+ * Get the streaming counters of an I2S bundle
+ *
+ * @param index Index of the bundle, starting at 0
+ * @param stats Structure filled with the counters
+ * @return 0 on success, -EINVAL when there is no active bundle at that index
+ */
+int gb_i2s_get_stats(unsigned int index, struct gb_i2s_stats *stats);
+#endif
+
+#ifdef CONFIG_GREYBUS_HID
+/* Input report counters of the HID bundle */
+struct gb_hid_stats {
+    uint32_t reports;           /* input reports received from the driver */
+    uint32_t dropped;           /* reports lost, no free message buffer */
+    uint32_t messages;          /* IRQ Event requests sent */
+    uint32_t send_errors;
+    uint32_t max_batch;         /* most reports carried by one message */
+    uint32_t latency_total;     /* usec from oldest report to message sent */
+    uint32_t latency_max;
+    uint32_t elapsed;           /* usec between the first and last message */
+};
+
+/**
+ * Get the input report counters of the HID bundle
+ *
+ * @param stats Structure filled with the counters
+ * @return 0 on success, -EINVAL when the HID protocol is not running
+ */
+int gb_hid_get_stats(struct gb_hid_stats *stats);
+#endif
+
+/**
+ * Queue an incoming message to be recorded on the tape, if one is rolling
+ *
+ * Safe to call from interrupt context: the message is only copied, the
+ * tape itself is written by a thread.
+ *
+ * @param cport CPort the message was received on
+ * @param data Message
+ * @param size Size of the message
+ */
+void gb_tape_record(unsigned int cport, const void *data, size_t size);
+
+#ifdef CONFIG_GREYBUS_STATS
+#define GB_HISTOGRAM_BUCKETS    16
+
+/*
+ * Histogram of durations in microseconds. Bucket n counts the durations
+ * of n significant bits, that is up to 2^n - 1 us, and the last bucket
+ * also counts everything above.
+ */
+struct gb_histogram {
+    uint32_t count;
+    uint32_t max;
+    uint64_t total;
+    uint32_t buckets[GB_HISTOGRAM_BUCKETS];
+};
+
+/*
+ * Statistics of a cport. Each counter has a single writer (the rx handler,
+ * or the worker serving the cport) except the tx counters which are
+ * updated atomically, so that no lock is taken. Readers may see a slightly
+ * inconsistent snapshot.
+ */
+struct gb_cport_stats {
+    uint32_t rx_messages;
+    uint32_t rx_bytes;
+    atomic_t tx_messages;
+    atomic_t tx_bytes;
+    struct gb_histogram queue_delay;
+    struct gb_histogram round_trip;
+    /* one histogram per entry of the op_handlers table of the driver */
+    struct gb_histogram *handler_time;
+};
+
+/**
+ * Get the statistics of a cport
+ *
+ * @param cport CPort number
+ * @param stats Set to the live statistics of the cport
+ * @return the driver registered on the cport, or NULL if there is none
+ */
+struct gb_driver *gb_stats_get(unsigned int cport,
+                               struct gb_cport_stats **stats);
+#endif
+
+#endif /* __GREYBUS_CORE_H__ */
@@ -0,0 +1,410 @@
+/*
+ * Copyright (c) 2015 Google Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <nuttx/config.h>
+#include <nuttx/kmalloc.h>
+#include <nuttx/clock.h>
+#include <nuttx/fs/fs.h>
+#include <nuttx/fs/procfs.h>
+#include <nuttx/greybus/greybus.h>
+#include <nuttx/unipro/unipro.h>
+
+#include <sys/stat.h>
+
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <errno.h>
+
+#include "greybus-core.h"
+
+#if defined(CONFIG_FS_PROCFS) && !defined(CONFIG_FS_PROCFS_EXCLUDE_GREYBUS)
+
+#define GB_PROCFS_PREFIX    "greybus/"
+
+struct gb_procfs_entry {
+    const char *name;
+    size_t bufsize;
+    size_t (*generate)(char *buf, size_t buflen);
+};
+
+struct gb_procfs_file {
+    struct procfs_file_s base;
+    size_t size;
+    char *buf;
+};
+
+#ifdef CONFIG_GREYBUS_OPERATION_POOL
+static size_t gb_procfs_pool(char *buf, size_t buflen)
+{
+    struct gb_pool_stats stats;
+    unsigned int i;
+    size_t len;
+
+    len = snprintf(buf, buflen, "%-10s %6s %6s %6s %6s %10s %10s\n",
+                   "pool", "size", "count", "used", "max", "hits", "misses");
+
+    for (i = 0; len < buflen && !gb_pool_get_stats(i, &stats); i++) {
+        len += snprintf(buf + len, buflen - len,
+                        "%-10s %6zu %6u %6u %6u %10lu %10lu\n",
+                        stats.name, stats.block_size, stats.count,
+                        stats.in_use, stats.max_in_use, stats.hits,
+                        stats.misses);
+    }
+
+    return len < buflen ? len : buflen - 1;
+}
+#endif
+
+#ifdef CONFIG_GREYBUS_STATS
+/**
+ * Estimate a percentile of a histogram
+ *
+ * @return the upper bound of the bucket holding the percentile, capped to the
+ *         maximum value seen
+ */
+static uint32_t gb_histogram_percentile(const struct gb_histogram *histogram,
+                                        unsigned int percent)
+{
+    uint32_t threshold = (histogram->count * percent + 99) / 100;
+    uint32_t sum = 0;
+    uint32_t bound;
+    int i;
+
+    for (i = 0; i < GB_HISTOGRAM_BUCKETS - 1; i++) {
+        sum += histogram->buckets[i];
+        if (sum >= threshold)
+            break;
+    }
+
+    bound = (1U << i) - 1;
+    if (i == GB_HISTOGRAM_BUCKETS - 1 || bound > histogram->max)
+        return histogram->max;
+    return bound;
+}
+
+static size_t gb_procfs_histogram(char *buf, size_t buflen, const char *name,
+                                  unsigned int type,
+                                  const struct gb_histogram *histogram)
+{
+    char label[20];
+
+    if (!histogram->count)
+        return 0;
+
+    if (type <= UINT8_MAX)
+        snprintf(label, sizeof(label), "%s 0x%02x", name, type);
+    else
+        snprintf(label, sizeof(label), "%s", name);
+
+    return snprintf(buf, buflen, "  %-17s %10lu %8lu %8lu %8lu %8lu\n",
+                    label, (unsigned long) histogram->count,
+                    (unsigned long) (histogram->total / histogram->count),
+                    (unsigned long) gb_histogram_percentile(histogram, 50),
+                    (unsigned long) gb_histogram_percentile(histogram, 99),
+                    (unsigned long) histogram->max);
+}
+
+static size_t gb_procfs_stats(char *buf, size_t buflen)
+{
+    struct gb_cport_stats *stats;
+    struct gb_driver *driver;
+    uint32_t uptime = TICK2MSEC(clock_systimer());
+    uint32_t rx_bytes;
+    uint32_t tx_bytes;
+    unsigned int cport;
+    size_t len;
+    int i;
+
+    if (!uptime)
+        uptime = 1;
+
+    len = snprintf(buf, buflen, "%-5s %-12s %10s %10s %10s %10s %8s %8s\n"
+                   "  %-17s %10s %8s %8s %8s %8s\n",
+                   "cport", "driver", "rx msgs", "rx bytes", "tx msgs",
+                   "tx bytes", "rx B/s", "tx B/s",
+                   "duration (us)", "count", "avg", "p50", "p99", "max");
+
+    for (cport = 0; len < buflen && cport < unipro_cport_count(); cport++) {
+        driver = gb_stats_get(cport, &stats);
+        if (!driver)
+            continue;
+
+        rx_bytes = stats->rx_bytes;
+        tx_bytes = atomic_get(&stats->tx_bytes);
+
+        len += snprintf(buf + len, buflen - len,
+                        "%-5u %-12s %10lu %10lu %10lu %10lu %8lu %8lu\n",
+                        cport, gb_driver_name(driver) ?: "",
+                        (unsigned long) stats->rx_messages,
+                        (unsigned long) rx_bytes,
+                        (unsigned long) atomic_get(&stats->tx_messages),
+                        (unsigned long) tx_bytes,
+                        (unsigned long) ((uint64_t) rx_bytes * 1000 / uptime),
+                        (unsigned long) ((uint64_t) tx_bytes * 1000 / uptime));
+        if (len >= buflen)
+            break;
+
+        len += gb_procfs_histogram(buf + len, buflen - len, "queue", ~0U,
+                                   &stats->queue_delay);
+        if (len >= buflen)
+            break;
+
+        len += gb_procfs_histogram(buf + len, buflen - len, "round-trip", ~0U,
+                                   &stats->round_trip);
+
+        for (i = 0; len < buflen && stats->handler_time &&
+                    i < driver->op_handlers_count; i++) {
+            len += gb_procfs_histogram(buf + len, buflen - len, "handler",
+                                       driver->op_handlers[i].type,
+                                       &stats->handler_time[i]);
+        }
+    }
+
+    return len < buflen ? len : buflen - 1;
+}
+#endif
+
+static size_t gb_procfs_rxqueue(char *buf, size_t buflen)
+{
+    struct gb_rx_queue_stats stats;
+    struct gb_driver *driver;
+    unsigned int cport;
+    size_t len;
+
+    len = snprintf(buf, buflen, "%-5s %-12s %-6s %6s %6s %6s %10s %10s\n",
+                   "cport", "driver", "policy", "depth", "length", "max",
+                   "dropped", "paused");
+
+    for (cport = 0; len < buflen && cport < unipro_cport_count(); cport++) {
+        driver = gb_rx_queue_get_stats(cport, &stats);
+        if (!driver)
+            continue;
+
+        len += snprintf(buf + len, buflen - len,
+                        "%-5u %-12s %-6s %6u %6u %6u %10lu %10lu%s\n",
+                        cport, gb_driver_name(driver) ?: "",
+                        driver->rx_queue_policy == GB_RX_QUEUE_DROP_OLDEST ?
+                            "drop" : "pause",
+                        stats.depth, stats.length, stats.max_length,
+                        stats.dropped, stats.paused,
+                        stats.is_paused ? " (paused)" : "");
+    }
+
+    return len < buflen ? len : buflen - 1;
+}
+
+#ifdef CONFIG_GREYBUS_I2S_PHY
+static size_t gb_procfs_i2s(char *buf, size_t buflen)
+{
+    struct gb_i2s_stats stats;
+    unsigned int i;
+    size_t len = 0;
+
+    for (i = 0; len < buflen && !gb_i2s_get_stats(i, &stats); i++) {
+        len += snprintf(buf + len, buflen - len,
+                        "bundle %u\n"
+                        "  rx: messages %u copies %u overruns %u "
+                        "gap fills %u underrun fills %u underruns %u "
+                        "min level %d\n"
+                        "  tx: messages %u send errors %u overruns %u "
+                        "max level %u\n",
+                        i, stats.rx.messages, stats.rx.copies,
+                        stats.rx.overruns, stats.rx.gap_fills,
+                        stats.rx.underrun_fills, stats.rx.underruns,
+                        stats.rx.min_level == UINT32_MAX ?
+                            -1 : (int) stats.rx.min_level,
+                        stats.tx.messages, stats.tx.send_errors,
+                        stats.tx.overruns, stats.tx.max_level);
+    }
+
+    return len < buflen ? len : buflen - 1;
+}
+#endif
+
+#ifdef CONFIG_GREYBUS_HID
+static size_t gb_procfs_hid(char *buf, size_t buflen)
+{
+    struct gb_hid_stats stats;
+    uint32_t rate = 0;
+    size_t len;
+
+    if (gb_hid_get_stats(&stats))
+        return 0;
+
+    if (stats.elapsed)
+        rate = (uint64_t) (stats.messages - 1) * 1000000 / stats.elapsed;
+
+    len = snprintf(buf, buflen,
+                   "reports %u dropped %u messages %u send errors %u\n"
+                   "max reports per message %u messages/s %u\n"
+                   "latency avg %u max %u usec\n",
+                   stats.reports, stats.dropped, stats.messages,
+                   stats.send_errors, stats.max_batch, rate,
+                   stats.messages ?
+                       stats.latency_total / stats.messages : 0,
+                   stats.latency_max);
+
+    return len < buflen ? len : buflen - 1;
+}
+#endif
+
+static const struct gb_procfs_entry gb_procfs_entries[] = {
+#ifdef CONFIG_GREYBUS_OPERATION_POOL
+    { "pool", 256, gb_procfs_pool },
+#endif
+    { "rxqueue", 1024, gb_procfs_rxqueue },
+#ifdef CONFIG_GREYBUS_I2S_PHY
+    { "i2s", 256, gb_procfs_i2s },
+#endif
+#ifdef CONFIG_GREYBUS_HID
+    { "hid", 256, gb_procfs_hid },
+#endif
+#ifdef CONFIG_GREYBUS_STATS
+    { "stats", 4096, gb_procfs_stats },
+#endif
+};
+
+static const struct gb_procfs_entry *gb_procfs_find(const char *relpath)
+{
+    int i;
+
+    if (strncmp(relpath, GB_PROCFS_PREFIX, strlen(GB_PROCFS_PREFIX)))
+        return NULL;
+
+    relpath += strlen(GB_PROCFS_PREFIX);
+
+    for (i = 0; i < ARRAY_SIZE(gb_procfs_entries); i++) {
+        if (!strcmp(relpath, gb_procfs_entries[i].name))
+            return &gb_procfs_entries[i];
+    }
+
+    return NULL;
+}
+
+/**
+ * Open a Greybus procfs entry
+ *
+ * The content of the file is generated at open time, so that it stays
+ * consistent when it is read in several chunks.
+ */
+static int gb_procfs_open(struct file *filep, const char *relpath,
+                          int oflags, mode_t mode)
+{
+    const struct gb_procfs_entry *entry;
+    struct gb_procfs_file *file;
+
+    if ((oflags & O_WRONLY) || !(oflags & O_RDONLY))
+        return -EACCES;
+
+    entry = gb_procfs_find(relpath);
+    if (!entry)
+        return -ENOENT;
+
+    file = kmm_zalloc(sizeof(*file) + entry->bufsize);
+    if (!file)
+        return -ENOMEM;
+
+    file->buf = (char *) (file + 1);
+    file->size = entry->generate(file->buf, entry->bufsize);
+
+    filep->f_priv = file;
+    return OK;
+}
+
+static int gb_procfs_close(struct file *filep)
+{
+    kmm_free(filep->f_priv);
+    filep->f_priv = NULL;
+    return OK;
+}
+
+static ssize_t gb_procfs_read(struct file *filep, char *buffer, size_t buflen)
+{
+    struct gb_procfs_file *file = filep->f_priv;
+    off_t offset = filep->f_pos;
+    size_t nread;
+
+    DEBUGASSERT(file);
+
+    nread = procfs_memcpy(file->buf, file->size, buffer, buflen, &offset);
+    filep->f_pos += nread;
+
+    return nread;
+}
+
+static int gb_procfs_dup(const struct file *oldp, struct file *newp)
+{
+    struct gb_procfs_file *oldfile = oldp->f_priv;
+    struct gb_procfs_file *newfile;
+    size_t size;
+
+    DEBUGASSERT(oldfile);
+
+    size = sizeof(*oldfile) + oldfile->size;
+    newfile = kmm_malloc(size);
+    if (!newfile)
+        return -ENOMEM;
+
+    memcpy(newfile, oldfile, size);
+    newfile->buf = (char *) (newfile + 1);
+
+    newp->f_priv = newfile;
+    return OK;
+}
+
+static int gb_procfs_stat(const char *relpath, struct stat *buf)
+{
+    if (!gb_procfs_find(relpath))
+        return -ENOENT;
+
+    buf->st_mode = S_IFREG | S_IROTH | S_IRGRP | S_IRUSR;
+    buf->st_size = 0;
+    buf->st_blksize = 0;
+    buf->st_blocks = 0;
+    return OK;
+}
+
+const struct procfs_operations greybus_procfsoperations = {
+    gb_procfs_open,     /* open */
+    gb_procfs_close,    /* close */
+    gb_procfs_read,     /* read */
+    NULL,               /* write */
+
+    gb_procfs_dup,      /* dup */
+
+    NULL,               /* opendir */
+    NULL,               /* closedir */
+    NULL,               /* readdir */
+    NULL,               /* rewinddir */
+
+    gb_procfs_stat      /* stat */
+};
+
+#endif /* CONFIG_FS_PROCFS && !CONFIG_FS_PROCFS_EXCLUDE_GREYBUS */
@@ -42,6 +42,11 @@ static ssize_t gb_tape_read(int fd, void *data, size_t size)
     return semihosting_read(fd, data, size);
 }
 
+static int gb_tape_seek(int fd, off_t offset)
+{
+    return semihosting_seek(fd, offset);
+}
+
 static int gb_tape_open(const char *tape, int mode)
 {
     int semihosting_mode;
@@ -72,6 +77,7 @@ static struct gb_tape_mechanism gb_tape_arm_semihosting = {
     .close = gb_tape_close,
     .write = gb_tape_write,
     .read = gb_tape_read,
+    .seek = gb_tape_seek,
 };
 
 int gb_tape_arm_semihosting_register(void)
@@ -0,0 +1,824 @@
+/*
+ * Copyright (c) 2015 Google Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/*
+ * Greybus Tape: record incoming Greybus messages and replay them later.
+ *
+ * Tape layout (v2, native endianness):
+ *   struct gb_tape_header
+ *   { struct gb_tape_record_header, payload }...
+ *   struct gb_tape_index_entry[index_entries], when the tape has an index
+ *
+ * Tapes without the header magic are v1 tapes, made of
+ * { struct gb_tape_v1_record_header, payload } records only.
+ *
+ * The RX path only copies the message in a RAM ring. A writer thread drains
+ * the ring, optionally compresses the payloads, and writes them to the tape,
+ * so that recording never performs any I/O from the RX path. When the ring
+ * is full, messages are dropped and counted in the tape header.
+ */
+
+#include <nuttx/config.h>
+#include <nuttx/clock.h>
+#include <nuttx/hires_tmr.h>
+#include <nuttx/unipro/unipro.h>
+#include <nuttx/greybus/greybus.h>
+#include <nuttx/greybus/tape.h>
+#include <nuttx/greybus/debug.h>
+
+#include <arch/irq.h>
+
+#include <errno.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "greybus-core.h"
+
+#ifndef CONFIG_GREYBUS_TAPE_BUFFER_SIZE
+#define CONFIG_GREYBUS_TAPE_BUFFER_SIZE 4096
+#endif
+
+#ifndef CONFIG_GREYBUS_TAPE_INDEX_SIZE
+#define CONFIG_GREYBUS_TAPE_INDEX_SIZE  64
+#endif
+
+#if (CONFIG_GREYBUS_TAPE_BUFFER_SIZE & (CONFIG_GREYBUS_TAPE_BUFFER_SIZE - 1)) || \
+    CONFIG_GREYBUS_TAPE_BUFFER_SIZE < 2 * CPORT_BUF_SIZE
+#error CONFIG_GREYBUS_TAPE_BUFFER_SIZE must be a power of 2 >= 2 * CPORT_BUF_SIZE
+#endif
+
+#if CONFIG_GREYBUS_TAPE_INDEX_SIZE < 2 || CONFIG_GREYBUS_TAPE_INDEX_SIZE % 2
+#error CONFIG_GREYBUS_TAPE_INDEX_SIZE must be an even number >= 2
+#endif
+
+#define GB_TAPE_MAGIC           "GBTP"
+#define GB_TAPE_VERSION         2
+#define GB_TAPE_RING_MASK       (CONFIG_GREYBUS_TAPE_BUFFER_SIZE - 1)
+
+/* Initial number of records between two index entries */
+#define GB_TAPE_INDEX_STRIDE    16
+
+/* Worst case size of a payload after compression */
+#define GB_TAPE_PACKED_SIZE(size) ((size) + ((size) + 127) / 128)
+
+/* Record flags */
+#define GB_TAPE_RECORD_COMPRESSED   (1 << 0)
+
+struct gb_tape_v1_record_header {
+    uint16_t size;
+    uint16_t cport;
+};
+
+struct gb_tape_header {
+    char magic[4];
+    uint16_t version;
+    uint16_t flags;             /* GB_TAPE_COMPRESS if requested */
+    uint32_t records;           /* set when the tape is closed */
+    uint32_t dropped;           /* set when the tape is closed */
+    uint32_t duration;          /* set when the tape is closed */
+    uint32_t index_offset;      /* 0 when the tape has no index */
+    uint32_t index_entries;
+};
+
+struct gb_tape_record_header {
+    uint32_t timestamp;         /* us since the start of the recording */
+    uint16_t cport;
+    uint16_t size;              /* size of the message */
+    uint16_t stored_size;       /* size of the payload in the tape */
+    uint16_t flags;
+};
+
+struct gb_tape_index_entry {
+    uint32_t timestamp;
+    uint32_t offset;            /* offset of the record in the tape */
+};
+
+/* Message as queued in the ring by the RX path, followed by its payload */
+struct gb_tape_ring_entry {
+    uint32_t timestamp;
+    uint16_t cport;
+    uint16_t size;
+};
+
+struct gb_tape_recorder {
+    int fd;
+    int flags;
+    uint32_t start;
+
+    /* ring, filled with interrupts disabled and drained by the writer */
+    uint8_t *ring;
+    volatile uint32_t head;
+    volatile uint32_t tail;
+    uint32_t dropped;
+    sem_t ring_sem;
+    volatile bool stop;
+    pthread_t writer;
+
+    /* writer state */
+    int error;
+    uint8_t *buffer;
+    uint8_t *packed;
+    uint32_t offset;
+    uint32_t records;
+    uint32_t last_timestamp;
+    uint32_t index_stride;
+    unsigned int index_entries;
+    struct gb_tape_index_entry index[CONFIG_GREYBUS_TAPE_INDEX_SIZE];
+};
+
+static struct gb_tape_mechanism *gb_tape;
+static struct gb_tape_recorder *gb_tape_recorder;
+
+static uint32_t gb_tape_now(void)
+{
+#ifdef CONFIG_ARCH_HAVE_HIRES_TIMER
+    return hrt_getusec();
+#else
+    return clock_systimer() * USEC_PER_TICK;
+#endif
+}
+
+/*
+ * PackBits run-length encoding: a control byte n < 128 is followed by n + 1
+ * literal bytes, and a control byte n > 128 by one byte to repeat 257 - n
+ * times. Greybus payloads are mostly small integers and zero padding, which
+ * this handles well at a negligible CPU cost.
+ */
+static size_t gb_tape_pack(const uint8_t *src, size_t size, uint8_t *dst)
+{
+    size_t i = 0;
+    size_t o = 0;
+    size_t run;
+    size_t lit;
+
+    while (i < size) {
+        for (run = 1; i + run < size && run < 128; run++) {
+            if (src[i + run] != src[i])
+                break;
+        }
+
+        if (run >= 3) {
+            dst[o++] = 257 - run;
+            dst[o++] = src[i];
+            i += run;
+            continue;
+        }
+
+        /* Copy literally up to the next run of 3 bytes */
+        for (lit = 1; i + lit < size && lit < 128; lit++) {
+            if (i + lit + 2 < size && src[i + lit] == src[i + lit + 1] &&
+                src[i + lit] == src[i + lit + 2])
+                break;
+        }
+
+        dst[o++] = lit - 1;
+        memcpy(&dst[o], &src[i], lit);
+        o += lit;
+        i += lit;
+    }
+
+    return o;
+}
+
+static ssize_t gb_tape_unpack(const uint8_t *src, size_t size, uint8_t *dst,
+                              size_t dst_size)
+{
+    size_t i = 0;
+    size_t o = 0;
+    size_t n;
+    uint8_t c;
+
+    while (i < size) {
+        c = src[i++];
+        if (c < 128) {
+            n = c + 1;
+            if (i + n > size || o + n > dst_size)
+                return -EINVAL;
+
+            memcpy(&dst[o], &src[i], n);
+            i += n;
+        } else if (c > 128) {
+            n = 257 - c;
+            if (i >= size || o + n > dst_size)
+                return -EINVAL;
+
+            memset(&dst[o], src[i++], n);
+        } else {
+            continue;
+        }
+
+        o += n;
+    }
+
+    return o;
+}
+
+static void gb_tape_ring_put(struct gb_tape_recorder *rec, uint32_t pos,
+                             const void *data, size_t size)
+{
+    size_t offset = pos & GB_TAPE_RING_MASK;
+    size_t count = CONFIG_GREYBUS_TAPE_BUFFER_SIZE - offset;
+
+    if (count > size)
+        count = size;
+
+    memcpy(&rec->ring[offset], data, count);
+    memcpy(rec->ring, (const uint8_t *) data + count, size - count);
+}
+
+static void gb_tape_ring_get(struct gb_tape_recorder *rec, uint32_t pos,
+                             void *data, size_t size)
+{
+    size_t offset = pos & GB_TAPE_RING_MASK;
+    size_t count = CONFIG_GREYBUS_TAPE_BUFFER_SIZE - offset;
+
+    if (count > size)
+        count = size;
+
+    memcpy(data, &rec->ring[offset], count);
+    memcpy((uint8_t *) data + count, rec->ring, size - count);
+}
+
+void gb_tape_record(unsigned int cport, const void *data, size_t size)
+{
+    struct gb_tape_recorder *rec;
+    struct gb_tape_ring_entry entry;
+    irqstate_t flags;
+
+    if (!gb_tape_recorder)
+        return;
+
+    flags = irqsave();
+
+    rec = gb_tape_recorder;
+    if (!rec)
+        goto out;
+
+    if (size > CPORT_BUF_SIZE || CONFIG_GREYBUS_TAPE_BUFFER_SIZE -
+        (rec->head - rec->tail) < sizeof(entry) + size) {
+        rec->dropped++;
+        goto out;
+    }
+
+    entry.timestamp = gb_tape_now() - rec->start;
+    entry.cport = cport;
+    entry.size = size;
+
+    gb_tape_ring_put(rec, rec->head, &entry, sizeof(entry));
+    gb_tape_ring_put(rec, rec->head + sizeof(entry), data, size);
+    rec->head += sizeof(entry) + size;
+
+    sem_post(&rec->ring_sem);
+
+out:
+    irqrestore(flags);
+}
+
+static int gb_tape_write(int fd, const void *data, size_t size)
+{
+    ssize_t nwritten;
+
+    nwritten = gb_tape->write(fd, data, size);
+    if (nwritten != size)
+        return -EIO;
+
+    return 0;
+}
+
+static int gb_tape_read(int fd, void *data, size_t size)
+{
+    ssize_t nread;
+
+    nread = gb_tape->read(fd, data, size);
+    if (!nread)
+        return 0;
+
+    if (nread != size) {
+        gb_error("gb-tape: invalid byte count read, aborting...\n");
+        return -EIO;
+    }
+
+    return nread;
+}
+
+static void gb_tape_index_add(struct gb_tape_recorder *rec,
+                              uint32_t timestamp)
+{
+    unsigned int i;
+
+    if (rec->index_entries == CONFIG_GREYBUS_TAPE_INDEX_SIZE) {
+        /* Index is full: keep every other entry, halving its density */
+        for (i = 0; i < CONFIG_GREYBUS_TAPE_INDEX_SIZE / 2; i++)
+            rec->index[i] = rec->index[2 * i];
+
+        rec->index_entries = CONFIG_GREYBUS_TAPE_INDEX_SIZE / 2;
+        rec->index_stride *= 2;
+
+        if (rec->records % rec->index_stride)
+            return;
+    }
+
+    rec->index[rec->index_entries].timestamp = timestamp;
+    rec->index[rec->index_entries].offset = rec->offset;
+    rec->index_entries++;
+}
+
+static int gb_tape_write_record(struct gb_tape_recorder *rec,
+                                const struct gb_tape_ring_entry *entry)
+{
+    struct gb_tape_record_header hdr;
+    const uint8_t *payload = rec->buffer;
+    size_t packed_size;
+    int retval;
+
+    hdr.timestamp = entry->timestamp;
+    hdr.cport = entry->cport;
+    hdr.size = entry->size;
+    hdr.stored_size = entry->size;
+    hdr.flags = 0;
+
+    if (rec->flags & GB_TAPE_COMPRESS) {
+        packed_size = gb_tape_pack(rec->buffer, entry->size, rec->packed);
+        if (packed_size < entry->size) {
+            hdr.stored_size = packed_size;
+            hdr.flags |= GB_TAPE_RECORD_COMPRESSED;
+            payload = rec->packed;
+        }
+    }
+
+    if (!(rec->records % rec->index_stride))
+        gb_tape_index_add(rec, hdr.timestamp);
+
+    retval = gb_tape_write(rec->fd, &hdr, sizeof(hdr));
+    if (retval)
+        return retval;
+
+    retval = gb_tape_write(rec->fd, payload, hdr.stored_size);
+    if (retval)
+        return retval;
+
+    rec->offset += sizeof(hdr) + hdr.stored_size;
+    rec->records++;
+    rec->last_timestamp = hdr.timestamp;
+
+    return 0;
+}
+
+static void *gb_tape_writer(void *data)
+{
+    struct gb_tape_recorder *rec = data;
+    struct gb_tape_ring_entry entry;
+
+    do {
+        sem_wait(&rec->ring_sem);
+
+        while (rec->tail != rec->head) {
+            gb_tape_ring_get(rec, rec->tail, &entry, sizeof(entry));
+            gb_tape_ring_get(rec, rec->tail + sizeof(entry), rec->buffer,
+                             entry.size);
+            rec->tail += sizeof(entry) + entry.size;
+
+            if (rec->error)
+                continue;
+
+            rec->error = gb_tape_write_record(rec, &entry);
+            if (rec->error)
+                gb_error("gb-tape: write error, discarding messages\n");
+        }
+    } while (!rec->stop);
+
+    return NULL;
+}
+
+static void gb_tape_init_header(struct gb_tape_header *hdr, int flags)
+{
+    memset(hdr, 0, sizeof(*hdr));
+    memcpy(hdr->magic, GB_TAPE_MAGIC, sizeof(hdr->magic));
+    hdr->version = GB_TAPE_VERSION;
+    hdr->flags = flags;
+}
+
+/* Append the index and rewrite the header now that the totals are known */
+static int gb_tape_finalize(struct gb_tape_recorder *rec)
+{
+    struct gb_tape_header hdr;
+    int retval;
+
+    gb_tape_init_header(&hdr, rec->flags);
+    hdr.records = rec->records;
+    hdr.dropped = rec->dropped;
+    hdr.duration = rec->last_timestamp;
+    hdr.index_offset = rec->offset;
+    hdr.index_entries = rec->index_entries;
+
+    retval = gb_tape_write(rec->fd, rec->index,
+                           rec->index_entries * sizeof(rec->index[0]));
+    if (retval)
+        return retval;
+
+    retval = gb_tape->seek(rec->fd, 0);
+    if (retval)
+        return retval;
+
+    return gb_tape_write(rec->fd, &hdr, sizeof(hdr));
+}
+
+static void gb_tape_free_recorder(struct gb_tape_recorder *rec)
+{
+    free(rec->packed);
+    free(rec->buffer);
+    free(rec->ring);
+    free(rec);
+}
+
+int gb_tape_register_mechanism(struct gb_tape_mechanism *mechanism)
+{
+    if (!mechanism || !mechanism->open || !mechanism->close ||
+        !mechanism->read || !mechanism->write)
+        return -EINVAL;
+
+    if (gb_tape)
+        return -EBUSY;
+
+    gb_tape = mechanism;
+
+    return 0;
+}
+
+int gb_tape_communication(const char *pathname, int flags)
+{
+    struct gb_tape_recorder *rec;
+    struct gb_tape_header hdr;
+    irqstate_t irqflags;
+    int retval;
+
+    if (!gb_tape || !pathname)
+        return -EINVAL;
+
+    if (gb_tape_recorder)
+        return -EBUSY;
+
+    rec = zalloc(sizeof(*rec));
+    if (!rec)
+        return -ENOMEM;
+
+    rec->flags = flags & GB_TAPE_COMPRESS;
+    rec->index_stride = GB_TAPE_INDEX_STRIDE;
+    rec->ring = malloc(CONFIG_GREYBUS_TAPE_BUFFER_SIZE);
+    rec->buffer = malloc(CPORT_BUF_SIZE);
+    if (rec->flags & GB_TAPE_COMPRESS)
+        rec->packed = malloc(GB_TAPE_PACKED_SIZE(CPORT_BUF_SIZE));
+
+    if (!rec->ring || !rec->buffer ||
+        ((rec->flags & GB_TAPE_COMPRESS) && !rec->packed)) {
+        retval = -ENOMEM;
+        goto error_alloc;
+    }
+
+    rec->fd = gb_tape->open(pathname, GB_TAPE_WRONLY);
+    if (rec->fd < 0) {
+        retval = rec->fd;
+        goto error_alloc;
+    }
+
+    gb_tape_init_header(&hdr, rec->flags);
+    retval = gb_tape_write(rec->fd, &hdr, sizeof(hdr));
+    if (retval)
+        goto error_write_header;
+
+    rec->offset = sizeof(hdr);
+    sem_init(&rec->ring_sem, 0, 0);
+
+    retval = pthread_create(&rec->writer, NULL, gb_tape_writer, rec);
+    if (retval) {
+        retval = -retval;
+        goto error_pthread_create;
+    }
+
+    rec->start = gb_tape_now();
+
+    irqflags = irqsave();
+    gb_tape_recorder = rec;
+    irqrestore(irqflags);
+
+    return 0;
+
+error_pthread_create:
+    sem_destroy(&rec->ring_sem);
+error_write_header:
+    gb_tape->close(rec->fd);
+error_alloc:
+    gb_tape_free_recorder(rec);
+    return retval;
+}
+
+int gb_tape_stop(void)
+{
+    struct gb_tape_recorder *rec = gb_tape_recorder;
+    irqstate_t flags;
+    int retval;
+
+    if (!gb_tape || !rec)
+        return -EINVAL;
+
+    /* Once unpublished, the RX path can no longer queue messages */
+    flags = irqsave();
+    gb_tape_recorder = NULL;
+    irqrestore(flags);
+
+    rec->stop = true;
+    sem_post(&rec->ring_sem);
+    pthread_join(rec->writer, NULL);
+
+    retval = rec->error;
+    if (!retval && gb_tape->seek)
+        retval = gb_tape_finalize(rec);
+
+    if (rec->dropped)
+        lowsyslog("gb-tape: %u messages dropped while recording\n",
+                  rec->dropped);
+
+    gb_tape->close(rec->fd);
+    sem_destroy(&rec->ring_sem);
+    gb_tape_free_recorder(rec);
+
+    return retval;
+}
+
+static int gb_tape_replay_v1(int fd, struct gb_tape_v1_record_header *hdr,
+                             char *buffer)
+{
+    int retval;
+
+    do {
+        if (hdr->size > CPORT_BUF_SIZE)
+            return -EINVAL;
+
+        retval = gb_tape_read(fd, buffer, hdr->size);
+        if (retval < 0)
+            return retval;
+
+        if (retval != hdr->size) {
+            gb_error("gb-tape: invalid byte count read, aborting...\n");
+            return -EIO;
+        }
+
+        greybus_rx_handler(hdr->cport, buffer, hdr->size);
+
+        retval = gb_tape_read(fd, hdr, sizeof(*hdr));
+    } while (retval > 0);
+
+    return retval;
+}
+
+/* Find the offset of the last indexed record at or before start_us */
+static int gb_tape_index_lookup(int fd, const struct gb_tape_header *hdr,
+                                uint32_t start_us, uint32_t *offset)
+{
+    struct gb_tape_index_entry entry;
+    unsigned int i;
+    int retval;
+
+    retval = gb_tape->seek(fd, hdr->index_offset);
+    if (retval)
+        return retval;
+
+    for (i = 0; i < hdr->index_entries; i++) {
+        retval = gb_tape_read(fd, &entry, sizeof(entry));
+        if (retval <= 0)
+            return retval ? retval : -EIO;
+
+        if (entry.timestamp > start_us)
+            break;
+
+        *offset = entry.offset;
+    }
+
+    return gb_tape->seek(fd, *offset);
+}
+
+static int gb_tape_replay_v2(int fd, const struct gb_tape_header *hdr,
+                             enum gb_tape_replay_mode mode,
+                             uint32_t start_us, char *buffer, char *packed)
+{
+    struct gb_tape_record_header rec;
+    uint32_t offset = sizeof(*hdr);
+    uint32_t end = hdr->index_offset ? hdr->index_offset : UINT32_MAX;
+    uint32_t base_timestamp = 0;
+    uint32_t base = 0;
+    uint32_t start = gb_tape_now();
+    uint32_t messages = 0;
+    uint32_t bytes = 0;
+    int32_t delay;
+    ssize_t size;
+    int retval;
+
+    if (start_us && hdr->index_offset && gb_tape->seek) {
+        retval = gb_tape_index_lookup(fd, hdr, start_us, &offset);
+        if (retval)
+            return retval;
+    }
+
+    while (offset < end) {
+        retval = gb_tape_read(fd, &rec, sizeof(rec));
+        if (retval <= 0)
+            break;
+
+        if (rec.size > CPORT_BUF_SIZE || rec.stored_size > CPORT_BUF_SIZE) {
+            gb_error("gb-tape: invalid record, aborting...\n");
+            return -EINVAL;
+        }
+
+        retval = gb_tape_read(fd, packed, rec.stored_size);
+        if (retval < 0)
+            break;
+
+        if (retval != rec.stored_size) {
+            gb_error("gb-tape: truncated record, aborting...\n");
+            return -EIO;
+        }
+
+        offset += sizeof(rec) + rec.stored_size;
+
+        if (rec.timestamp < start_us)
+            continue;
+
+        if (rec.flags & GB_TAPE_RECORD_COMPRESSED) {
+            size = gb_tape_unpack((uint8_t *) packed, rec.stored_size,
+                                  (uint8_t *) buffer, CPORT_BUF_SIZE);
+            if (size != rec.size) {
+                gb_error("gb-tape: corrupted record, aborting...\n");
+                return -EINVAL;
+            }
+        } else {
+            memcpy(buffer, packed, rec.size);
+        }
+
+        if (mode == GB_TAPE_REPLAY_REALTIME) {
+            if (!messages) {
+                base_timestamp = rec.timestamp;
+                base = gb_tape_now();
+            } else {
+                delay = (rec.timestamp - base_timestamp) -
+                        (gb_tape_now() - base);
+                if (delay > 0)
+                    usleep(delay);
+            }
+        }
+
+        greybus_rx_handler(rec.cport, buffer, rec.size);
+        messages++;
+        bytes += rec.size;
+    }
+
+    lowsyslog("greybus: replayed %u messages (%u bytes) in %u us\n",
+              messages, bytes, gb_tape_now() - start);
+
+    return retval < 0 ? retval : 0;
+}
+
+int gb_tape_replay_mode(const char *pathname, enum gb_tape_replay_mode mode,
+                        uint32_t start_ms)
+{
+    struct gb_tape_header hdr;
+    char *buffer;
+    char *packed;
+    int retval;
+    int fd;
+
+    if (!pathname || !gb_tape)
+        return -EINVAL;
+
+    lowsyslog("greybus: replaying '%s'...\n", pathname);
+
+    fd = gb_tape->open(pathname, GB_TAPE_RDONLY);
+    if (fd < 0)
+        return fd;
+
+    buffer = malloc(CPORT_BUF_SIZE);
+    packed = malloc(CPORT_BUF_SIZE);
+    if (!buffer || !packed) {
+        retval = -ENOMEM;
+        goto out;
+    }
+
+    /* The magic has the size of a v1 record header */
+    retval = gb_tape_read(fd, &hdr, sizeof(hdr.magic));
+    if (retval <= 0)
+        goto out;
+
+    if (memcmp(hdr.magic, GB_TAPE_MAGIC, sizeof(hdr.magic))) {
+        if (mode != GB_TAPE_REPLAY_MAX_SPEED || start_ms)
+            lowsyslog("greybus: v1 tape, replaying at max speed\n");
+
+        retval = gb_tape_replay_v1(fd,
+                    (struct gb_tape_v1_record_header *) hdr.magic, buffer);
+        goto out;
+    }
+
+    retval = gb_tape_read(fd, &hdr.version, sizeof(hdr) - sizeof(hdr.magic));
+    if (retval <= 0) {
+        retval = -EIO;
+        goto out;
+    }
+
+    if (hdr.version != GB_TAPE_VERSION) {
+        gb_error("gb-tape: unsupported tape version %u\n", hdr.version);
+        retval = -EINVAL;
+        goto out;
+    }
+
+    retval = gb_tape_replay_v2(fd, &hdr, mode, start_ms * 1000, buffer,
+                               packed);
+
+out:
+    free(packed);
+    free(buffer);
+    gb_tape->close(fd);
+
+    return retval;
+}
+
+int gb_tape_replay(const char *pathname)
+{
+    return gb_tape_replay_mode(pathname, GB_TAPE_REPLAY_MAX_SPEED, 0);
+}
+
+int gb_tape_get_info(const char *pathname, struct gb_tape_info *info)
+{
+    struct gb_tape_header hdr;
+    int retval;
+    int fd;
+
+    if (!pathname || !info || !gb_tape)
+        return -EINVAL;
+
+    fd = gb_tape->open(pathname, GB_TAPE_RDONLY);
+    if (fd < 0)
+        return fd;
+
+    memset(info, 0, sizeof(*info));
+
+    /*
+     * As for replay, only the magic tells the versions apart: a v1 tape
+     * can be shorter than the v2 header, and an empty tape is a v1 one.
+     */
+    retval = gb_tape_read(fd, &hdr, sizeof(hdr.magic));
+    if (retval < 0)
+        goto out;
+
+    if (!retval || memcmp(hdr.magic, GB_TAPE_MAGIC, sizeof(hdr.magic))) {
+        info->version = 1;
+        retval = 0;
+        goto out;
+    }
+
+    retval = gb_tape_read(fd, &hdr.version, sizeof(hdr) - sizeof(hdr.magic));
+    if (retval <= 0) {
+        retval = -EIO;
+        goto out;
+    }
+
+    info->version = hdr.version;
+    info->flags = hdr.flags;
+    info->records = hdr.records;
+    info->dropped = hdr.dropped;
+    info->duration = hdr.duration;
+    info->index_entries = hdr.index_entries;
+    retval = 0;
+
+out:
+    gb_tape->close(fd);
+    return retval;
+}
@@ -37,12 +37,48 @@ static int gb_unipro_rx_handler(unsigned int cport, void *data, size_t size)
 {
     int retval;
 
+#ifdef CONFIG_GREYBUS_ZERO_COPY_RX
+    retval = greybus_rx_handler_nocopy(cport, data, size);
+    if (retval == GB_RX_BUFFER_BORROWED)
+        return 0; /* RX is unpaused when the buffer gets released */
+#else
     retval = greybus_rx_handler(cport, data, size);
+#endif
+    if (retval == GB_RX_PAUSED)
+        return 0; /* RX is unpaused when the RX queue has room again */
+
     unipro_unpause_rx(cport);
 
     return retval;
 }
 
+#ifdef CONFIG_GREYBUS_ZERO_COPY_RX
+static void gb_unipro_rx_release(unsigned int cport, void *buf)
+{
+    unipro_unpause_rx(cport);
+}
+#endif
+
+static void gb_unipro_rx_resume(unsigned int cport)
+{
+    unipro_unpause_rx(cport);
+}
+
+static int gb_unipro_set_tx_priority(unsigned int cport,
+                                     enum gb_tx_priority priority)
+{
+    switch (priority) {
+    case GB_TX_PRIORITY_HIGH:
+        return unipro_set_tx_priority(cport, UNIPRO_TX_PRIO_HIGH);
+    case GB_TX_PRIORITY_LOW:
+        return unipro_set_tx_priority(cport, UNIPRO_TX_PRIO_LOW);
+    case GB_TX_PRIORITY_NORMAL:
+        return unipro_set_tx_priority(cport, UNIPRO_TX_PRIO_NORMAL);
+    default:
+        return -EINVAL;
+    }
+}
+
 static struct unipro_driver greybus_driver = {
     .name = "greybus",
     .rx_handler = gb_unipro_rx_handler,
@@ -61,8 +97,14 @@ static int gb_unipro_stop_listening(unsigned int cport)
 struct gb_transport_backend gb_unipro_backend = {
     .init = unipro_init,
     .send = unipro_send,
+    .send_iov = unipro_send_iov,
     .listen = gb_unipro_listen,
     .stop_listening = gb_unipro_stop_listening,
+#ifdef CONFIG_GREYBUS_ZERO_COPY_RX
+    .rx_release = gb_unipro_rx_release,
+#endif
+    .rx_resume = gb_unipro_rx_resume,
+    .set_tx_priority = gb_unipro_set_tx_priority,
 };
 
 int gb_unipro_init(void)
@@ -32,21 +32,39 @@
 #include <string.h>
 #include <queue.h>
 
+#include <sys/uio.h>
+
+#include <nuttx/clock.h>
+#include <nuttx/wdog.h>
+#include <nuttx/hires_tmr.h>
 #include <nuttx/device.h>
 #include <nuttx/device_hid.h>
 #include <nuttx/greybus/greybus.h>
+#include <nuttx/unipro/unipro.h>
 #include <apps/greybus-utils/utils.h>
 
 #include <arch/byteorder.h>
 
 #include "hid-gb.h"
+#include "greybus-core.h"
 
 #define GB_HID_VERSION_MAJOR 0
 #define GB_HID_VERSION_MINOR 1
 
+/* Requests older than the last few are stale, drop them under a flood */
+#define GB_HID_RX_QUEUE_DEPTH 4
+
 /* Reserved operations for IRQ event input report buffer. */
 #define MAX_REPORT_OPERATIONS 5
 
+#ifndef CONFIG_GREYBUS_HID_BATCH_REPORTS
+#define CONFIG_GREYBUS_HID_BATCH_REPORTS 1
+#endif
+
+#ifndef CONFIG_GREYBUS_HID_BATCH_LATENCY_USEC
+#define CONFIG_GREYBUS_HID_BATCH_LATENCY_USEC 10000
+#endif
+
 /**
  * The structure for an operation queue.
  */
@@ -57,8 +75,14 @@ struct op_node {
     /** pointer to operation */
     struct gb_operation *operation;
 
-    /** pointer to buffer of request in operation */
+    /** buffer holding the batched input reports */
     uint8_t  *buffer;
+
+    /** number of reports in buffer */
+    int count;
+
+    /** arrival time of the first report in buffer, in usec */
+    uint32_t first_usec;
 };
 
 /**
@@ -100,6 +124,21 @@ struct gb_hid_info {
 
     /** inform the thread should be terminated */
     int thread_stop;
+
+    /** maximum number of reports per IRQ Event message */
+    int batch;
+
+    /** latency budget of a batch, in ticks */
+    int batch_ticks;
+
+    /** watchdog sending an incomplete batch */
+    WDOG_ID batch_wdog;
+
+    /** input report counters */
+    struct gb_hid_stats stats;
+
+    /** time the first IRQ Event message was sent, in usec */
+    uint32_t first_send_usec;
 };
 
 static struct gb_hid_info *hid_info = NULL;
@@ -142,6 +181,15 @@ static struct op_node *node_dequeue(sq_queue_t *queue)
     return node;
 }
 
+static uint32_t gb_hid_now(void)
+{
+#ifdef CONFIG_ARCH_HAVE_HIRES_TIMER
+    return hrt_getusec();
+#else
+    return clock_systimer() * USEC_PER_TICK;
+#endif
+}
+
 /**
  * @brief Get this firmware supported HID protocol version.
  *
@@ -375,14 +423,67 @@ static uint8_t gb_hid_set_report(struct gb_operation *operation)
     return GB_OP_SUCCESS;
 }
 
+/**
+ * @brief Hand the current report node over to the report thread.
+ *
+ * Must be called with interrupts disabled.
+ *
+ * @param None.
+ * @return None.
+ */
+static void hid_queue_report_node(void)
+{
+    struct op_node *node;
+
+    if (hid_info->batch > 1) {
+        wd_cancel(hid_info->batch_wdog);
+    }
+
+    node_requeue(&hid_info->data_queue, hid_info->report_node);
+
+    node = node_dequeue(&hid_info->free_queue);
+    if (!node) {
+        hid_info->node_request = 1;
+        /**
+         * event no free node, we still need active thread to process data
+         * queue.
+         */
+    }
+
+    hid_info->report_node = node;
+
+    sem_post(&hid_info->active_sem);
+}
+
+/**
+ * @brief Batch latency budget expiration.
+ *
+ * Sends the reports batched so far without waiting for the message to be
+ * full.
+ *
+ * @param argc The number of arguments.
+ * @param arg Unused.
+ * @return None.
+ */
+static void hid_batch_timeout(int argc, uint32_t arg)
+{
+    irqstate_t flags = irqsave();
+
+    if (hid_info->report_node && hid_info->report_node->count) {
+        hid_queue_report_node();
+    }
+
+    irqrestore(flags);
+}
+
 /**
  * @brief Callback for data receiving
  *
- * This callback provide a function call for HID device driver to notify
- * protocol when device driver received a data stream.
- * It put the current operation node to data queue and set free operation
- * node for next receiving activte. Finally, active the report_proc_thread to
- * process IRQ Event request protocol.
+ * The callback function provided to device driver for being notified when
+ * driver received a data stream. It appends the report to the current
+ * operation buffer, which is sent by the report thread once it holds
+ * CONFIG_GREYBUS_HID_BATCH_REPORTS reports or once the first of them has
+ * waited for CONFIG_GREYBUS_HID_BATCH_LATENCY_USEC.
  *
  * @param dev Pointer to structure of device data.
  * @param report_type HID report type.
@@ -394,39 +495,69 @@ static int hid_event_callback_routine(struct device *dev, uint8_t report_type,
                                       uint8_t *report, uint16_t len)
 {
     struct op_node *node;
-
-    if (!hid_info->report_node) {
-        /**
-         * active report_proc_thread to send operation for node free
-         */
-        sem_post(&hid_info->active_sem);
-        return -ENOMEM;
-    }
+    irqstate_t flags;
 
     if (hid_info->report_buf_size != len) {
         return -EINVAL;
     }
 
-    memcpy(hid_info->report_node->buffer, report, len);
-
-    node_requeue(&hid_info->data_queue, hid_info->report_node);
+    flags = irqsave();
 
-    node = node_dequeue(&hid_info->free_queue);
+    node = hid_info->report_node;
     if (!node) {
-        hid_info->node_request = 1;
+        hid_info->stats.dropped++;
+        irqrestore(flags);
         /**
-         * event no free node, we still need active thread to process data
-         * queue.
+         * active report_proc_thread to send operation for node free
          */
+        sem_post(&hid_info->active_sem);
+        return -ENOMEM;
     }
 
-    hid_info->report_node = node;
+    memcpy(node->buffer + node->count * len, report, len);
+    if (!node->count++) {
+        node->first_usec = gb_hid_now();
+    }
+    hid_info->stats.reports++;
 
-    sem_post(&hid_info->active_sem);
+    if (node->count >= hid_info->batch) {
+        hid_queue_report_node();
+    } else if (node->count == 1) {
+        wd_start(hid_info->batch_wdog, hid_info->batch_ticks,
+                 (wdentry_t)hid_batch_timeout, 1, 0);
+    }
+
+    irqrestore(flags);
 
     return 0;
 }
 
+/**
+ * @brief Account for an IRQ Event message about to be sent.
+ *
+ * @param node The node holding the reports of the message.
+ * @return None.
+ */
+static void hid_update_stats(struct op_node *node)
+{
+    struct gb_hid_stats *stats = &hid_info->stats;
+    uint32_t now = gb_hid_now();
+    uint32_t latency = now - node->first_usec;
+
+    if (!stats->messages) {
+        hid_info->first_send_usec = now;
+    }
+    stats->elapsed = now - hid_info->first_send_usec;
+    stats->messages++;
+    stats->latency_total += latency;
+    if (latency > stats->latency_max) {
+        stats->latency_max = latency;
+    }
+    if (node->count > stats->max_batch) {
+        stats->max_batch = node->count;
+    }
+}
+
 /**
  * @brief Data receiving process thread
  *
@@ -440,6 +571,8 @@ static int hid_event_callback_routine(struct device *dev, uint8_t report_type,
 static void *report_proc_thread(void *data)
 {
     struct op_node *node = NULL;
+    struct iovec iov;
+    irqstate_t flags;
     int ret;
 
     while (1) {
@@ -451,19 +584,28 @@ static void *report_proc_thread(void *data)
 
         node = node_dequeue(&hid_info->data_queue);
         if (node) {
-            ret = gb_operation_send_request(node->operation, NULL, false);
+            iov.iov_base = node->buffer;
+            iov.iov_len = node->count * hid_info->report_buf_size;
+            hid_update_stats(node);
+
+            ret = gb_operation_send_request_iov(node->operation, NULL, false,
+                                                &iov, 1);
             if (ret) {
+                hid_info->stats.send_errors++;
                 gb_info("IRQ Event operation failed (%x)!\n",
                          ret);
             }
+            node->count = 0;
             node_requeue(&hid_info->free_queue, node);
         }
 
+        flags = irqsave();
         if (hid_info->node_request) {
             node = node_dequeue(&hid_info->free_queue);
             hid_info->report_node = node;
             hid_info->node_request = 0;
         }
+        irqrestore(flags);
     }
 
     return NULL;
@@ -493,6 +635,8 @@ static void hid_free_op(sq_queue_t *queue)
  * @brief Allocate operations for receiver buffers
  *
  * This function is allocating operation and use them as receiving buffers.
+ * The reports are batched in a buffer allocated with the node, and sent as
+ * the payload of the operation.
  *
  * @param max_nodes Maximum nodes.
  * @param buf_size Buffer size in operation.
@@ -502,26 +646,23 @@ static void hid_free_op(sq_queue_t *queue)
 static int hid_alloc_op(int max_nodes, int buf_size, sq_queue_t *queue)
 {
     struct gb_operation *operation = NULL;
-    struct gb_hid_input_report_request *request = NULL;
     struct op_node *node = NULL;
     int i = 0;
 
     for (i = 0; i < max_nodes; i++) {
         operation = gb_operation_create(hid_info->cport,
-                                        GB_HID_TYPE_IRQ_EVENT, buf_size);
+                                        GB_HID_TYPE_IRQ_EVENT, 0);
         if (!operation) {
             goto err_free_op;
         }
 
-        node = zalloc(sizeof(struct op_node));
+        node = zalloc(sizeof(struct op_node) + buf_size);
         if (!node) {
             gb_operation_destroy(operation);
             goto err_free_op;
         }
         node->operation = operation;
-
-        request = gb_operation_get_request_payload(operation);
-        node->buffer = request->report;
+        node->buffer = (uint8_t *)(node + 1);
         node_requeue(queue, node);
     }
 
@@ -553,10 +694,34 @@ static int hid_receiver_callback_init(void)
 
     hid_info->entries = MAX_REPORT_OPERATIONS;
 
-    ret = hid_alloc_op(hid_info->entries, hid_info->report_buf_size,
+    /* a batch must fit in a single message */
+    hid_info->batch = (CPORT_BUF_SIZE - sizeof(struct gb_operation_hdr)) /
+                      hid_info->report_buf_size;
+    if (hid_info->batch > CONFIG_GREYBUS_HID_BATCH_REPORTS) {
+        hid_info->batch = CONFIG_GREYBUS_HID_BATCH_REPORTS;
+    }
+    if (hid_info->batch < 1) {
+        hid_info->batch = 1;
+    }
+
+    hid_info->batch_ticks = (CONFIG_GREYBUS_HID_BATCH_LATENCY_USEC +
+                             USEC_PER_TICK - 1) / USEC_PER_TICK;
+    if (hid_info->batch_ticks < 1) {
+        hid_info->batch_ticks = 1;
+    }
+
+    if (hid_info->batch > 1) {
+        hid_info->batch_wdog = wd_create();
+        if (!hid_info->batch_wdog) {
+            return -ENOMEM;
+        }
+    }
+
+    ret = hid_alloc_op(hid_info->entries,
+                       hid_info->batch * hid_info->report_buf_size,
                        &hid_info->free_queue);
     if (ret) {
-        return ret;
+        goto err_delete_wdog;
     }
 
     ret = sem_init(&hid_info->active_sem, 0, 0);
@@ -576,8 +741,12 @@ err_destroy_active_sem:
     sem_destroy(&hid_info->active_sem);
 err_free_data_op:
     hid_free_op(&hid_info->free_queue);
+err_delete_wdog:
+    if (hid_info->batch_wdog) {
+        wd_delete(hid_info->batch_wdog);
+    }
 
-    return -ret;
+    return ret < 0 ? ret : -ret;
 }
 
 /**
@@ -597,8 +766,17 @@ static void hid_receiver_callback_deinit(void)
         pthread_join(hid_info->pthread_handler, NULL);
     }
 
+    if (hid_info->batch_wdog) {
+        wd_delete(hid_info->batch_wdog);
+    }
+
     sem_destroy(&hid_info->active_sem);
 
+    if (hid_info->report_node) {
+        node_requeue(&hid_info->free_queue, hid_info->report_node);
+        hid_info->report_node = NULL;
+    }
+
     hid_free_op(&hid_info->data_queue);
     hid_free_op(&hid_info->free_queue);
 }
@@ -682,6 +860,27 @@ static void gb_hid_exit(unsigned int cport)
 
 }
 
+/**
+ * @brief Get the input report counters of the HID bundle
+ *
+ * @param stats Structure filled with the counters
+ * @return 0 on success, -EINVAL when the HID protocol is not running
+ */
+int gb_hid_get_stats(struct gb_hid_stats *stats)
+{
+    irqstate_t flags;
+
+    if (!hid_info || !stats) {
+        return -EINVAL;
+    }
+
+    flags = irqsave();
+    *stats = hid_info->stats;
+    irqrestore(flags);
+
+    return 0;
+}
+
 /**
  * @brief Greybus HID protocol operation handler
  */
@@ -700,6 +899,8 @@ static struct gb_driver gb_hid_driver = {
     .exit = gb_hid_exit,
     .op_handlers = gb_hid_handlers,
     .op_handlers_count = ARRAY_SIZE(gb_hid_handlers),
+    .rx_queue_depth = GB_HID_RX_QUEUE_DEPTH,
+    .rx_queue_policy = GB_RX_QUEUE_DROP_OLDEST,
 };
 
 /**
@@ -71,6 +71,7 @@
 #include <arch/byteorder.h>
 
 #include "i2s-gb.h"
+#include "greybus-core.h"
 
 #define GB_I2S_VERSION_MAJOR            0
 #define GB_I2S_VERSION_MINOR            1
@@ -80,7 +81,19 @@
 
 #define GB_I2S_SAMPLES_PER_MSG_DEFAULT  1
 
-#define GB_I2S_TX_SEND_DOWNSTREAM       8
+#ifndef CONFIG_GREYBUS_I2S_RX_JITTER_DEPTH
+#define CONFIG_GREYBUS_I2S_RX_JITTER_DEPTH  2
+#endif
+
+#ifndef CONFIG_GREYBUS_I2S_TX_JITTER_DEPTH
+#define CONFIG_GREYBUS_I2S_TX_JITTER_DEPTH  8
+#endif
+
+#ifndef CONFIG_GREYBUS_I2S_WORKER_PRIORITY
+#define CONFIG_GREYBUS_I2S_WORKER_PRIORITY  120
+#endif
+
+#define GB_I2S_TX_SEND_DOWNSTREAM       CONFIG_GREYBUS_I2S_TX_JITTER_DEPTH
 #define GB_I2S_TX_TIMER_FUDGE_NS        (5 * 1000)
 
 #define GB_I2S_TX_RING_BUF_PAD          8
@@ -119,6 +132,16 @@ struct gb_i2s_cport_list_entry {
     enum gb_i2s_cport_state state;
 };
 
+/*
+ * Receive ring buffer entry.  The entry either points to the Send Data
+ * request it plays (zero-copy), to the shared dummy data, or to its own
+ * buffer when the request had to be copied.
+ */
+struct gb_i2s_rx_entry {
+    uint8_t             *buf;
+    struct gb_operation *operation;
+};
+
 struct gb_i2s_info { /* One per I2S Bundle */
     uint16_t            mgmt_cport;
     uint32_t            flags;
@@ -136,6 +159,13 @@ struct gb_i2s_info { /* One per I2S Bundle */
     struct list_head    cport_list;
     struct ring_buf     *rx_rb;
     uint32_t            rx_rb_count;
+    unsigned int        rx_entries;
+    struct ring_buf     *rx_reclaim_rb;
+    /* operations played by the i2s driver, to be released by the worker */
+    struct gb_operation **rx_release;
+    volatile unsigned int rx_release_head;
+    unsigned int        rx_release_tail;
+    struct gb_i2s_stats stats;
     struct ring_buf     *tx_rb;
     sem_t               active_cports_lock;
     sem_t               tx_rb_sem;
@@ -247,19 +277,45 @@ static void gb_i2s_report_event(struct gb_i2s_info *info, uint32_t event)
     gb_operation_destroy(operation);
 }
 
-static void gb_i2s_ll_tx(struct gb_i2s_info *info, uint8_t *data)
+/* Operations can't be released from irq context so defer it to the worker */
+static void gb_i2s_rx_entry_release(struct gb_i2s_info *info,
+                                    struct gb_i2s_rx_entry *entry)
 {
-    ring_buf_reset(info->rx_rb);
+    if (!entry->operation)
+        return;
 
-    /*
-     * Unfortunately, we have to copy the data because the unipro
-     * susbystem reuses the buffer immediately and the data may
-     * not be sent out yet.
-     */
-    memcpy(ring_buf_get_tail(info->rx_rb), data, info->msg_data_size);
+    info->rx_release[info->rx_release_head % info->rx_entries] =
+        entry->operation;
+    info->rx_release_head++;
+    entry->operation = NULL;
+}
+
+/* Called with interrupts disabled */
+static void gb_i2s_ll_tx(struct gb_i2s_info *info, uint8_t *data,
+                         struct gb_operation *operation)
+{
+    struct ring_buf *rb = info->rx_rb;
+    struct gb_i2s_rx_entry *entry = ring_buf_get_priv(rb);
+
+    gb_i2s_rx_entry_release(info, entry);
+
+    if (operation) {
+        /* Play the sample data in place, right after the Greybus headers */
+        gb_operation_ref(operation);
+        entry->operation = operation;
+        ring_buf_init(rb, operation->request_buffer,
+                      sizeof(struct gb_operation_hdr) +
+                        sizeof(struct gb_i2s_send_data_request),
+                      info->msg_data_size);
+    } else if (data == info->dummy_data) {
+        ring_buf_init(rb, info->dummy_data, 0, info->msg_data_size);
+    } else {
+        ring_buf_init(rb, entry->buf, 0, info->msg_data_size);
+        memcpy(ring_buf_get_tail(rb), data, info->msg_data_size);
+    }
 
-    ring_buf_put(info->rx_rb, info->msg_data_size);
-    ring_buf_pass(info->rx_rb);
+    ring_buf_put(rb, info->msg_data_size);
+    ring_buf_pass(rb);
 
     info->next_rx_sample += info->samples_per_message;
     info->rx_rb = ring_buf_get_next(info->rx_rb);
@@ -277,13 +333,19 @@ static void gb_i2s_ll_tx_cb(struct ring_buf *rb,
     switch (event) {
     case DEVICE_I2S_EVENT_TX_COMPLETE:
         info->rx_rb_count--;
+        info->stats.rx.min_level = MIN(info->stats.rx.min_level,
+                                       info->rx_rb_count);
 
         /* TODO: Replace with smarter underrun prevention */
-        if (info->rx_rb_count < 2)
-            gb_i2s_ll_tx(info, info->dummy_data);
+        if (info->rx_rb_count < CONFIG_GREYBUS_I2S_RX_JITTER_DEPTH &&
+            ring_buf_is_producers(info->rx_rb)) {
+            gb_i2s_ll_tx(info, info->dummy_data, NULL);
+            info->stats.rx.underrun_fills++;
+        }
 
         break;
     case DEVICE_I2S_EVENT_UNDERRUN:
+        info->stats.rx.underruns++;
         gb_event = GB_I2S_EVENT_UNDERRUN;
         break;
     case DEVICE_I2S_EVENT_OVERRUN:
@@ -309,6 +371,52 @@ static void gb_i2s_ll_tx_cb(struct ring_buf *rb,
     }
 }
 
+/* Release the operations of the entries that have been played */
+static void gb_i2s_rx_reclaim(struct gb_i2s_info *info)
+{
+    irqstate_t flags;
+
+    flags = irqsave();
+
+    while (info->rx_reclaim_rb != info->rx_rb &&
+           ring_buf_is_producers(info->rx_reclaim_rb)) {
+        gb_i2s_rx_entry_release(info, ring_buf_get_priv(info->rx_reclaim_rb));
+        info->rx_reclaim_rb = ring_buf_get_next(info->rx_reclaim_rb);
+    }
+
+    irqrestore(flags);
+
+    while (info->rx_release_tail != info->rx_release_head) {
+        gb_operation_destroy(info->rx_release[info->rx_release_tail %
+                                              info->rx_entries]);
+        info->rx_release_tail++;
+    }
+}
+
+static int gb_i2s_rb_alloc_rx_entry(struct ring_buf *rb, void *arg)
+{
+    struct gb_i2s_rx_entry *entry;
+
+    entry = zalloc(sizeof(*entry));
+    if (!entry)
+        return -ENOMEM;
+
+    entry->buf = ring_buf_get_buf(rb);
+    ring_buf_set_priv(rb, entry);
+
+    return 0;
+}
+
+static void gb_i2s_rb_free_rx_entry(struct ring_buf *rb, void *arg)
+{
+    struct gb_i2s_rx_entry *entry = ring_buf_get_priv(rb);
+
+    if (entry->operation)
+        gb_operation_destroy(entry->operation);
+
+    free(entry);
+}
+
 static int gb_i2s_prepare_receiver(struct gb_i2s_info *info)
 {
     unsigned int entries;
@@ -322,19 +430,35 @@ static int gb_i2s_prepare_receiver(struct gb_i2s_info *info)
                (info->samples_per_message * 1000000)) +
                GB_I2S_RX_RING_BUF_PAD;
 
-    info->rx_rb = ring_buf_alloc_ring(entries,
-                                      sizeof(struct gb_operation_hdr) +
-                                        sizeof(struct gb_i2s_send_data_request),
-                                      info->msg_data_size, 0, NULL, NULL, NULL);
-    if (!info->rx_rb)
+    /* Each entry holds at most one operation waiting to be released */
+    info->rx_release = malloc(entries * sizeof(*info->rx_release));
+    if (!info->rx_release)
         return -ENOMEM;
 
+    info->rx_rb = ring_buf_alloc_ring(entries, 0, info->msg_data_size, 0,
+                                      gb_i2s_rb_alloc_rx_entry,
+                                      gb_i2s_rb_free_rx_entry, info);
+    if (!info->rx_rb) {
+        free(info->rx_release);
+        info->rx_release = NULL;
+        return -ENOMEM;
+    }
+
+    info->rx_entries = entries;
+    info->rx_reclaim_rb = info->rx_rb;
+    info->rx_release_head = 0;
+    info->rx_release_tail = 0;
+    memset(&info->stats.rx, 0, sizeof(info->stats.rx));
+    info->stats.rx.min_level = UINT32_MAX;
+
     /* Greybus i2s message receiver is local i2s transmitter */
     ret = device_i2s_prepare_transmitter(info->dev, info->rx_rb,
                                          gb_i2s_ll_tx_cb, info);
     if (ret) {
-        ring_buf_free_ring(info->rx_rb, NULL, NULL);
+        ring_buf_free_ring(info->rx_rb, gb_i2s_rb_free_rx_entry, info);
         info->rx_rb = NULL;
+        free(info->rx_release);
+        info->rx_release = NULL;
 
         return -EIO;
     }
@@ -350,6 +474,7 @@ static uint8_t gb_i2s_receiver_send_data_req_handler(
     struct gb_i2s_send_data_request *request =
                 gb_operation_get_request_payload(operation);
     struct gb_i2s_info *info;
+    struct gb_operation *hold = operation;
     irqstate_t flags;
     int ret;
 
@@ -369,14 +494,27 @@ static uint8_t gb_i2s_receiver_send_data_req_handler(
     if (!info->active_rx_cports)
         goto err_exit;
 
-    if (le32_to_cpu(request->size) != info->msg_data_size) {
+    if (le32_to_cpu(request->size) != info->msg_data_size ||
+        gb_operation_get_request_payload_size(operation) <
+            sizeof(*request) + info->msg_data_size) {
         gb_i2s_report_event(info, GB_I2S_EVENT_DATA_LEN);
         goto err_exit;
     }
 
+    gb_i2s_rx_reclaim(info);
+
+#ifdef CONFIG_GREYBUS_ZERO_COPY_RX
+    /* Holding on a borrowed buffer would stall the CPort, copy instead */
+    if (operation->is_rx_buffer_borrowed) {
+        hold = NULL;
+        info->stats.rx.copies++;
+    }
+#endif
+
     flags = irqsave();
 
     if (!ring_buf_is_producers(info->rx_rb)) {
+        info->stats.rx.overruns++;
         irqrestore(flags);
         gb_i2s_report_event(info, GB_I2S_EVENT_OVERRUN);
         goto err_exit; /* Discard the message */
@@ -384,10 +522,17 @@ static uint8_t gb_i2s_receiver_send_data_req_handler(
 
     /* Fill in any missing data */
     while (ring_buf_is_producers(info->rx_rb) &&
-           (le32_to_cpu(request->sample_number) > info->next_rx_sample))
-        gb_i2s_ll_tx(info, info->dummy_data);
+           (le32_to_cpu(request->sample_number) > info->next_rx_sample)) {
+        gb_i2s_ll_tx(info, info->dummy_data, NULL);
+        info->stats.rx.gap_fills++;
+    }
 
-    gb_i2s_ll_tx(info, request->data);
+    if (ring_buf_is_producers(info->rx_rb)) {
+        gb_i2s_ll_tx(info, request->data, hold);
+        info->stats.rx.messages++;
+    } else {
+        info->stats.rx.overruns++;
+    }
 
     irqrestore(flags);
 
@@ -423,9 +568,12 @@ static int gb_i2s_shutdown_receiver(struct gb_i2s_info *info)
 
     device_i2s_shutdown_transmitter(info->dev);
 
-    ring_buf_free_ring(info->rx_rb, NULL, NULL);
+    gb_i2s_rx_reclaim(info);
+    ring_buf_free_ring(info->rx_rb, gb_i2s_rb_free_rx_entry, info);
     info->rx_rb = NULL;
     info->rx_rb_count = 0;
+    free(info->rx_release);
+    info->rx_release = NULL;
     info->next_rx_sample = 0;
 
     info->flags &= ~GB_I2S_FLAG_RX_PREPARED;
@@ -481,10 +629,14 @@ static void *gb_i2s_tx_rb_thread(void *data)
             operation->cport = cple->cport;
 
             ret = gb_operation_send_request(operation, NULL, 0);
-            if (ret) /* TODO: Add report_event throttling */
+            if (ret) { /* TODO: Add report_event throttling */
+                info->stats.tx.send_errors++;
                 gb_i2s_report_event(info, GB_I2S_EVENT_FAILURE);
+            }
         }
 
+        info->stats.tx.messages++;
+
         sem_post(&info->active_cports_lock);
 
         ring_buf_reset(rb);
@@ -515,6 +667,8 @@ static void gb_i2s_ll_rx_cb(struct ring_buf *rb,
     switch (event) {
     case DEVICE_I2S_EVENT_RX_COMPLETE:
         atomic_inc(&info->tx_rb_count);
+        info->stats.tx.max_level = MAX(info->stats.tx.max_level,
+                                       atomic_get(&info->tx_rb_count));
 
         if (!(info->flags & GB_I2S_FLAG_TX_DELAYING))
             sem_post(&info->tx_rb_sem);
@@ -523,6 +677,7 @@ static void gb_i2s_ll_rx_cb(struct ring_buf *rb,
         gb_event = GB_I2S_EVENT_UNDERRUN;
         break;
     case DEVICE_I2S_EVENT_OVERRUN:
+        info->stats.tx.overruns++;
         gb_event = GB_I2S_EVENT_OVERRUN;
         break;
     case DEVICE_I2S_EVENT_CLOCKING:
@@ -617,6 +772,8 @@ static int gb_i2s_prepare_transmitter(struct gb_i2s_info *info)
     if (!info->tx_rb)
         return -ENOMEM;
 
+    memset(&info->stats.tx, 0, sizeof(info->stats.tx));
+
     /* Greybus i2s message transmitter is local i2s receiver */
     ret = device_i2s_prepare_receiver(info->dev, info->tx_rb, gb_i2s_ll_rx_cb,
                                       info);
@@ -753,6 +910,24 @@ static void gb_i2s_copy_cfg_dev2gb(const struct device_i2s_configuration
     gb_cfg->ll_data_offset = dev_cfg->ll_data_offset;
 }
 
+int gb_i2s_get_stats(unsigned int index, struct gb_i2s_stats *stats)
+{
+    struct gb_i2s_info *info;
+    irqstate_t flags;
+
+    if (index >= ARRAY_SIZE(gb_i2s_dev_info_map) ||
+        !gb_i2s_dev_info_map[index].info)
+        return -EINVAL;
+
+    info = gb_i2s_dev_info_map[index].info;
+
+    flags = irqsave();
+    memcpy(stats, &info->stats, sizeof(*stats));
+    irqrestore(flags);
+
+    return 0;
+}
+
 /* Greybus Operation Handlers */
 
 static uint8_t gb_i2s_protocol_version_req_handler(
@@ -1277,6 +1452,9 @@ static struct gb_operation_handler gb_i2s_receiver_handlers[] = {
 static struct gb_driver i2s_receiver_driver = {
     .init               = gb_i2s_receiver_init,
     .exit               = gb_i2s_receiver_exit,
+    .dedicated_worker   = true,
+    .priority           = CONFIG_GREYBUS_I2S_WORKER_PRIORITY,
+    .tx_priority        = GB_TX_PRIORITY_HIGH,
     .op_handlers        = gb_i2s_receiver_handlers,
     .op_handlers_count  = ARRAY_SIZE(gb_i2s_receiver_handlers),
 };
@@ -1304,6 +1482,9 @@ static struct gb_operation_handler gb_i2s_transmitter_handlers[] = {
 static struct gb_driver i2s_transmitter_driver = {
     .init               = gb_i2s_transmitter_init,
     .exit               = gb_i2s_transmitter_exit,
+    .dedicated_worker   = true,
+    .priority           = CONFIG_GREYBUS_I2S_WORKER_PRIORITY,
+    .tx_priority        = GB_TX_PRIORITY_HIGH,
     .op_handlers        = gb_i2s_transmitter_handlers,
     .op_handlers_count  = ARRAY_SIZE(gb_i2s_transmitter_handlers),
 };
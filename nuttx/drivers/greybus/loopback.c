@@ -43,6 +43,9 @@
 #define GB_LOOPBACK_VERSION_MAJOR 0
 #define GB_LOOPBACK_VERSION_MINOR 1
 
+/* Test traffic: drop the oldest requests rather than stall the link */
+#define GB_LOOPBACK_RX_QUEUE_DEPTH 8
+
 struct gb_loopback {
     struct list_head list;
     pthread_mutex_t lock;
@@ -415,6 +418,9 @@ static struct gb_operation_handler gb_loopback_handlers[] = {
 struct gb_driver loopback_driver = {
     .op_handlers = (struct gb_operation_handler *)gb_loopback_handlers,
     .op_handlers_count = ARRAY_SIZE(gb_loopback_handlers),
+    .tx_priority = GB_TX_PRIORITY_LOW,
+    .rx_queue_depth = GB_LOOPBACK_RX_QUEUE_DEPTH,
+    .rx_queue_policy = GB_RX_QUEUE_DROP_OLDEST,
 };
 
 void gb_loopback_register(int cport)
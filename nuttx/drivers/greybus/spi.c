@@ -192,8 +192,11 @@ static uint8_t gb_spi_protocol_transfer(struct gb_operation *operation)
     uint8_t *write_data;
     uint8_t *read_buf;
     uint32_t freq = 0;
+    uint32_t cur_freq = 0;
+    int cur_bpw = 0;
     bool selected = false;
     struct device_spi_transfer transfer;
+    struct device_spi_chain_entry *chain;
     size_t request_size = gb_operation_get_request_payload_size(operation);
     size_t expected_size;
 
@@ -221,6 +224,12 @@ static uint8_t gb_spi_protocol_transfer(struct gb_operation *operation)
         size += le32_to_cpu(desc->len);
     }
 
+    /* every transfer clocks its write data out of the request payload */
+    if (request_size - expected_size < size) {
+        gb_error("dropping short message\n");
+        return GB_OP_INVALID;
+    }
+
     response = gb_operation_alloc_response(operation, size);
     if (!response) {
         return GB_OP_NO_MEMORY;
@@ -239,21 +248,59 @@ static uint8_t gb_spi_protocol_transfer(struct gb_operation *operation)
         goto spi_err;
     }
 
+    /*
+     * Hand the whole request to the controller as one chained job when it
+     * supports it: TX is read from the request and RX lands directly in the
+     * response payload, so the controller can run it without returning to
+     * us between transfers.
+     */
+    chain = malloc(op_count * sizeof(*chain));
+    if (chain) {
+        for (i = 0; i < op_count; i++) {
+            desc = &request->transfers[i];
+            chain[i].txbuffer = write_data;
+            chain[i].rxbuffer = read_buf;
+            chain[i].nwords = le32_to_cpu(desc->len);
+            chain[i].frequency = le32_to_cpu(desc->speed_hz);
+            chain[i].bpw = desc->bits_per_word;
+            chain[i].cs_change = desc->cs_change;
+            chain[i].delay_usecs = le16_to_cpu(desc->delay_usecs);
+            write_data += chain[i].nwords;
+            read_buf += chain[i].nwords;
+        }
+
+        ret = device_spi_exchange_chain(spi_dev, request->chip_select, chain,
+                                        op_count);
+        free(chain);
+        if (ret != -ENOSYS) {
+            goto spi_err;
+        }
+
+        write_data = (uint8_t *)&request->transfers[op_count];
+        read_buf = response->data;
+    }
+
     /* parse all transfer request from AP host side */
     for (i = 0; i < op_count; i++) {
         desc = &request->transfers[i];
         freq = le32_to_cpu(desc->speed_hz);
 
         /* set SPI bits-per-word */
-        ret = device_spi_setbits(spi_dev, desc->bits_per_word);
-        if (ret) {
-            goto spi_err;
+        if (desc->bits_per_word != cur_bpw) {
+            ret = device_spi_setbits(spi_dev, desc->bits_per_word);
+            if (ret) {
+                goto spi_err;
+            }
+            cur_bpw = desc->bits_per_word;
         }
 
         /* set SPI clock */
-        ret = device_spi_setfrequency(spi_dev, &freq);
-        if (ret) {
-            goto spi_err;
+        if (!cur_freq || freq != cur_freq) {
+            cur_freq = freq;
+            ret = device_spi_setfrequency(spi_dev, &freq);
+            if (ret) {
+                goto spi_err;
+            }
         }
 
         /* assert chip-select pin */
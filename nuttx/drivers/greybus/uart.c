@@ -53,6 +53,15 @@
 #define MAX_RX_OPERATION        5
 #define MAX_RX_BUF_SIZE         256
 
+#ifdef CONFIG_GREYBUS_UART_RX_COALESCE
+#ifndef CONFIG_GREYBUS_UART_RX_COALESCE_BYTES
+#define CONFIG_GREYBUS_UART_RX_COALESCE_BYTES   128
+#endif
+#ifndef CONFIG_GREYBUS_UART_RX_IDLE_USEC
+#define CONFIG_GREYBUS_UART_RX_IDLE_USEC        10000
+#endif
+#endif
+
 /* The id of error in protocol operating. */
 #define GB_UART_EVENT_PROTOCOL_ERROR    1
 #define GB_UART_EVENT_DEVICE_ERROR      2
@@ -850,6 +859,16 @@ static int gb_uart_init(unsigned int cport)
 
     info->last_serial_state = parse_ms_ls_registers(ms, ls);
 
+#ifdef CONFIG_GREYBUS_UART_RX_COALESCE
+    ret = device_uart_set_rx_coalescing(info->dev,
+                                        CONFIG_GREYBUS_UART_RX_COALESCE_BYTES,
+                                        CONFIG_GREYBUS_UART_RX_IDLE_USEC);
+    if (ret) {
+        /* not fatal, data is then sent on every receive time out */
+        gb_info("%s(): rx coalescing not available: %d\n", __func__, ret);
+    }
+#endif
+
     ret = device_uart_attach_ms_callback(info->dev, uart_ms_callback);
     if (ret) {
         goto err_device_close;
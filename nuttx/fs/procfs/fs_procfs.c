@@ -96,6 +96,10 @@ extern const struct procfs_operations smartfs_procfsoperations;
 extern const struct procfs_operations ccm_procfsoperations;
 #endif
 
+#if defined(CONFIG_GREYBUS) && !defined(CONFIG_FS_PROCFS_EXCLUDE_GREYBUS)
+extern const struct procfs_operations greybus_procfsoperations;
+#endif
+
 /****************************************************************************
  * Private Types
  ****************************************************************************/
@@ -132,6 +136,22 @@ static const struct procfs_entry_s g_procfsentries[] =
 #if defined(CONFIG_STM32_CCM_PROCFS) && !defined(CONFIG_FS_PROCFS_EXCLUDE_CCM)
   { "ccm",             &ccm_procfsoperations },
 #endif
+
+#if defined(CONFIG_GREYBUS) && !defined(CONFIG_FS_PROCFS_EXCLUDE_GREYBUS)
+#ifdef CONFIG_GREYBUS_OPERATION_POOL
+  { "greybus/pool",     &greybus_procfsoperations },
+#endif
+  { "greybus/rxqueue",  &greybus_procfsoperations },
+#ifdef CONFIG_GREYBUS_I2S_PHY
+  { "greybus/i2s",      &greybus_procfsoperations },
+#endif
+#ifdef CONFIG_GREYBUS_HID
+  { "greybus/hid",      &greybus_procfsoperations },
+#endif
+#ifdef CONFIG_GREYBUS_STATS
+  { "greybus/stats",    &greybus_procfsoperations },
+#endif
+#endif
 };
 
 static const uint8_t g_procfsentrycount = sizeof(g_procfsentries) /
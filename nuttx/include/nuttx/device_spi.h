@@ -88,6 +88,30 @@ struct device_spi_transfer {
     int status;
 };
 
+/**
+ * One step of a chained SPI exchange
+ *
+ * A chain is executed as a single job while the bus is locked: the chip
+ * select is asserted before the first step, toggled after every step with
+ * cs_change set, and released once the last step completes.
+ */
+struct device_spi_chain_entry {
+    /** Data to be written, or NULL */
+    void *txbuffer;
+    /** Data to be read, or NULL */
+    void *rxbuffer;
+    /** Size of rx and tx buffers */
+    size_t nwords;
+    /** SPI clock for this step (Hz), 0 to keep the current one */
+    uint32_t frequency;
+    /** Number of bits per word, 0 to keep the current value */
+    uint8_t bpw;
+    /** Deselect the chip after this step */
+    bool cs_change;
+    /** Delay in microseconds after this step */
+    uint16_t delay_usecs;
+};
+
 /**
  * SPI hardware capabilities info
  */
@@ -122,6 +146,10 @@ struct device_spi_type_ops {
     int (*setbits)(struct device *dev, int nbits);
     /** Exchange a block of data from SPI */
     int (*exchange)(struct device *dev, struct device_spi_transfer *transfer);
+    /** Exchange a chain of transfers as a single job */
+    int (*exchange_chain)(struct device *dev, int devid,
+                          struct device_spi_chain_entry *chain,
+                          unsigned int count);
     /** Get SPI device driver hardware capabilities information */
     int (*getcaps)(struct device *dev, struct device_spi_caps *caps);
 };
@@ -288,6 +316,34 @@ static inline int device_spi_exchange(struct device *dev,
     return -ENOSYS;
 }
 
+/**
+ * @brief SPI chained exchange wrap function
+ *
+ * Controllers that do not implement chaining return -ENOSYS, in which case
+ * the caller is expected to fall back to select()/exchange()/deselect().
+ *
+ * @param dev pointer to structure of device data
+ * @param devid identifier of the selected device
+ * @param chain array of transfer steps
+ * @param count number of entries in chain
+ * @return 0 on success, negative errno on error
+ */
+static inline int device_spi_exchange_chain(struct device *dev, int devid,
+                                        struct device_spi_chain_entry *chain,
+                                        unsigned int count)
+{
+    DEVICE_DRIVER_ASSERT_OPS(dev);
+
+    if (!device_is_open(dev)) {
+        return -ENODEV;
+    }
+    if (DEVICE_DRIVER_GET_OPS(dev, spi)->exchange_chain) {
+        return DEVICE_DRIVER_GET_OPS(dev, spi)->exchange_chain(dev, devid,
+                                                               chain, count);
+    }
+    return -ENOSYS;
+}
+
 /**
  * @brief SPI getcaps wrap function
  *
@@ -119,6 +119,9 @@ struct device_uart_type_ops {
                                            int error));
     /** UART stop_receiver() function pointer */
     int (*stop_receiver)(struct device *dev);
+    /** UART set_rx_coalescing() function pointer */
+    int (*set_rx_coalescing)(struct device *dev, int threshold,
+                             int idle_usecs);
 };
 
 /**
@@ -432,4 +435,35 @@ static inline int device_uart_stop_receiver(struct device *dev)
     return -ENOSYS;
 }
 
+/**
+ * @brief UART set_rx_coalescing function
+ *
+ * The function configures when a non-blocking receive is reported to the
+ * caller. Instead of completing on every receive time out, the driver keeps
+ * filling the buffer until at least threshold bytes are available or the
+ * line has been idle for idle_usecs, whichever comes first. A full buffer
+ * or a line error always completes the receive. A threshold of 0 restores
+ * the default behavior.
+ *
+ * @param dev pointer to the UART device structure
+ * @param threshold number of bytes that completes a receive.
+ * @param idle_usecs idle time in microseconds that completes a receive.
+ * @return 0 for success, -errno for failures.
+ */
+static inline int device_uart_set_rx_coalescing(struct device *dev,
+                                                int threshold, int idle_usecs)
+{
+    DEVICE_DRIVER_ASSERT_OPS(dev);
+
+    if (!device_is_open(dev))
+        return -ENODEV;
+
+    if (DEVICE_DRIVER_GET_OPS(dev, uart)->set_rx_coalescing)
+        return DEVICE_DRIVER_GET_OPS(dev, uart)->set_rx_coalescing(dev,
+                                                                   threshold,
+                                                                   idle_usecs);
+
+    return -ENOSYS;
+}
+
 #endif /* __INCLUDE_NUTTX_DEVICE_UART_H */
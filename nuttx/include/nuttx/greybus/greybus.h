@@ -33,6 +33,7 @@
 
 #include <stddef.h>
 #include <pthread.h>
+#include <sys/uio.h>
 
 #include <arch/atomic.h>
 #include <nuttx/list.h>
@@ -41,6 +42,12 @@
 
 struct gb_operation;
 
+/* Default time to wait for the response to a request, in milliseconds */
+#define GB_OPERATION_TIMEOUT_DEFAULT    1000
+
+/* Maximum number of payload fragments sent along with an operation header */
+#define GB_OPERATION_MAX_IOV            8
+
 typedef void (*gb_operation_callback)(struct gb_operation *operation);
 typedef uint8_t (*gb_operation_handler_t)(struct gb_operation *operation);
 typedef void (*gb_operation_fast_handler_t)(unsigned int cport, void *data);
@@ -82,18 +89,37 @@ struct gb_operation_handler {
 #endif
 };
 
+/* Transmit class of a cport, for transports that arbitrate between cports */
+enum gb_tx_priority {
+    GB_TX_PRIORITY_NORMAL,      /* default */
+    GB_TX_PRIORITY_HIGH,        /* latency sensitive, e.g. isochronous data */
+    GB_TX_PRIORITY_LOW,         /* bulk traffic served last */
+};
+
 struct gb_transport_backend {
     void (*init)(void);
     int (*listen)(unsigned int cport);
     int (*stop_listening)(unsigned int cport);
     int (*send)(unsigned int cport, const void *buf, size_t len);
+    /* optional, send a message made of several buffers */
+    int (*send_iov)(unsigned int cport, const struct iovec *iov, int iovcnt);
+#ifdef CONFIG_GREYBUS_ZERO_COPY_RX
+    void (*rx_release)(unsigned int cport, void *buf);
+#endif
+    /* deliver messages again on a cport paused by GB_RX_PAUSED */
+    void (*rx_resume)(unsigned int cport);
+    /* optional, set the transmit class of a cport */
+    int (*set_tx_priority)(unsigned int cport, enum gb_tx_priority priority);
 };
 
 struct gb_operation {
     unsigned int cport;
     bool has_responded;
+#ifdef CONFIG_GREYBUS_ZERO_COPY_RX
+    bool is_rx_buffer_borrowed;
+#endif
     atomic_t ref_count;
-    struct timespec time;
+    uint32_t deadline;
 
     void *request_buffer;
     void *response_buffer;
@@ -103,6 +129,9 @@ struct gb_operation {
 
     void *priv_data;
     struct list_head list;
+    struct list_head hash_list;
+
+    struct gb_operation_handler *handler;
 
     struct gb_operation *response;
 
@@ -110,6 +139,16 @@ struct gb_operation {
     struct timespec send_ts;
     struct timespec recv_ts;
 #endif
+#ifdef CONFIG_GREYBUS_STATS
+    uint32_t send_usec;
+    uint32_t recv_usec;
+#endif
+};
+
+/* What to do with a message received on a cport with a full RX queue */
+enum gb_rx_queue_policy {
+    GB_RX_QUEUE_PAUSE,          /* stop receiving until the worker catches up */
+    GB_RX_QUEUE_DROP_OLDEST,    /* drop the oldest queued message */
 };
 
 struct gb_driver {
@@ -118,10 +157,39 @@ struct gb_driver {
     struct gb_operation_handler *op_handlers;
 
     size_t stack_size;
+    int priority;               /* priority of the worker, 0 for default */
+    bool dedicated_worker;      /* never share the worker of this driver */
+    enum gb_tx_priority tx_priority; /* transmit class of the cport */
+    unsigned int rx_queue_depth; /* max queued messages, 0 for default */
+    enum gb_rx_queue_policy rx_queue_policy;
     size_t op_handlers_count;
     const char *name;
+
+    /* built by the greybus core at registration, indexed by operation type */
+    struct gb_operation_handler **dispatch_table;
+    size_t dispatch_table_size;
+};
+
+/* State of the RX queue of a cport */
+struct gb_rx_queue_stats {
+    unsigned int depth;         /* maximum length, 0 for unbounded */
+    unsigned int length;
+    unsigned int max_length;
+    unsigned long dropped;
+    unsigned long paused;       /* number of times the transport got paused */
+    bool is_paused;
 };
 
+/**
+ * Get a snapshot of the RX queue of a cport
+ *
+ * @param cport CPort number
+ * @param stats Structure filled with the RX queue state
+ * @return the driver registered on the cport, or NULL if there is none
+ */
+struct gb_driver *gb_rx_queue_get_stats(unsigned int cport,
+                                        struct gb_rx_queue_stats *stats);
+
 struct gb_operation_hdr {
     __le16 size;
     __le16 id;
@@ -198,6 +266,23 @@ int gb_operation_send_request_sync(struct gb_operation *operation);
 int gb_operation_send_request(struct gb_operation *operation,
                               gb_operation_callback callback,
                               bool need_response);
+int gb_operation_send_request_sync_timeout(struct gb_operation *operation,
+                                           unsigned int timeout);
+int gb_operation_send_request_timeout(struct gb_operation *operation,
+                                      gb_operation_callback callback,
+                                      bool need_response,
+                                      unsigned int timeout);
+int gb_operation_send_request_iov(struct gb_operation *operation,
+                                  gb_operation_callback callback,
+                                  bool need_response,
+                                  const struct iovec *payload, int count);
+int gb_operation_send_request_batch(struct gb_operation **operations,
+                                    int count,
+                                    gb_operation_callback callback,
+                                    bool need_response);
+int gb_operation_send_response_iov(struct gb_operation *operation,
+                                   uint8_t result,
+                                   const struct iovec *payload, int count);
 struct gb_operation *gb_operation_create(unsigned int cport, uint8_t type,
                                          uint32_t req_size);
 void gb_operation_ref(struct gb_operation *operation);
@@ -205,6 +290,13 @@ void gb_operation_unref(struct gb_operation *operation);
 size_t gb_operation_get_request_payload_size(struct gb_operation *operation);
 uint8_t gb_operation_get_request_result(struct gb_operation *operation);
 int greybus_rx_handler(unsigned int, void*, size_t);
+/* Returned by greybus_rx_handler_nocopy() when it keeps the RX buffer */
+#define GB_RX_BUFFER_BORROWED   1
+/* Returned when the RX queue of the cport is full, see rx_resume() */
+#define GB_RX_PAUSED            2
+#ifdef CONFIG_GREYBUS_ZERO_COPY_RX
+int greybus_rx_handler_nocopy(unsigned int, void*, size_t);
+#endif
 
 void gb_control_register(int cport);
 void gb_gpio_register(int cport);
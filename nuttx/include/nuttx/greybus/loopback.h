@@ -57,6 +57,7 @@ struct gb_loopback_statistics {
 
 typedef int (*gb_loopback_cport_cb)(int, void *);
 
+void gb_loopback_register(int cport);
 int gb_loopback_get_cports(gb_loopback_cport_cb cb, void *data);
 int gb_loopback_send_req(int cport, size_t size, uint8_t type);
 int gb_loopback_get_stats(int cport, struct gb_loopback_statistics *stats);
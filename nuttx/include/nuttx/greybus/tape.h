@@ -32,26 +32,54 @@
 #define __GREYBUS_TAPE_H__
 
 #include <sys/types.h>
+#include <stdint.h>
 
 enum {
     GB_TAPE_RDONLY,
     GB_TAPE_WRONLY,
 };
 
+/* Recording flags */
+#define GB_TAPE_COMPRESS        (1 << 0)
+
+enum gb_tape_replay_mode {
+    GB_TAPE_REPLAY_MAX_SPEED,   /* inject the records back to back */
+    GB_TAPE_REPLAY_REALTIME,    /* honour the recorded inter-record delays */
+};
+
 struct gb_tape_mechanism {
     int (*open)(const char *pathname, int mode);
     void (*close)(int fd);
 
     ssize_t (*write)(int fd, const void *data, size_t size);
     ssize_t (*read)(int fd, void *data, size_t size);
+
+    /*
+     * Optional: move to an absolute offset from the start of the tape.
+     * Without it, tapes are recorded without an index and replays cannot
+     * skip ahead.
+     */
+    int (*seek)(int fd, off_t offset);
+};
+
+struct gb_tape_info {
+    uint16_t version;
+    uint16_t flags;
+    uint32_t records;           /* 0 if unknown (tape not closed) */
+    uint32_t dropped;           /* records lost while recording */
+    uint32_t duration;          /* us, 0 if unknown */
+    uint32_t index_entries;
 };
 
 int gb_tape_register_mechanism(struct gb_tape_mechanism *mechanism);
 int gb_tape_arm_semihosting_register(void);
 
-int gb_tape_communication(const char *pathname);
+int gb_tape_communication(const char *pathname, int flags);
 int gb_tape_stop(void);
 int gb_tape_replay(const char *pathname);
+int gb_tape_replay_mode(const char *pathname, enum gb_tape_replay_mode mode,
+                        uint32_t start_ms);
+int gb_tape_get_info(const char *pathname, struct gb_tape_info *info);
 
 #endif /* __GREYBUS_TAPE_H__ */
 
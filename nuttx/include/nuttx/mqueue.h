@@ -68,6 +68,8 @@ struct msgq_s
 {
   FAR struct msgq_s *flink;   /* Forward link to next message queue */
   sq_queue_t   msglist;       /* Prioritized message list */
+  dq_queue_t   waitfornotfull; /* Prioritized tasks waiting for not full */
+  dq_queue_t   waitfornotempty; /* Prioritized tasks waiting for not empty */
   int16_t      maxmsgs;       /* Maximum number of messages in the queue */
   int16_t      nmsgs;         /* Number of message in the queue */
   int16_t      nconnect;      /* Number of connections to message queue */
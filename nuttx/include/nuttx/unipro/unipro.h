@@ -32,12 +32,25 @@
 #define _UNIPRO_H_
 
 #include <stdlib.h>
+#include <sys/uio.h>
 
 #define CPORT_BUF_SIZE              (2048)
 
 typedef int (*unipro_send_completion_t)(int status, const void *buf,
                                         void *priv);
 
+/*
+ * Scheduling classes of the asynchronous TX path. Classes are served in
+ * order, and within a class CPorts are served round-robin.
+ */
+enum unipro_tx_priority {
+    UNIPRO_TX_PRIO_HIGH,
+    UNIPRO_TX_PRIO_NORMAL,
+    UNIPRO_TX_PRIO_LOW,
+
+    UNIPRO_TX_PRIO_COUNT,
+};
+
 struct unipro_driver {
     const char name[32];
     int (*rx_handler)(unsigned int cportid,  // Called in irq context
@@ -50,9 +63,12 @@ void unipro_init(void);
 int unipro_init_cport(unsigned int cportid);
 void unipro_info(void);
 int unipro_send(unsigned int cportid, const void *buf, size_t len);
+int unipro_send_iov(unsigned int cportid, const struct iovec *iov, int iovcnt);
 int unipro_send_async(unsigned int cportid, const void *buf, size_t len,
                       unipro_send_completion_t callback, void *priv);
 int unipro_unpause_rx(unsigned int cportid);
+int unipro_set_tx_priority(unsigned int cportid,
+                           enum unipro_tx_priority priority);
 
 /*
  * Lower level attribute read/write.
@@ -74,28 +74,47 @@
 #define WDOGF_ACTIVE       (1 << 0) /* Bit 0: 1=Watchdog is actively timing */
 #define WDOGF_ALLOCED      (1 << 1) /* Bit 1: 0=Pre-allocated, 1=Allocated */
 #define WDOGF_STATIC       (1 << 2) /* Bit 2: 0=[Pre-]allocated, 1=Static */
+#define WDOGF_EXPIRED      (1 << 3) /* Bit 3: 1=Expired, waiting to run */
+#define WDOGF_LEVEL_SHIFT  (4)      /* Bits 4-5: Timer wheel level */
+#define WDOGF_LEVEL_MASK   (3 << WDOGF_LEVEL_SHIFT)
 
 #define WDOG_SETACTIVE(w)  do { (w)->flags |= WDOGF_ACTIVE; } while (0)
 #define WDOG_SETALLOCED(w) do { (w)->flags |= WDOGF_ALLOCED; } while (0)
 #define WDOG_SETSTATIC(w)  do { (w)->flags |= WDOGF_STATIC; } while (0)
+#define WDOG_SETEXPIRED(w) do { (w)->flags |= WDOGF_EXPIRED; } while (0)
 
 #define WDOG_CLRACTIVE(w)  do { (w)->flags &= ~WDOGF_ACTIVE; } while (0)
 #define WDOG_CLRALLOCED(w) do { (w)->flags &= ~WDOGF_ALLOCED; } while (0)
 #define WDOG_CLRSTATIC(w)  do { (w)->flags &= ~WDOGF_STATIC; } while (0)
+#define WDOG_CLREXPIRED(w) do { (w)->flags &= ~WDOGF_EXPIRED; } while (0)
 
 #define WDOG_ISACTIVE(w)   (((w)->flags & WDOGF_ACTIVE) != 0)
 #define WDOG_ISALLOCED(w)  (((w)->flags & WDOGF_ALLOCED) != 0)
 #define WDOG_ISSTATIC(w)   (((w)->flags & WDOGF_STATIC) != 0)
+#define WDOG_ISEXPIRED(w)  (((w)->flags & WDOGF_EXPIRED) != 0)
+
+#define WDOG_SETLEVEL(w,l) \
+  do { (w)->flags = ((w)->flags & ~WDOGF_LEVEL_MASK) | \
+                    ((l) << WDOGF_LEVEL_SHIFT); } while (0)
+#define WDOG_LEVEL(w)      (((w)->flags & WDOGF_LEVEL_MASK) >> WDOGF_LEVEL_SHIFT)
 
 /* Initialization of statically allocated timers ****************************/
 
 #define wd_static(w) \
   do { (w)->next = NULL; (w)->flags = WDOGF_STATIC; } while (0)
 
+#ifdef CONFIG_WDOG_TIMER_WHEEL
+#  define WDOG_LINKS_INITIALIZER NULL, NULL
+#else
+#  define WDOG_LINKS_INITIALIZER NULL
+#endif
+
 #ifdef CONFIG_PIC
-#  define WDOG_INITIAILIZER { NULL, NULL, NULL, 0, WDOGF_STATIC, 0 }
+#  define WDOG_INITIAILIZER \
+  { WDOG_LINKS_INITIALIZER, NULL, NULL, 0, WDOGF_STATIC, 0 }
 #else
-#  define WDOG_INITIAILIZER { NULL, NULL, 0, WDOGF_STATIC, 0 }
+#  define WDOG_INITIAILIZER \
+  { WDOG_LINKS_INITIALIZER, NULL, 0, WDOGF_STATIC, 0 }
 #endif
 
 /****************************************************************************
@@ -131,11 +150,14 @@ typedef CODE void (*wdentry_t)(int argc, uint32_t arg1, ...);
 struct wdog_s
 {
   FAR struct wdog_s *next;       /* Support for singly linked lists. */
+#ifdef CONFIG_WDOG_TIMER_WHEEL
+  FAR struct wdog_s *prev;       /* Doubly linked timer wheel slot */
+#endif
   wdentry_t          func;       /* Function to execute when delay expires */
 #ifdef CONFIG_PIC
   FAR void          *picbase;    /* PIC base address */
 #endif
-  int                lag;        /* Timer associated with the delay */
+  int                lag;        /* Delay, or expiration tick in the wheel */
   uint8_t            flags;      /* See WDOGF_* definitions above */
   uint8_t            argc;       /* The number of parameters to pass */
   uint32_t           parm[CONFIG_MAX_WDOGPARMS];
@@ -44,6 +44,7 @@
 
 #include <sys/types.h>
 #include <stdint.h>
+#include <stdbool.h>
 #include <signal.h>
 #include <queue.h>
 
@@ -67,12 +68,14 @@
  *   in order to build the high priority work queue.
  * CONFIG_SCHED_WORKPRIORITY - The execution priority of the worker
  *   thread.  Default: 192
- * CONFIG_SCHED_WORKPERIOD - How often the worker thread checks for
- *   work in units of microseconds.  Default: 50*1000 (50 MS).
+ * CONFIG_SCHED_HPNTHREADS - The number of worker threads that serve the
+ *   high priority work queue.  Default: 1
  * CONFIG_SCHED_WORKSTACKSIZE - The stack size allocated for the worker
  *   thread.  Default: CONFIG_IDLETHREAD_STACKSIZE.
  * CONFIG_SIG_SIGWORK - The signal number that will be used to wake-up
  *   the worker thread.  Default: 17
+ * CONFIG_SCHED_WORKSTATS - Keep execution time and queue latency
+ *   statistics for each work queue.  See work_stats().
  *
  * CONFIG_SCHED_LPWORK. If CONFIG_SCHED_WORKQUEUE is defined, then a single
  *   work queue is created by default.  If CONFIG_SCHED_LPWORK is also defined
@@ -81,8 +84,8 @@
  *   (such as file system clean-up operations)
  * CONFIG_SCHED_LPWORKPRIORITY - The execution priority of the lower priority
  *   worker thread.  Default: 50
- * CONFIG_SCHED_LPWORKPERIOD - How often the lower priority worker thread
- *  checks for work in units of microseconds.  Default: 50*1000 (50 MS).
+ * CONFIG_SCHED_LPNTHREADS - The number of worker threads that serve the
+ *   lower priority work queue.  Default: 1
  * CONFIG_SCHED_LPWORKSTACKSIZE - The stack size allocated for the lower
  *   priority worker thread.  Default: CONFIG_IDLETHREAD_STACKSIZE.
  */
@@ -159,8 +162,8 @@
 #    define CONFIG_SCHED_WORKPRIORITY 192
 #  endif
 
-#  ifndef CONFIG_SCHED_WORKPERIOD
-#    define CONFIG_SCHED_WORKPERIOD (50*1000) /* 50 milliseconds */
+#  ifndef CONFIG_SCHED_HPNTHREADS
+#    define CONFIG_SCHED_HPNTHREADS 1
 #  endif
 
 #  ifndef CONFIG_SCHED_WORKSTACKSIZE
@@ -175,8 +178,8 @@
 #    define CONFIG_SCHED_LPWORKPRIORITY 50
 #  endif
 
-#  ifndef CONFIG_SCHED_LPWORKPERIOD
-#    define CONFIG_SCHED_LPWORKPERIOD (50*1000) /* 50 milliseconds */
+#  ifndef CONFIG_SCHED_LPNTHREADS
+#    define CONFIG_SCHED_LPNTHREADS 1
 #  endif
 
 #  ifndef CONFIG_SCHED_LPWORKSTACKSIZE
@@ -202,10 +205,6 @@
 #    define CONFIG_SCHED_USRWORKPRIORITY 50
 #  endif
 
-#  ifndef CONFIG_SCHED_USRWORKPERIOD
-#    define CONFIG_SCHED_USRWORKPERIOD (50*1000) /* 50 milliseconds */
-#  endif
-
 #  ifndef CONFIG_SCHED_USRWORKSTACKSIZE
 #    define CONFIG_SCHED_USRWORKSTACKSIZE CONFIG_IDLETHREAD_STACKSIZE
 #  endif
@@ -265,12 +264,52 @@
 
 #endif /* CONFIG_BUILD_PROTECTED && !__KERNEL__ */
 
+/* The largest number of worker threads serving any one work queue.  The
+ * user-space work queue only ever has one.
+ */
+
+#if defined(CONFIG_SCHED_LPWORK) && \
+    CONFIG_SCHED_LPNTHREADS > CONFIG_SCHED_HPNTHREADS
+#  define WORK_MAXTHREADS CONFIG_SCHED_LPNTHREADS
+#elif defined(CONFIG_SCHED_HPWORK)
+#  define WORK_MAXTHREADS CONFIG_SCHED_HPNTHREADS
+#else
+#  define WORK_MAXTHREADS 1
+#endif
+
 /****************************************************************************
  * Public Types
  ****************************************************************************/
 
 #ifndef __ASSEMBLY__
 
+/* Defines the work callback */
+
+typedef void (*worker_t)(FAR void *arg);
+
+/* Statistics gathered on one work queue with CONFIG_SCHED_WORKSTATS.  The
+ * latency of a work item is the time from when it became due until a
+ * worker thread started it.  All times are in microseconds.
+ */
+
+struct work_stats_s
+{
+  uint32_t count;           /* Number of work items performed */
+  uint32_t latency_sum;     /* Total latency of those items */
+  uint32_t latency_max;     /* Longest latency */
+  uint32_t exec_sum;        /* Total time spent in the callbacks */
+  uint32_t exec_max;        /* Longest time spent in one callback */
+  worker_t exec_maxworker;  /* The callback that took exec_max */
+};
+
+/* This structure describes one of the threads serving a work queue */
+
+struct kworker_s
+{
+  pid_t         pid;     /* The task ID of the worker thread */
+  volatile bool busy;    /* False while the thread waits for work */
+};
+
 /* This structure defines the state on one work queue.  This structure is
  * used internally by the OS and worker queue logic and should not be
  * accessed by application logic.
@@ -278,14 +317,15 @@
 
 struct wqueue_s
 {
-  pid_t             pid; /* The task ID of the worker thread */
-  struct dq_queue_s q;   /* The queue of pending work */
+  struct dq_queue_s q;   /* The queue of pending work, sorted by deadline */
+  uint8_t nthreads;      /* The number of worker threads */
+  volatile bool pending; /* Signalled while all of the threads were busy */
+  struct kworker_s worker[WORK_MAXTHREADS];
+#ifdef CONFIG_SCHED_WORKSTATS
+  struct work_stats_s stats;
+#endif
 };
 
-/* Defines the work callback */
-
-typedef void (*worker_t)(FAR void *arg);
-
 /* Defines one entry in the work queue.  The user only needs this structure
  * in order to declare instances of the work structure.  Handling of all
  * fields is performed by the work APIs
@@ -298,6 +338,9 @@ struct work_s
   FAR void *arg;         /* Callback argument */
   uint32_t  qtime;       /* Time work queued */
   uint32_t  delay;       /* Delay until work performed */
+#ifdef CONFIG_SCHED_WORKSTATS
+  uint32_t  qusec;       /* Time work queued, in microseconds */
+#endif
 };
 
 /****************************************************************************
@@ -347,7 +390,7 @@ EXTERN struct wqueue_s g_work[NWORKERS];
  *
  * Description:
  *   These are the worker threads that performs actions placed on the work
- *   lists.
+ *   lists.  The kernel work queues may each be served by several of them.
  *
  *   work_hpthread and work_lpthread:  These are the kernel mode work queues
  *     (also build in the flat build).  One of these threads also performs
@@ -456,9 +499,9 @@ int work_cancel(int qid, FAR struct work_s *work);
  * Name: work_signal
  *
  * Description:
- *   Signal the worker thread to process the work queue now.  This function
- *   is used internally by the work logic but could also be used by the
- *   user to force an immediate re-assessment of pending work.
+ *   Signal an idle worker thread to process the work queue now.  This
+ *   function is used internally by the work logic but could also be used
+ *   by the user to force an immediate re-assessment of pending work.
  *
  * Input parameters:
  *   qid    - The work queue ID
@@ -470,6 +513,26 @@ int work_cancel(int qid, FAR struct work_s *work);
 
 int work_signal(int qid);
 
+/****************************************************************************
+ * Name: work_stats
+ *
+ * Description:
+ *   Return the statistics gathered on a work queue since the previous call
+ *   and start gathering them anew.
+ *
+ * Input parameters:
+ *   qid    - The work queue ID
+ *   stats  - The location to return the statistics
+ *
+ * Returned Value:
+ *   Zero on success, a negated errno on failure
+ *
+ ****************************************************************************/
+
+#ifdef CONFIG_SCHED_WORKSTATS
+int work_stats(int qid, FAR struct work_stats_s *stats);
+#endif
+
 /****************************************************************************
  * Name: work_available
  *
@@ -44,6 +44,7 @@
 
 #include <stdint.h>
 #include <limits.h>
+#include <queue.h>
 
 #ifdef __cplusplus
 #define EXTERN extern "C"
@@ -98,6 +99,12 @@ struct sem_s
   struct semholder_s holder;     /* Single holder */
 # endif
 #endif
+
+  /* Tasks blocked on the semaphore, highest priority first.  Kept last so
+   * that an all-zero semaphore has an empty list.
+   */
+
+  dq_queue_t waitlist;
 };
 
 typedef struct sem_s sem_t;
@@ -106,12 +113,14 @@ typedef struct sem_s sem_t;
 
 #ifdef CONFIG_PRIORITY_INHERITANCE
 # if CONFIG_SEM_PREALLOCHOLDERS > 0
-#  define SEM_INITIALIZER(c) {(c), NULL}  /* semcount, hhead */
+#  define SEM_INITIALIZER(c) \
+     {(c), NULL, {NULL, NULL}}  /* semcount, hhead, waitlist */
 # else
-#  define SEM_INITIALIZER(c) {(c), SEMHOLDER_INITIALIZER} /* semcount, holder */
+#  define SEM_INITIALIZER(c) \
+     {(c), SEMHOLDER_INITIALIZER, {NULL, NULL}} /* semcount, holder, waitlist */
 # endif
 #else
-#  define SEM_INITIALIZER(c) {(c)} /* semcount */
+#  define SEM_INITIALIZER(c) {(c), {NULL, NULL}} /* semcount, waitlist */
 #endif
 
 /****************************************************************************
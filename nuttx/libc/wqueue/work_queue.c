@@ -47,6 +47,7 @@
 
 #include <nuttx/arch.h>
 #include <nuttx/clock.h>
+#include <nuttx/hires_tmr.h>
 #include <nuttx/wqueue.h>
 
 #ifdef CONFIG_SCHED_WORKQUEUE
@@ -71,6 +72,40 @@
  * Private Functions
  ****************************************************************************/
 
+/****************************************************************************
+ * Name: work_insert
+ *
+ * Description:
+ *   Add work to the queue, behind all of the work that is due at the same
+ *   time or earlier.  Most work is due immediately, so the search starts
+ *   from the tail.
+ *
+ * Assumptions:
+ *   Interrupts are disabled.
+ *
+ ****************************************************************************/
+
+static void work_insert(FAR struct wqueue_s *wqueue, FAR struct work_s *work)
+{
+  FAR struct work_s *prev = (FAR struct work_s *)wqueue->q.tail;
+  uint32_t deadline = work->qtime + work->delay;
+
+  while (prev && (int32_t)(prev->qtime + prev->delay - deadline) > 0)
+    {
+      prev = (FAR struct work_s *)prev->dq.blink;
+    }
+
+  if (prev)
+    {
+      dq_addafter((FAR dq_entry_t *)prev, (FAR dq_entry_t *)work,
+                  &wqueue->q);
+    }
+  else
+    {
+      dq_addfirst((FAR dq_entry_t *)work, &wqueue->q);
+    }
+}
+
 /****************************************************************************
  * Public Functions
  ****************************************************************************/
@@ -82,6 +117,9 @@
  *   Queue work to be performed at a later time.  All queued work will be
  *   performed on the worker thread of of execution (not the caller's).
  *
+ *   Pending work is kept sorted by the time it is due, so that the worker
+ *   threads only need to wake up when the earliest work is due.
+ *
  *   The work structure is allocated by caller, but completely managed by
  *   the work queue logic.  The caller should never modify the contents of
  *   the work queue structure; the caller should not call work_queue()
@@ -125,9 +163,21 @@ int work_queue(int qid, FAR struct work_s *work, worker_t worker,
 
   flags        = irqsave();
   work->qtime  = clock_systimer(); /* Time work queued */
+#ifdef CONFIG_SCHED_WORKSTATS
+  work->qusec  = hrt_getusec();
+#endif
+
+  work_insert(wqueue, work);
+
+  /* Wake up a worker thread if this work is due before any other.
+   * Otherwise, the worker threads are already awake or set to wake up
+   * in time for earlier work and will get to this work after it.
+   */
 
-  dq_addlast((FAR dq_entry_t *)work, &wqueue->q);
-  kill(wqueue->pid, SIGWORK);      /* Wake up the worker thread */
+  if ((FAR struct work_s *)wqueue->q.head == work)
+    {
+      work_signal(qid);
+    }
 
   irqrestore(flags);
   return OK;
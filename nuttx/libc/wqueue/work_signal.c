@@ -42,6 +42,7 @@
 #include <signal.h>
 #include <assert.h>
 
+#include <nuttx/arch.h>
 #include <nuttx/wqueue.h>
 
 #ifdef CONFIG_SCHED_WORKQUEUE
@@ -73,9 +74,12 @@
  * Name: work_signal
  *
  * Description:
- *   Signal the worker thread to process the work queue now.  This function
- *   is used internally by the work logic but could also be used by the
- *   user to force an immediate re-assessment of pending work.
+ *   Signal an idle worker thread to process the work queue now.  This
+ *   function is used internally by the work logic but could also be used
+ *   by the user to force an immediate re-assessment of pending work.
+ *
+ *   If all of the worker threads are busy, none is signalled:  each of them
+ *   looks at the work queue again when it is done with its current work.
  *
  * Input parameters:
  *   qid    - The work queue ID
@@ -87,8 +91,38 @@
 
 int work_signal(int qid)
 {
+  FAR struct wqueue_s *wqueue = &g_work[qid];
+  irqstate_t flags;
+  int ret = OK;
+  int wndx;
+
   DEBUGASSERT((unsigned)qid < NWORKERS);
-  return kill(g_work[qid].pid, SIGWORK);
+
+  /* The lowest numbered idle thread is the one that waits for delayed
+   * work, so it has to be the one to look at the work queue again.  Mark
+   * it busy so that the next signal goes to another thread.  If all of
+   * the threads are busy, the signal is recorded and the first thread to
+   * finish its work will look again instead of going to sleep.
+   */
+
+  flags = irqsave();
+  for (wndx = 0; wndx < wqueue->nthreads; wndx++)
+    {
+      if (!wqueue->worker[wndx].busy)
+        {
+          wqueue->worker[wndx].busy = true;
+          ret = kill(wqueue->worker[wndx].pid, SIGWORK);
+          break;
+        }
+    }
+
+  if (wndx == wqueue->nthreads)
+    {
+      wqueue->pending = true;
+    }
+
+  irqrestore(flags);
+  return ret;
 }
 
 #endif /* CONFIG_SCHED_WORKQUEUE */
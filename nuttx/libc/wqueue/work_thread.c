@@ -40,6 +40,7 @@
 #include <nuttx/config.h>
 
 #include <stdint.h>
+#include <stdbool.h>
 #include <unistd.h>
 #include <queue.h>
 #include <assert.h>
@@ -49,6 +50,7 @@
 #include <nuttx/arch.h>
 #include <nuttx/wqueue.h>
 #include <nuttx/clock.h>
+#include <nuttx/hires_tmr.h>
 #include <nuttx/kmalloc.h>
 
 #ifdef CONFIG_SCHED_WORKQUEUE
@@ -97,6 +99,41 @@ struct wqueue_s g_work[NWORKERS];
  * Private Functions
  ****************************************************************************/
 
+/****************************************************************************
+ * Name: work_timekeeper
+ *
+ * Description:
+ *   Check if a worker thread that is about to wait for work should wake up
+ *   when the next delayed work is due.  That is left to the lowest
+ *   numbered idle thread so that the others can sleep until signalled.
+ *
+ * Input parameters:
+ *   wqueue - Describes the work queue
+ *   wndx   - The index of the worker thread
+ *
+ * Returned Value:
+ *   True if the worker thread has to wait for delayed work.
+ *
+ * Assumptions:
+ *   Interrupts are disabled.
+ *
+ ****************************************************************************/
+
+static bool work_timekeeper(FAR struct wqueue_s *wqueue, int wndx)
+{
+  int i;
+
+  for (i = 0; i < wndx; i++)
+    {
+      if (!wqueue->worker[i].busy)
+        {
+          return false;
+        }
+    }
+
+  return true;
+}
+
 /****************************************************************************
  * Name: work_process
  *
@@ -105,28 +142,32 @@ struct wqueue_s g_work[NWORKERS];
  *
  * Input parameters:
  *   wqueue - Describes the work queue to be processed
+ *   wndx   - The index of the calling worker thread
  *
  * Returned Value:
  *   None
  *
  ****************************************************************************/
 
-static void work_process(FAR struct wqueue_s *wqueue)
+static void work_process(FAR struct wqueue_s *wqueue, int wndx)
 {
   volatile FAR struct work_s *work;
   worker_t  worker;
   irqstate_t flags;
   FAR void *arg;
-  uint32_t elapsed;
-  uint32_t remaining;
-  uint32_t next;
+  uint32_t elapsed = 0;
+#ifdef CONFIG_SCHED_WORKSTATS
+  uint32_t start;
+  uint32_t latency;
+  uint32_t exec;
+#endif
 
   /* Then process queued work.  We need to keep interrupts disabled while
    * we process items in the work list.
    */
 
-  next  = CONFIG_SCHED_WORKPERIOD / USEC_PER_TICK;
   flags = irqsave();
+  wqueue->worker[wndx].busy = true;
   work  = (FAR struct work_s *)wqueue->q.head;
   while (work)
     {
@@ -137,84 +178,156 @@ static void work_process(FAR struct wqueue_s *wqueue)
        */
 
       elapsed = clock_systimer() - work->qtime;
-      if (elapsed >= work->delay)
+      if (elapsed < work->delay)
         {
-          /* Remove the ready-to-execute work from the list */
+          /* No.. The work queue is sorted by deadline, so none of the
+           * work behind this one is ready either.
+           */
 
-          (void)dq_rem((struct dq_entry_s *)work, &wqueue->q);
+          break;
+        }
 
-          /* Extract the work description from the entry (in case the work
-           * instance by the re-used after it has been de-queued).
-           */
+      /* Remove the ready-to-execute work from the list */
 
-          worker = work->worker;
+      (void)dq_rem((struct dq_entry_s *)work, &wqueue->q);
 
-          /* Check for a race condition where the work may be nullified
-           * before it is removed from the queue.
-           */
+      /* Extract the work description from the entry (in case the work
+       * instance by the re-used after it has been de-queued).
+       */
 
-          if (worker != NULL)
-            {
-              /* Extract the work argument (before re-enabling interrupts) */
+      worker = work->worker;
 
-              arg = work->arg;
+      /* Check for a race condition where the work may be nullified
+       * before it is removed from the queue.
+       */
 
-              /* Mark the work as no longer being queued */
+      if (worker != NULL)
+        {
+          /* Extract the work argument (before re-enabling interrupts) */
 
-              work->worker = NULL;
+          arg = work->arg;
 
-              /* Do the work.  Re-enable interrupts while the work is being
-               * performed... we don't have any idea how long that will take!
-               */
+#ifdef CONFIG_SCHED_WORKSTATS
+          start   = hrt_getusec();
+          latency = start - work->qusec - work->delay * USEC_PER_TICK;
+#endif
 
-              irqrestore(flags);
-              worker(arg);
+          /* Mark the work as no longer being queued */
 
-              /* Now, unfortunately, since we re-enabled interrupts we don't
-               * know the state of the work list and we will have to start
-               * back at the head of the list.
-               */
+          work->worker = NULL;
 
-              flags = irqsave();
-              work  = (FAR struct work_s *)wqueue->q.head;
-            }
-          else
-            {
-              /* Cancelled.. Just move to the next work in the list with
-               * interrupts still disabled.
-               */
+          /* If more work is left, let an idle worker thread take it on
+           * (or wait for it) while we are busy with this one.
+           */
 
-              work = (FAR struct work_s *)work->dq.flink;
+          if (wqueue->q.head != NULL)
+            {
+              (void)work_signal(wqueue - g_work);
             }
-        }
-      else
-        {
-          /* This one is not ready.. will it be ready before the next
-           * scheduled wakeup interval?
+
+          /* Do the work.  Re-enable interrupts while the work is being
+           * performed... we don't have any idea how long that will take!
            */
 
-          remaining = elapsed - work->delay;
-          if (remaining < next)
-            {
-              /* Yes.. Then schedule to wake up when the work is ready */
+          irqrestore(flags);
+          worker(arg);
+
+          flags = irqsave();
 
-              next = remaining;
+#ifdef CONFIG_SCHED_WORKSTATS
+          /* The deadline is only known to the tick, so work that started
+           * early within its last tick counts as having no latency.
+           */
+
+          exec = hrt_getusec() - start;
+          if ((int32_t)latency < 0)
+            {
+              latency = 0;
             }
 
-          /* Then try the next in the list. */
+          wqueue->stats.count++;
+          wqueue->stats.latency_sum += latency;
+          if (latency > wqueue->stats.latency_max)
+            {
+              wqueue->stats.latency_max = latency;
+            }
 
-          work = (FAR struct work_s *)work->dq.flink;
+          wqueue->stats.exec_sum += exec;
+          if (exec > wqueue->stats.exec_max)
+            {
+              wqueue->stats.exec_max       = exec;
+              wqueue->stats.exec_maxworker = worker;
+            }
+#endif
         }
+
+      /* Now, unfortunately, since we re-enabled interrupts we don't know
+       * the state of the work list and we will have to start back at the
+       * head of the list.
+       */
+
+      work = (FAR struct work_s *)wqueue->q.head;
+    }
+
+  /* work_signal() found all of the threads busy.  The caller may have
+   * deferred frees to collect, so go around again instead of sleeping
+   * through the signal.
+   */
+
+  if (wqueue->pending)
+    {
+      wqueue->pending = false;
+      irqrestore(flags);
+      return;
     }
 
-  /* Wait awhile to check the work list.  We will wait here until either
-   * the time elapses or until we are awakened by a signal.
+  /* Wait until the next work is due or until we are awakened by a signal.
+   * Without any delayed work to wait for, there is no need to wake up
+   * until more work is queued.
    */
 
-  usleep(next * USEC_PER_TICK);
+  wqueue->worker[wndx].busy = false;
+  if (work && work_timekeeper(wqueue, wndx))
+    {
+      usleep((work->delay - elapsed) * USEC_PER_TICK);
+    }
+  else
+    {
+      pause();
+    }
+
+  wqueue->worker[wndx].busy = true;
   irqrestore(flags);
 }
 
+/****************************************************************************
+ * Name: work_index
+ *
+ * Description:
+ *   Find which of the threads serving a kernel work queue the caller is.
+ *   The threads are all created before any of them runs.
+ *
+ ****************************************************************************/
+
+#ifdef CONFIG_SCHED_HPWORK
+static int work_index(FAR struct wqueue_s *wqueue)
+{
+  pid_t pid = getpid();
+  int wndx;
+
+  for (wndx = 0; wndx < wqueue->nthreads; wndx++)
+    {
+      if (wqueue->worker[wndx].pid == pid)
+        {
+          return wndx;
+        }
+    }
+
+  DEBUGPANIC();
+  return 0;
+}
+#endif
+
 /****************************************************************************
  * Public Functions
  ****************************************************************************/
@@ -226,9 +339,10 @@ static void work_process(FAR struct wqueue_s *wqueue)
  *   lists.
  *
  *   work_hpthread and work_lpthread:  These are the kernel mode work queues
- *     (also build in the flat build).  One of these threads also performs
- *     periodic garbage collection (that is otherwise performed by the idle
- *     thread if CONFIG_SCHED_WORKQUEUE is not defined).
+ *     (also build in the flat build).  Each of them may be served by a pool
+ *     of threads.  One of the queues also performs garbage collection
+ *     (that is otherwise performed by the idle thread if
+ *     CONFIG_SCHED_WORKQUEUE is not defined).
  *
  *     These worker threads are started by the OS during normal bringup.
  *
@@ -253,6 +367,8 @@ static void work_process(FAR struct wqueue_s *wqueue)
 
 int work_hpthread(int argc, char *argv[])
 {
+  int wndx = work_index(&g_work[HPWORK]);
+
   /* Loop forever */
 
   for (;;)
@@ -272,7 +388,7 @@ int work_hpthread(int argc, char *argv[])
        * we process items in the work list.
        */
 
-      work_process(&g_work[HPWORK]);
+      work_process(&g_work[HPWORK], wndx);
     }
 
   return OK; /* To keep some compilers happy */
@@ -282,6 +398,8 @@ int work_hpthread(int argc, char *argv[])
 
 int work_lpthread(int argc, char *argv[])
 {
+  int wndx = work_index(&g_work[LPWORK]);
+
   /* Loop forever */
 
   for (;;)
@@ -299,7 +417,7 @@ int work_lpthread(int argc, char *argv[])
        * we process items in the work list.
        */
 
-      work_process(&g_work[LPWORK]);
+      work_process(&g_work[LPWORK], wndx);
     }
 
   return OK; /* To keep some compilers happy */
@@ -320,7 +438,7 @@ int work_usrthread(int argc, char *argv[])
        * we process items in the work list.
        */
 
-      work_process(&g_work[USRWORK]);
+      work_process(&g_work[USRWORK], 0);
     }
 
   return OK; /* To keep some compilers happy */
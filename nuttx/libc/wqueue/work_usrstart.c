@@ -89,18 +89,19 @@
 
 int work_usrstart(void)
 {
+  pid_t pid;
+
   /* Start a user-mode worker thread for use by applications. */
 
   svdbg("Starting user-mode worker thread\n");
 
-  g_usrwork[USRWORK].pid = task_create("usrwork",
-                                       CONFIG_SCHED_USRWORKPRIORITY,
-                                       CONFIG_SCHED_USRWORKSTACKSIZE,
-                                       (main_t)work_usrthread,
-                                       (FAR char * const *)NULL);
+  pid = task_create("usrwork", CONFIG_SCHED_USRWORKPRIORITY,
+                    CONFIG_SCHED_USRWORKSTACKSIZE,
+                    (main_t)work_usrthread,
+                    (FAR char * const *)NULL);
 
-  DEBUGASSERT(g_usrwork[USRWORK].pid > 0);
-  if (g_usrwork[USRWORK].pid < 0)
+  DEBUGASSERT(pid > 0);
+  if (pid < 0)
     {
       int errcode = errno;
       DEBUGASSERT(errcode > 0);
@@ -109,7 +110,9 @@ int work_usrstart(void)
       return -errcode;
     }
 
-  return g_usrwork[USRWORK].pid;
+  g_usrwork[USRWORK].worker[0].pid = pid;
+  g_usrwork[USRWORK].nthreads      = 1;
+  return pid;
 }
 
 #endif /* CONFIG_BUILD_PROTECTED && !__KERNEL__ CONFIG_SCHED_WORKQUEUE && CONFIG_SCHED_USRWORK */
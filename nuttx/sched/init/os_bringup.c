@@ -193,6 +193,50 @@ static inline void os_pgworker(void)
 
 #endif /* CONFIG_PAGING */
 
+/****************************************************************************
+ * Name: os_workers
+ *
+ * Description:
+ *   Start the pool of worker threads that service one kernel work queue.
+ *   The scheduler is locked so that all of them are recorded before any of
+ *   them runs and looks itself up.
+ *
+ * Input Parameters:
+ *   qid       - The work queue ID
+ *   name      - The name of the worker threads
+ *   priority  - The priority of the worker threads
+ *   stacksize - The stack size of each worker thread
+ *   entry     - The worker thread entry point
+ *   nthreads  - The number of worker threads
+ *
+ * Returned Value:
+ *   None
+ *
+ ****************************************************************************/
+
+#if defined(CONFIG_SCHED_WORKQUEUE) && defined(CONFIG_SCHED_HPWORK)
+static inline void os_workers(int qid, FAR const char *name, int priority,
+                              int stacksize, main_t entry, int nthreads)
+{
+  FAR struct wqueue_s *wqueue = &g_work[qid];
+  int wndx;
+
+  DEBUGASSERT(nthreads > 0 && nthreads <= WORK_MAXTHREADS);
+
+  sched_lock();
+  for (wndx = 0; wndx < nthreads; wndx++)
+    {
+      wqueue->worker[wndx].pid = kernel_thread(name, priority, stacksize,
+                                               entry,
+                                               (FAR char * const *)NULL);
+      DEBUGASSERT(wqueue->worker[wndx].pid > 0);
+    }
+
+  wqueue->nthreads = nthreads;
+  sched_unlock();
+}
+#endif
+
 /****************************************************************************
  * Name: os_workqueues
  *
@@ -216,16 +260,14 @@ static inline void os_workqueues(void)
 
 #ifdef CONFIG_SCHED_HPWORK
 #ifdef CONFIG_SCHED_LPWORK
-  svdbg("Starting high-priority kernel worker thread\n");
+  svdbg("Starting high-priority kernel worker threads\n");
 #else
-  svdbg("Starting kernel worker thread\n");
+  svdbg("Starting kernel worker threads\n");
 #endif
 
-  g_work[HPWORK].pid = kernel_thread(HPWORKNAME, CONFIG_SCHED_WORKPRIORITY,
-                                     CONFIG_SCHED_WORKSTACKSIZE,
-                                     (main_t)work_hpthread,
-                                     (FAR char * const *)NULL);
-  DEBUGASSERT(g_work[HPWORK].pid > 0);
+  os_workers(HPWORK, HPWORKNAME, CONFIG_SCHED_WORKPRIORITY,
+             CONFIG_SCHED_WORKSTACKSIZE, (main_t)work_hpthread,
+             CONFIG_SCHED_HPNTHREADS);
 
   /* Start a lower priority worker thread for other, non-critical continuation
    * tasks
@@ -233,13 +275,11 @@ static inline void os_workqueues(void)
 
 #ifdef CONFIG_SCHED_LPWORK
 
-  svdbg("Starting low-priority kernel worker thread\n");
+  svdbg("Starting low-priority kernel worker threads\n");
 
-  g_work[LPWORK].pid = kernel_thread(LPWORKNAME, CONFIG_SCHED_LPWORKPRIORITY,
-                                     CONFIG_SCHED_LPWORKSTACKSIZE,
-                                     (main_t)work_lpthread,
-                                     (FAR char * const *)NULL);
-  DEBUGASSERT(g_work[LPWORK].pid > 0);
+  os_workers(LPWORK, LPWORKNAME, CONFIG_SCHED_LPWORKPRIORITY,
+             CONFIG_SCHED_LPWORKSTACKSIZE, (main_t)work_lpthread,
+             CONFIG_SCHED_LPNTHREADS);
 
 #endif /* CONFIG_SCHED_LPWORK */
 #endif /* CONFIG_SCHED_HPWORK */
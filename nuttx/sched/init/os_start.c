@@ -88,8 +88,13 @@
  * and by a series of task lists.  All of these tasks lists are declared
  * below. Although it is not always necessary, most of these lists are
  * prioritized so that common list handling logic can be used (only the
- * g_readytorun, the g_pendingtasks, and the g_waitingforsemaphore lists need
- * to be prioritized).
+ * g_readytorun, the g_pendingtasks, and the semaphore and message queue
+ * wait lists need to be prioritized).
+ *
+ * Tasks waiting for a semaphore or a message queue are not kept in a global
+ * list: each semaphore and message queue holds its own list of waiters so
+ * that waking one does not have to search every blocked task.  Use
+ * sched_tasklist() to find the list that holds a given TCB.
  */
 
 /* This is the list of all tasks that are ready to run.  The head of this
@@ -107,32 +112,12 @@ volatile dq_queue_t g_readytorun;
 
 volatile dq_queue_t g_pendingtasks;
 
-/* This is the list of all tasks that are blocked waiting for a semaphore */
-
-volatile dq_queue_t g_waitingforsemaphore;
-
 /* This is the list of all tasks that are blocked waiting for a signal */
 
 #ifndef CONFIG_DISABLE_SIGNALS
 volatile dq_queue_t g_waitingforsignal;
 #endif
 
-/* This is the list of all tasks that are blocked waiting for a message
- * queue to become non-empty.
- */
-
-#ifndef CONFIG_DISABLE_MQUEUE
-volatile dq_queue_t g_waitingformqnotempty;
-#endif
-
-/* This is the list of all tasks that are blocked waiting for a message
- * queue to become non-full.
- */
-
-#ifndef CONFIG_DISABLE_MQUEUE
-volatile dq_queue_t g_waitingformqnotfull;
-#endif
-
 /* This is the list of all tasks that are blocking waiting for a page fill */
 
 #ifdef CONFIG_PAGING
@@ -188,15 +173,15 @@ const struct tasklist_s g_tasklisttable[NUM_TASK_STATES] =
   { &g_readytorun,           true  },  /* TSTATE_TASK_READYTORUN */
   { &g_readytorun,           true  },  /* TSTATE_TASK_RUNNING */
   { &g_inactivetasks,        false },  /* TSTATE_TASK_INACTIVE */
-  { &g_waitingforsemaphore,  true  }   /* TSTATE_WAIT_SEM */
+  { NULL,                    true  }   /* TSTATE_WAIT_SEM (per semaphore) */
 #ifndef CONFIG_DISABLE_SIGNALS
   ,
   { &g_waitingforsignal,     false }  /* TSTATE_WAIT_SIG */
 #endif
 #ifndef CONFIG_DISABLE_MQUEUE
   ,
-  { &g_waitingformqnotempty, true  },  /* TSTATE_WAIT_MQNOTEMPTY */
-  { &g_waitingformqnotfull,  true  }   /* TSTATE_WAIT_MQNOTFULL */
+  { NULL,                    true  },  /* TSTATE_WAIT_MQNOTEMPTY (per queue) */
+  { NULL,                    true  }   /* TSTATE_WAIT_MQNOTFULL (per queue) */
 #endif
 #ifdef CONFIG_PAGING
   ,
@@ -258,14 +243,9 @@ void os_start(void)
 
   dq_init(&g_readytorun);
   dq_init(&g_pendingtasks);
-  dq_init(&g_waitingforsemaphore);
 #ifndef CONFIG_DISABLE_SIGNALS
   dq_init(&g_waitingforsignal);
 #endif
-#ifndef CONFIG_DISABLE_MQUEUE
-  dq_init(&g_waitingformqnotfull);
-  dq_init(&g_waitingformqnotempty);
-#endif
 #ifdef CONFIG_PAGING
   dq_init(&g_waitingforfill);
 #endif
@@ -327,7 +307,11 @@ void os_start(void)
 
   /* Then add the idle task's TCB to the head of the ready to run list */
 
+#ifdef CONFIG_SCHED_READYQ_BITMAP
+  (void)sched_readyq_add(&g_idletcb.cmn);
+#else
   dq_addfirst((FAR dq_entry_t*)&g_idletcb, (FAR dq_queue_t*)&g_readytorun);
+#endif
 
   /* Initialize the processor-specific portion of the TCB */
 
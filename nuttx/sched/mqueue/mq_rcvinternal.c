@@ -276,16 +276,14 @@ ssize_t mq_doreceive(mqd_t mqdes, mqmsg_t *mqmsg, void *ubuffer, int *prio)
   msgq = mqdes->msgq;
   if (msgq->nwaitnotfull > 0)
     {
-      /* Find the highest priority task that is waiting for
-       * this queue to be not-full in g_waitingformqnotfull list.
-       * This must be performed in a critical section because
-       * messages can be sent from interrupt handlers.
+      /* The highest priority task that is waiting for this queue to be
+       * not-full is at the head of its waitfornotfull list.  This must be
+       * performed in a critical section because messages can be sent from
+       * interrupt handlers.
        */
 
       saved_state = irqsave();
-      for (btcb = (FAR struct tcb_s*)g_waitingformqnotfull.head;
-           btcb && btcb->msgwaitq != msgq;
-           btcb = btcb->flink);
+      btcb = (FAR struct tcb_s*)msgq->waitfornotfull.head;
 
       /* If one was found, unblock it.  NOTE:  There is a race
        * condition here:  the queue might be full again by the
@@ -294,7 +292,6 @@ ssize_t mq_doreceive(mqd_t mqdes, mqmsg_t *mqmsg, void *ubuffer, int *prio)
 
       ASSERT(btcb);
 
-       btcb->msgwaitq = NULL;
        msgq->nwaitnotfull--;
        up_unblock_task(btcb);
 
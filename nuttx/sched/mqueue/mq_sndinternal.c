@@ -414,21 +414,16 @@ int mq_dosend(mqd_t mqdes, FAR mqmsg_t *mqmsg, const void *msg, size_t msglen, i
   saved_state = irqsave();
   if (msgq->nwaitnotempty > 0)
     {
-      /* Find the highest priority task that is waiting for
-       * this queue to be non-empty in g_waitingformqnotempty
-       * list. sched_lock() should give us sufficent protection since
-       * interrupts should never cause a change in this list
+      /* The highest priority task that is waiting for this queue to be
+       * non-empty is at the head of its waitfornotempty list.
        */
 
-      for (btcb = (FAR struct tcb_s*)g_waitingformqnotempty.head;
-           btcb && btcb->msgwaitq != msgq;
-           btcb = btcb->flink);
+      btcb = (FAR struct tcb_s*)msgq->waitfornotempty.head;
 
       /* If one was found, unblock it */
 
       ASSERT(btcb);
 
-      btcb->msgwaitq = NULL;
       msgq->nwaitnotempty--;
       up_unblock_task(btcb);
     }
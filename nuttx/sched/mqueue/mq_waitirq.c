@@ -115,8 +115,6 @@ void mq_waitirq(FAR struct tcb_s *wtcb, int errcode)
       msgq = wtcb->msgwaitq;
       DEBUGASSERT(msgq);
 
-      wtcb->msgwaitq = NULL;
-
       /* Decrement the count of waiters and cancel the wait */
 
       if (wtcb->task_state == TSTATE_WAIT_MQNOTEMPTY)
@@ -134,7 +132,7 @@ void mq_waitirq(FAR struct tcb_s *wtcb, int errcode)
 
       wtcb->pterrno = errcode;
 
-      /* Restart the task. */
+      /* Restart the task.  This also clears its msgwaitq. */
 
       up_unblock_task(wtcb);
     }
@@ -54,6 +54,21 @@
  * Pre-processor Definitions
  ****************************************************************************/
 
+/* With CONFIG_PTHREAD_MUTEX_FASTPATH, the pid field of a mutex is updated
+ * with atomic_cmpxchg():  0 means free and a bare pid means that the owner
+ * took it without the semaphore.  PTHREAD_MUTEX_INFLATED is set along with
+ * the owner's pid once the semaphore has been taken on the owner's behalf
+ * because another thread had to wait; the mutex must then be released
+ * through the semaphore.
+ */
+
+#ifdef CONFIG_PTHREAD_MUTEX_FASTPATH
+#  define PTHREAD_MUTEX_INFLATED   0x40000000
+#  define pthread_mutex_holder(m)  ((m)->pid & ~PTHREAD_MUTEX_INFLATED)
+#else
+#  define pthread_mutex_holder(m)  ((m)->pid)
+#endif
+
 /****************************************************************************
  * Public Type Declarations
  ****************************************************************************/
@@ -108,6 +123,8 @@ FAR struct join_s *pthread_findjoininfo(FAR struct task_group_s *group,
 void pthread_release(FAR struct task_group_s *group);
 int pthread_givesemaphore(sem_t *sem);
 int pthread_takesemaphore(sem_t *sem);
+int pthread_mutex_take(FAR pthread_mutex_t *mutex);
+int pthread_mutex_give(FAR pthread_mutex_t *mutex);
 
 #ifdef CONFIG_MUTEX_TYPES
 int pthread_mutexattr_verifytype(int type);
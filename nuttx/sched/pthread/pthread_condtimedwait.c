@@ -201,7 +201,7 @@ int pthread_cond_timedwait(FAR pthread_cond_t *cond, FAR pthread_mutex_t *mutex,
 
   /* Make sure that the caller holds the mutex */
 
-  else if (mutex->pid != mypid)
+  else if (pthread_mutex_holder(mutex) != mypid)
     {
       ret = EPERM;
     }
@@ -270,8 +270,7 @@ int pthread_cond_timedwait(FAR pthread_cond_t *cond, FAR pthread_mutex_t *mutex,
                 {
                   /* Give up the mutex */
 
-                  mutex->pid = 0;
-                  ret = pthread_givesemaphore((sem_t*)&mutex->sem);
+                  ret = pthread_mutex_give(mutex);
                   if (ret)
                     {
                       /* Restore interrupts  (pre-emption will be enabled when
@@ -327,12 +326,8 @@ int pthread_cond_timedwait(FAR pthread_cond_t *cond, FAR pthread_mutex_t *mutex,
                   /* Reacquire the mutex (retaining the ret). */
 
                   sdbg("Re-locking...\n");
-                  status = pthread_takesemaphore((sem_t*)&mutex->sem);
-                  if (!status)
-                    {
-                      mutex->pid = mypid;
-                    }
-                  else if (!ret)
+                  status = pthread_mutex_take(mutex);
+                  if (status && !ret)
                     {
                       ret = status;
                     }
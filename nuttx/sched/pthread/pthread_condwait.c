@@ -102,7 +102,7 @@ int pthread_cond_wait(FAR pthread_cond_t *cond, FAR pthread_mutex_t *mutex)
 
   /* Make sure that the caller holds the mutex */
 
-  else if (mutex->pid != (int)getpid())
+  else if (pthread_mutex_holder(mutex) != (int)getpid())
     {
       ret = EPERM;
     }
@@ -113,8 +113,7 @@ int pthread_cond_wait(FAR pthread_cond_t *cond, FAR pthread_mutex_t *mutex)
       sdbg("Give up mutex / take cond\n");
 
       sched_lock();
-      mutex->pid = 0;
-      ret = pthread_givesemaphore((sem_t*)&mutex->sem);
+      ret = pthread_mutex_give(mutex);
 
       /* Take the semaphore */
 
@@ -124,11 +123,9 @@ int pthread_cond_wait(FAR pthread_cond_t *cond, FAR pthread_mutex_t *mutex)
       /* Reacquire the mutex */
 
       sdbg("Reacquire mutex...\n");
-      ret |= pthread_takesemaphore((sem_t*)&mutex->sem);
-      if (!ret)
-        {
-          mutex->pid = getpid();;
-        }
+      sched_lock();
+      ret |= pthread_mutex_take(mutex);
+      sched_unlock();
     }
 
   sdbg("Returning %d\n", ret);
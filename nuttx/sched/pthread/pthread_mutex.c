@@ -0,0 +1,210 @@
+/*
+ * Copyright (c) 2015 Google Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <nuttx/config.h>
+
+#include <unistd.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <assert.h>
+#include <errno.h>
+
+#include <nuttx/arch.h>
+
+#ifdef CONFIG_PTHREAD_MUTEX_FASTPATH
+#  include <arch/atomic.h>
+#endif
+
+#include "sched/sched.h"
+#include "semaphore/semaphore.h"
+#include "pthread/pthread.h"
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: pthread_mutex_inflate
+ *
+ * Description:
+ *   The mutex is held by a thread that locked it with the atomic fast
+ *   path, so its semaphore still has its single count.  Take that count
+ *   on behalf of the owner, so that the caller blocks on the semaphore and
+ *   priority inheritance boosts the owner as usual.
+ *
+ * Parameters:
+ *   mutex - The mutex to inflate
+ *   holder - The pid of the thread that holds it
+ *
+ * Return Value:
+ *   None
+ *
+ * Assumptions:
+ *   The scheduler is locked, so the owner cannot run until the caller
+ *   blocks on the semaphore.
+ *
+ ****************************************************************************/
+
+#ifdef CONFIG_PTHREAD_MUTEX_FASTPATH
+static void pthread_mutex_inflate(FAR pthread_mutex_t *mutex, int holder)
+{
+  FAR struct tcb_s *htcb = sched_gettcb((pid_t)holder);
+  irqstate_t flags;
+
+  flags = irqsave();
+  DEBUGASSERT(mutex->sem.semcount == 1);
+
+  mutex->sem.semcount = 0;
+  if (htcb)
+    {
+      sem_addholder_tcb(htcb, (FAR sem_t *)&mutex->sem);
+    }
+
+  mutex->pid = holder | PTHREAD_MUTEX_INFLATED;
+  irqrestore(flags);
+}
+#endif
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: pthread_mutex_take
+ *
+ * Description:
+ *   Acquire the mutex for the calling thread, waiting on its semaphore if
+ *   needed, and record the calling thread as its owner.
+ *
+ * Parameters:
+ *   mutex - The mutex to take
+ *
+ * Return Value:
+ *   0 on success or an errno value on failure.
+ *
+ * Assumptions:
+ *   The scheduler is locked and the caller does not hold the mutex.
+ *
+ ****************************************************************************/
+
+int pthread_mutex_take(FAR pthread_mutex_t *mutex)
+{
+  int mypid = (int)getpid();
+  int ret;
+
+#ifdef CONFIG_PTHREAD_MUTEX_FASTPATH
+  int holder;
+
+  /* It may have been released since the caller last looked */
+
+  holder = (int)atomic_cmpxchg((atomic_t *)&mutex->pid, 0, mypid);
+  if (holder == 0)
+    {
+      return OK;
+    }
+
+  /* If the owner did not use the semaphore, take it on the owner's behalf
+   * before waiting for it.
+   */
+
+  if ((holder & PTHREAD_MUTEX_INFLATED) == 0)
+    {
+      pthread_mutex_inflate(mutex, holder);
+    }
+#endif
+
+  ret = pthread_takesemaphore((FAR sem_t *)&mutex->sem);
+  if (ret != OK)
+    {
+      return EINVAL;
+    }
+
+  /* We own the mutex now.  Our unlock must go through the semaphore. */
+
+#ifdef CONFIG_PTHREAD_MUTEX_FASTPATH
+  mutex->pid = mypid | PTHREAD_MUTEX_INFLATED;
+#else
+  mutex->pid = mypid;
+#endif
+  return OK;
+}
+
+/****************************************************************************
+ * Name: pthread_mutex_give
+ *
+ * Description:
+ *   Release a mutex held by the calling thread.  If other threads are
+ *   waiting, ownership passes to the highest priority one.
+ *
+ * Parameters:
+ *   mutex - The mutex to give
+ *
+ * Return Value:
+ *   0 on success or an errno value on failure.
+ *
+ * Assumptions:
+ *   The scheduler is locked and the caller holds the mutex.
+ *
+ ****************************************************************************/
+
+int pthread_mutex_give(FAR pthread_mutex_t *mutex)
+{
+#ifdef CONFIG_PTHREAD_MUTEX_FASTPATH
+  FAR struct tcb_s *wtcb;
+  irqstate_t flags;
+  int ret;
+
+  /* Nobody waited while we held it:  the semaphore was never used */
+
+  if ((mutex->pid & PTHREAD_MUTEX_INFLATED) == 0)
+    {
+      mutex->pid = 0;
+      return OK;
+    }
+
+  /* sem_post() will hand the count to the waiter at the head of the
+   * semaphore's wait list.  Record it as the owner before it runs so that
+   * the fast path cannot see the mutex free in the meantime.
+   */
+
+  flags = irqsave();
+  wtcb = (FAR struct tcb_s *)mutex->sem.waitlist.head;
+  mutex->pid = wtcb ? (wtcb->pid | PTHREAD_MUTEX_INFLATED) : 0;
+  ret = pthread_givesemaphore((FAR sem_t *)&mutex->sem);
+  irqrestore(flags);
+
+  return ret != OK ? EINVAL : OK;
+#else
+  mutex->pid = 0;
+  return pthread_givesemaphore((FAR sem_t *)&mutex->sem) != OK ? EINVAL : OK;
+#endif
+}
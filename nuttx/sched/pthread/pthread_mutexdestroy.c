@@ -108,7 +108,7 @@ int pthread_mutex_destroy(FAR pthread_mutex_t *mutex)
 
       /* Is the semaphore available? */
 
-      if (mutex->pid != 0)
+      if (pthread_mutex_holder(mutex) != 0)
         {
           ret = EBUSY;
         }
@@ -45,6 +45,10 @@
 #include <errno.h>
 #include <debug.h>
 
+#ifdef CONFIG_PTHREAD_MUTEX_FASTPATH
+#  include <arch/atomic.h>
+#endif
+
 #include "pthread/pthread.h"
 
 /****************************************************************************
@@ -127,6 +131,16 @@ int pthread_mutex_lock(FAR pthread_mutex_t *mutex)
     {
       ret = EINVAL;
     }
+#ifdef CONFIG_PTHREAD_MUTEX_FASTPATH
+  /* If the mutex is free, claim it with a single atomic operation */
+
+  else if (atomic_cmpxchg((atomic_t *)&mutex->pid, 0, mypid) == 0)
+    {
+#ifdef CONFIG_MUTEX_TYPES
+      mutex->nlocks = 1;
+#endif
+    }
+#endif
   else
     {
       /* Make sure the semaphore is stable while we make the following
@@ -137,7 +151,7 @@ int pthread_mutex_lock(FAR pthread_mutex_t *mutex)
 
       /* Does this task already hold the semaphore? */
 
-      if (mutex->pid == mypid)
+      if (pthread_mutex_holder(mutex) == mypid)
         {
           /* Yes.. Is this a recursive mutex? */
 
@@ -161,21 +175,17 @@ int pthread_mutex_lock(FAR pthread_mutex_t *mutex)
         }
       else
         {
-          /* Take the semaphore */
-
-          ret = pthread_takesemaphore((sem_t*)&mutex->sem);
-
-          /* If we succussfully obtained the semaphore, then indicate
-           * that we own it.
+          /* Take the semaphore.  If we succussfully obtained the
+           * semaphore, then pthread_mutex_take() indicates that we own it.
            */
 
+          ret = pthread_mutex_take(mutex);
+#ifdef CONFIG_MUTEX_TYPES
           if (!ret)
             {
-              mutex->pid    = mypid;
-#ifdef CONFIG_MUTEX_TYPES
               mutex->nlocks = 1;
-#endif
             }
+#endif
         }
 
       sched_unlock();
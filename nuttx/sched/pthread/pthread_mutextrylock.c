@@ -46,6 +46,10 @@
 #include <errno.h>
 #include <debug.h>
 
+#ifdef CONFIG_PTHREAD_MUTEX_FASTPATH
+#  include <arch/atomic.h>
+#endif
+
 #include "pthread/pthread.h"
 
 /****************************************************************************
@@ -106,6 +110,22 @@ int pthread_mutex_trylock(FAR pthread_mutex_t *mutex)
     {
       ret = EINVAL;
     }
+#ifdef CONFIG_PTHREAD_MUTEX_FASTPATH
+  /* The pid field is zero exactly when the mutex is free, so one atomic
+   * operation both tests and claims it.
+   */
+
+  else if (atomic_cmpxchg((atomic_t *)&mutex->pid, 0, (int)getpid()) != 0)
+    {
+      ret = EBUSY;
+    }
+  else
+    {
+#ifdef CONFIG_MUTEX_TYPES
+      mutex->nlocks = 1;
+#endif
+    }
+#else
   else
     {
       /* Make sure the semaphore is stable while we make the following
@@ -138,6 +158,7 @@ int pthread_mutex_trylock(FAR pthread_mutex_t *mutex)
 
       sched_unlock();
     }
+#endif
 
   sdbg("Returning %d\n", ret);
   return ret;
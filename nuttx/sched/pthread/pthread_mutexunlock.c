@@ -45,6 +45,10 @@
 #include <errno.h>
 #include <debug.h>
 
+#ifdef CONFIG_PTHREAD_MUTEX_FASTPATH
+#  include <arch/atomic.h>
+#endif
+
 #include "pthread/pthread.h"
 
 /****************************************************************************
@@ -67,6 +71,47 @@
  * Private Functions
  ****************************************************************************/
 
+/****************************************************************************
+ * Name: pthread_mutex_fastunlock
+ *
+ * Description:
+ *   Release a mutex that the caller locked without the semaphore, with a
+ *   single atomic operation.  This fails if another thread has waited for
+ *   the mutex since, in which case it must be released through the
+ *   semaphore.
+ *
+ * Return Value:
+ *   true if the unlock is complete.
+ *
+ ****************************************************************************/
+
+#ifdef CONFIG_PTHREAD_MUTEX_FASTPATH
+static inline bool pthread_mutex_fastunlock(FAR pthread_mutex_t *mutex,
+                                            int mypid)
+{
+  /* This also fails if the mutex is inflated */
+
+  if (mutex->pid != mypid)
+    {
+      return false;
+    }
+
+#ifdef CONFIG_MUTEX_TYPES
+  if (mutex->type == PTHREAD_MUTEX_RECURSIVE && mutex->nlocks > 1)
+    {
+      mutex->nlocks--;
+      return true;
+    }
+
+  /* Clear the count before the mutex can be taken by another thread */
+
+  mutex->nlocks = 0;
+#endif
+
+  return (int)atomic_cmpxchg((atomic_t *)&mutex->pid, mypid, 0) == mypid;
+}
+#endif
+
 /****************************************************************************
  * Public Functions
  ****************************************************************************/
@@ -100,6 +145,7 @@
 
 int pthread_mutex_unlock(FAR pthread_mutex_t *mutex)
 {
+  int mypid = (int)getpid();
   int ret = OK;
 
   sdbg("mutex=0x%p\n", mutex);
@@ -110,6 +156,15 @@ int pthread_mutex_unlock(FAR pthread_mutex_t *mutex)
     }
   else
     {
+#ifdef CONFIG_PTHREAD_MUTEX_FASTPATH
+      /* Try to release it without locking the scheduler first */
+
+      if (pthread_mutex_fastunlock(mutex, mypid))
+        {
+          return OK;
+        }
+
+#endif
       /* Make sure the semaphore is stable while we make the following
        * checks.  This all needs to be one atomic action.
        */
@@ -118,7 +173,7 @@ int pthread_mutex_unlock(FAR pthread_mutex_t *mutex)
 
       /* Does the calling thread own the semaphore? */
 
-      if (mutex->pid != (int)getpid())
+      if (pthread_mutex_holder(mutex) != mypid)
         {
           /* No... return an error (default behavior is like PTHREAD_MUTEX_ERRORCHECK) */
 
@@ -146,13 +201,12 @@ int pthread_mutex_unlock(FAR pthread_mutex_t *mutex)
 
       else
         {
-          /* Nullify the pid and lock count then post the semaphore */
+          /* Nullify the lock count then release the mutex */
 
-          mutex->pid    = 0;
 #ifdef CONFIG_MUTEX_TYPES
           mutex->nlocks = 0;
 #endif
-          ret = pthread_givesemaphore((sem_t*)&mutex->sem);
+          ret = pthread_mutex_give(mutex);
         }
       sched_unlock();
     }
@@ -100,7 +100,8 @@ struct pidhash_s
 
 struct tasklist_s
 {
-  DSEG volatile dq_queue_t *list; /* Pointer to the task list */
+  DSEG volatile dq_queue_t *list; /* Pointer to the task list, NULL if the
+                                   * list is owned by the awaited object */
   bool prioritized;               /* true if the list is prioritized */
 };
 
@@ -114,8 +115,13 @@ struct tasklist_s
  * and by a series of task lists.  All of these tasks lists are declared
  * below. Although it is not always necessary, most of these lists are
  * prioritized so that common list handling logic can be used (only the
- * g_readytorun, the g_pendingtasks, and the g_waitingforsemaphore lists need
- * to be prioritized).
+ * g_readytorun, the g_pendingtasks, and the semaphore and message queue
+ * wait lists need to be prioritized).
+ *
+ * Tasks waiting for a semaphore or a message queue are not kept in a global
+ * list: each semaphore and message queue holds its own list of waiters so
+ * that waking one does not have to search every blocked task.  Use
+ * sched_tasklist() to find the list that holds a given TCB.
  */
 
 /* This is the list of all tasks that are ready to run.  The head of this
@@ -133,32 +139,12 @@ extern volatile dq_queue_t g_readytorun;
 
 extern volatile dq_queue_t g_pendingtasks;
 
-/* This is the list of all tasks that are blocked waiting for a semaphore */
-
-extern volatile dq_queue_t g_waitingforsemaphore;
-
 /* This is the list of all tasks that are blocked waiting for a signal */
 
 #ifndef CONFIG_DISABLE_SIGNALS
 extern volatile dq_queue_t g_waitingforsignal;
 #endif
 
-/* This is the list of all tasks that are blocked waiting for a message
- * queue to become non-empty.
- */
-
-#ifndef CONFIG_DISABLE_MQUEUE
-extern volatile dq_queue_t g_waitingformqnotempty;
-#endif
-
-/* This is the list of all tasks that are blocked waiting for a message
- * queue to become non-full.
- */
-
-#ifndef CONFIG_DISABLE_MQUEUE
-extern volatile dq_queue_t g_waitingformqnotfull;
-#endif
-
 /* This is the list of all tasks that are blocking waiting for a page fill */
 
 #ifdef CONFIG_PAGING
@@ -224,6 +210,11 @@ bool sched_addreadytorun(FAR struct tcb_s *rtrtcb);
 bool sched_removereadytorun(FAR struct tcb_s *rtrtcb);
 bool sched_addprioritized(FAR struct tcb_s *newTcb, DSEG dq_queue_t *list);
 bool sched_mergepending(void);
+FAR dq_queue_t *sched_tasklist(FAR struct tcb_s *tcb, tstate_t task_state);
+#ifdef CONFIG_SCHED_READYQ_BITMAP
+bool sched_readyq_add(FAR struct tcb_s *tcb);
+void sched_readyq_remove(FAR struct tcb_s *tcb);
+#endif
 void sched_addblocked(FAR struct tcb_s *btcb, tstate_t task_state);
 void sched_removeblocked(FAR struct tcb_s *btcb);
 int  sched_setpriority(FAR struct tcb_s *tcb, int sched_priority);
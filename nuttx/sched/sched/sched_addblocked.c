@@ -90,6 +90,8 @@
 
 void sched_addblocked(FAR struct tcb_s *btcb, tstate_t task_state)
 {
+  FAR dq_queue_t *list;
+
   /* Make sure that we received a valid blocked state */
 
   ASSERT(task_state >= FIRST_BLOCKED_STATE &&
@@ -100,19 +102,18 @@ void sched_addblocked(FAR struct tcb_s *btcb, tstate_t task_state)
    * list
    */
 
+  list = sched_tasklist(btcb, task_state);
   if (g_tasklisttable[task_state].prioritized)
     {
       /* Add the task to a prioritized list */
 
-      sched_addprioritized(btcb,
-                           (FAR dq_queue_t*)g_tasklisttable[task_state].list);
+      sched_addprioritized(btcb, list);
     }
   else
     {
       /* Add the task to a non-prioritized list */
 
-      dq_addlast((FAR dq_entry_t*)btcb,
-                 (FAR dq_queue_t*)g_tasklisttable[task_state].list);
+      dq_addlast((FAR dq_entry_t*)btcb, list);
     }
 
   /* Make sure the TCB's state corresponds to the list */
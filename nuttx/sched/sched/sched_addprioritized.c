@@ -106,6 +106,15 @@ bool sched_addprioritized(FAR struct tcb_s *tcb, DSEG dq_queue_t *list)
 
   ASSERT(sched_priority >= SCHED_PRIORITY_MIN);
 
+#ifdef CONFIG_SCHED_READYQ_BITMAP
+  /* The ready-to-run list is indexed by priority; no search is needed */
+
+  if (list == (FAR dq_queue_t *)&g_readytorun)
+    {
+      return sched_readyq_add(tcb);
+    }
+#endif
+
   /* Search the list to find the location to insert the new Tcb.
    * Each is list is maintained in ascending sched_priority order.
    */
@@ -97,9 +97,37 @@ bool sched_mergepending(void)
   FAR struct tcb_s *pndtcb;
   FAR struct tcb_s *pndnext;
   FAR struct tcb_s *rtrtcb;
+#ifndef CONFIG_SCHED_READYQ_BITMAP
   FAR struct tcb_s *rtrprev;
+#endif
   bool ret = false;
 
+#ifdef CONFIG_SCHED_READYQ_BITMAP
+  /* The ready-to-run list is indexed by priority so each pending task can
+   * be inserted directly.
+   */
+
+  for (pndtcb = (FAR struct tcb_s*)g_pendingtasks.head; pndtcb; pndtcb = pndnext)
+    {
+      pndnext = pndtcb->flink;
+      rtrtcb  = (FAR struct tcb_s*)g_readytorun.head;
+
+      if (sched_readyq_add(pndtcb))
+        {
+          /* Inform the instrumentation layer that we are switching tasks */
+
+          sched_note_switch(rtrtcb, pndtcb);
+
+          rtrtcb->task_state = TSTATE_TASK_READYTORUN;
+          pndtcb->task_state = TSTATE_TASK_RUNNING;
+          ret                = true;
+        }
+      else
+        {
+          pndtcb->task_state = TSTATE_TASK_READYTORUN;
+        }
+    }
+#else
   /* Initialize the inner search loop */
 
   rtrtcb = (FAR struct tcb_s*)g_readytorun.head;
@@ -162,6 +190,7 @@ bool sched_mergepending(void)
 
       rtrtcb = pndtcb;
     }
+#endif
 
   /* Mark the input list empty */
 
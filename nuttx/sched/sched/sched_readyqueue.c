@@ -0,0 +1,209 @@
+/*
+ * Copyright (c) 2015 Google Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <nuttx/config.h>
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <queue.h>
+#include <assert.h>
+
+#include "sched/sched.h"
+
+#ifdef CONFIG_SCHED_READYQ_BITMAP
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+
+#define READYQ_NPRIO   256
+#define READYQ_NWORDS  (READYQ_NPRIO / 32)
+
+/****************************************************************************
+ * Private Variables
+ ****************************************************************************/
+
+/* g_readymap has bit N set when at least one task of priority N is in the
+ * g_readytorun list.  g_readytail[N] is then the last such task, i.e. the
+ * TCB after which a newly readied task of priority N must be inserted to
+ * preserve FIFO order within the priority.
+ */
+
+static uint32_t g_readymap[READYQ_NWORDS];
+static FAR struct tcb_s *g_readytail[READYQ_NPRIO];
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: sched_readyq_ffs
+ *
+ * Description:
+ *   Return the index of the least significant set bit of a non-zero word.
+ *
+ ****************************************************************************/
+
+static inline int sched_readyq_ffs(uint32_t word)
+{
+#ifdef __GNUC__
+  return __builtin_ctz(word);
+#else
+  int bit = 0;
+
+  while ((word & 1) == 0)
+    {
+      word >>= 1;
+      bit++;
+    }
+
+  return bit;
+#endif
+}
+
+/****************************************************************************
+ * Name: sched_readyq_lowest
+ *
+ * Description:
+ *   Return the lowest priority that is >= 'prio' and has at least one
+ *   ready-to-run task, or -1 if every ready task has a priority below
+ *   'prio'.  The scan is bounded by READYQ_NWORDS words.
+ *
+ ****************************************************************************/
+
+static int sched_readyq_lowest(int prio)
+{
+  int word = prio >> 5;
+  uint32_t bits = g_readymap[word] & (0xffffffffu << (prio & 31));
+
+  for (; ; )
+    {
+      if (bits != 0)
+        {
+          return (word << 5) + sched_readyq_ffs(bits);
+        }
+
+      if (++word >= READYQ_NWORDS)
+        {
+          return -1;
+        }
+
+      bits = g_readymap[word];
+    }
+}
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: sched_readyq_add
+ *
+ * Description:
+ *   Insert a TCB into the g_readytorun list behind every task of the same
+ *   or higher priority, using the priority bitmap to locate the insertion
+ *   point rather than walking the list.
+ *
+ * Inputs:
+ *   tcb - Points to the TCB to add to the ready-to-run list
+ *
+ * Return Value:
+ *   true if tcb is now at the head of the g_readytorun list.
+ *
+ * Assumptions:
+ * - The caller has established a critical section.
+ * - The caller has already removed tcb from whatever list it was in.
+ *
+ ****************************************************************************/
+
+bool sched_readyq_add(FAR struct tcb_s *tcb)
+{
+  int prio = tcb->sched_priority;
+  int prev = sched_readyq_lowest(prio);
+
+  if (prev < 0)
+    {
+      /* No ready task has the same or higher priority */
+
+      dq_addfirst((FAR dq_entry_t *)tcb, (FAR dq_queue_t *)&g_readytorun);
+    }
+  else
+    {
+      dq_addafter((FAR dq_entry_t *)g_readytail[prev], (FAR dq_entry_t *)tcb,
+                  (FAR dq_queue_t *)&g_readytorun);
+    }
+
+  g_readytail[prio] = tcb;
+  g_readymap[prio >> 5] |= (uint32_t)1 << (prio & 31);
+
+  return tcb->blink == NULL;
+}
+
+/****************************************************************************
+ * Name: sched_readyq_remove
+ *
+ * Description:
+ *   Remove a TCB from the g_readytorun list and update the priority index.
+ *
+ * Inputs:
+ *   tcb - Points to the TCB to remove from the ready-to-run list
+ *
+ * Assumptions:
+ * - The caller has established a critical section.
+ * - tcb is in the g_readytorun list and its sched_priority has not been
+ *   changed since it was added.
+ *
+ ****************************************************************************/
+
+void sched_readyq_remove(FAR struct tcb_s *tcb)
+{
+  int prio = tcb->sched_priority;
+
+  if (g_readytail[prio] == tcb)
+    {
+      FAR struct tcb_s *prev = tcb->blink;
+
+      if (prev != NULL && prev->sched_priority == prio)
+        {
+          g_readytail[prio] = prev;
+        }
+      else
+        {
+          g_readytail[prio] = NULL;
+          g_readymap[prio >> 5] &= ~((uint32_t)1 << (prio & 31));
+        }
+    }
+
+  dq_rem((FAR dq_entry_t *)tcb, (FAR dq_queue_t *)&g_readytorun);
+}
+
+#endif /* CONFIG_SCHED_READYQ_BITMAP */
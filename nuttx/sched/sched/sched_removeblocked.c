@@ -100,7 +100,23 @@ void sched_removeblocked(FAR struct tcb_s *btcb)
    * with this state
    */
 
-  dq_rem((FAR dq_entry_t*)btcb, (dq_queue_t*)g_tasklisttable[task_state].list);
+  dq_rem((FAR dq_entry_t*)btcb, sched_tasklist(btcb, task_state));
+
+  /* The wait is over.  Forget the object that owned the list now, before
+   * the task can run and wait for something else.
+   */
+
+  if (task_state == TSTATE_WAIT_SEM)
+    {
+      btcb->waitsem = NULL;
+    }
+#ifndef CONFIG_DISABLE_MQUEUE
+  else if (task_state == TSTATE_WAIT_MQNOTEMPTY ||
+           task_state == TSTATE_WAIT_MQNOTFULL)
+    {
+      btcb->msgwaitq = NULL;
+    }
+#endif
 
   /* Make sure the TCB's state corresponds to not being in
    * any list
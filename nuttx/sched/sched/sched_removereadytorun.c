@@ -115,7 +115,11 @@ bool sched_removereadytorun(FAR struct tcb_s *rtcb)
 
   /* Remove the TCB from the ready-to-run list */
 
+#ifdef CONFIG_SCHED_READYQ_BITMAP
+  sched_readyq_remove(rtcb);
+#else
   dq_rem((FAR dq_entry_t *)rtcb, (FAR dq_queue_t *)&g_readytorun);
+#endif
 
   /* Since the TCB is not in any list, it is now invalid */
 
@@ -149,9 +149,21 @@ int sched_setpriority(FAR struct tcb_s *tcb, int sched_priority)
 
         else
           {
+#ifdef CONFIG_SCHED_READYQ_BITMAP
+            /* The task stays at the head of the ready-to-run list, but the
+             * priority index must follow it to its new priority.
+             */
+
+            sched_readyq_remove(tcb);
+#endif
+
             /* Change the task priority */
 
             tcb->sched_priority = (uint8_t)sched_priority;
+
+#ifdef CONFIG_SCHED_READYQ_BITMAP
+            (void)sched_readyq_add(tcb);
+#endif
           }
         break;
 
@@ -204,7 +216,7 @@ int sched_setpriority(FAR struct tcb_s *tcb, int sched_priority)
           {
             /* Remove the TCB from the prioritized task list */
 
-            dq_rem((FAR dq_entry_t*)tcb, (FAR dq_queue_t*)g_tasklisttable[task_state].list);
+            dq_rem((FAR dq_entry_t*)tcb, sched_tasklist(tcb, task_state));
 
             /* Change the task priority */
 
@@ -214,7 +226,7 @@ int sched_setpriority(FAR struct tcb_s *tcb, int sched_priority)
              * position
              */
 
-            sched_addprioritized(tcb, (FAR dq_queue_t*)g_tasklisttable[task_state].list);
+            sched_addprioritized(tcb, sched_tasklist(tcb, task_state));
           }
 
         /* CASE 3b. The task resides in a non-prioritized list. */
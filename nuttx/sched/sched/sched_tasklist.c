@@ -0,0 +1,88 @@
+/*
+ * Copyright (c) 2015 Google Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/************************************************************************
+ * Included Files
+ ************************************************************************/
+
+#include <nuttx/config.h>
+
+#include <queue.h>
+#include <semaphore.h>
+#include <assert.h>
+
+#include <nuttx/mqueue.h>
+
+#include "sched/sched.h"
+
+/************************************************************************
+ * Public Functions
+ ************************************************************************/
+
+/************************************************************************
+ * Name: sched_tasklist
+ *
+ * Description:
+ *   Return the task list that holds a TCB in the given state.  Most
+ *   states map to one of the global lists in g_tasklisttable[], but
+ *   tasks waiting for a semaphore or a message queue are kept in a
+ *   list owned by the object they wait on.
+ *
+ * Inputs:
+ *   tcb        - The TCB whose list is wanted.  Its waitsem or msgwaitq
+ *                field must be valid if task_state is one of the
+ *                corresponding wait states.
+ *   task_state - The state the TCB is in, or is about to enter.
+ *
+ * Return Value:
+ *   The list, or NULL for a state that has no list.
+ *
+ ************************************************************************/
+
+FAR dq_queue_t *sched_tasklist(FAR struct tcb_s *tcb, tstate_t task_state)
+{
+  switch (task_state)
+    {
+      case TSTATE_WAIT_SEM:
+        DEBUGASSERT(tcb->waitsem != NULL);
+        return &tcb->waitsem->waitlist;
+
+#ifndef CONFIG_DISABLE_MQUEUE
+      case TSTATE_WAIT_MQNOTEMPTY:
+        DEBUGASSERT(tcb->msgwaitq != NULL);
+        return &tcb->msgwaitq->waitfornotempty;
+
+      case TSTATE_WAIT_MQNOTFULL:
+        DEBUGASSERT(tcb->msgwaitq != NULL);
+        return &tcb->msgwaitq->waitfornotfull;
+#endif
+
+      default:
+        return (FAR dq_queue_t *)g_tasklisttable[task_state].list;
+    }
+}
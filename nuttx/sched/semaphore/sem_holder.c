@@ -826,38 +826,63 @@ void sem_destroyholder(FAR sem_t *sem)
 }
 
 /****************************************************************************
- * Name: sem_addholder
+ * Name: sem_addholder_tcb
  *
  * Description:
- *   Called from sem_wait() when the calling thread obtains the semaphore
+ *   Record that htcb holds one more count on the semaphore.  This is used
+ *   when a count is taken on behalf of a thread other than the caller,
+ *   e.g. when a contended pthread mutex that was locked without the
+ *   semaphore is handed over to it.
  *
  * Parameters:
- *   sem - A reference to the incremented semaphore
+ *   htcb - The TCB of the holder
+ *   sem - A reference to the semaphore
  *
  * Return Value:
- *   0 (OK) or -1 (ERROR) if unsuccessful
+ *   None
  *
  * Assumptions:
+ *   Interrupts are disabled.
  *
  ****************************************************************************/
 
-void sem_addholder(FAR sem_t *sem)
+void sem_addholder_tcb(FAR struct tcb_s *htcb, FAR sem_t *sem)
 {
-  FAR struct tcb_s *rtcb = (FAR struct tcb_s*)g_readytorun.head;
   FAR struct semholder_s *pholder;
 
   /* Find or allocate a container for this new holder */
 
-  pholder = sem_findorallocateholder(sem, rtcb);
+  pholder = sem_findorallocateholder(sem, htcb);
   if (pholder)
     {
       /* Then set the holder and increment the number of counts held by this holder */
 
-      pholder->htcb = rtcb;
+      pholder->htcb = htcb;
       pholder->counts++;
     }
 }
 
+/****************************************************************************
+ * Name: sem_addholder
+ *
+ * Description:
+ *   Called from sem_wait() when the calling thread obtains the semaphore
+ *
+ * Parameters:
+ *   sem - A reference to the incremented semaphore
+ *
+ * Return Value:
+ *   0 (OK) or -1 (ERROR) if unsuccessful
+ *
+ * Assumptions:
+ *
+ ****************************************************************************/
+
+void sem_addholder(FAR sem_t *sem)
+{
+  sem_addholder_tcb((FAR struct tcb_s*)g_readytorun.head, sem);
+}
+
 /****************************************************************************
  * Name: void sem_boostpriority(sem_t *sem)
  *
@@ -125,15 +125,13 @@ void sem_waitirq(FAR struct tcb_s *wtcb, int errcode)
 
       sem->semcount++;
 
-      /* Indicate that the semaphore wait is over. */
-
-      wtcb->waitsem = NULL;
-
       /* Mark the errno value for the thread. */
 
       wtcb->pterrno = errcode;
 
-      /* Restart the task. */
+      /* Restart the task.  This also clears waitsem to indicate that the
+       * semaphore wait is over.
+       */
 
       up_unblock_task(wtcb);
     }
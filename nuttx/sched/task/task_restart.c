@@ -160,8 +160,19 @@ int task_restart(pid_t pid)
        */
 
       state = irqsave();
-      dq_rem((FAR dq_entry_t*)tcb,
-             (dq_queue_t*)g_tasklisttable[tcb->cmn.task_state].list);
+#ifdef CONFIG_SCHED_READYQ_BITMAP
+      if (tcb->cmn.task_state == TSTATE_TASK_READYTORUN ||
+          tcb->cmn.task_state == TSTATE_TASK_RUNNING)
+        {
+          sched_readyq_remove((FAR struct tcb_s *)tcb);
+        }
+      else
+#endif
+        {
+          dq_rem((FAR dq_entry_t*)tcb,
+                 sched_tasklist((FAR struct tcb_s *)tcb,
+                                tcb->cmn.task_state));
+        }
       tcb->cmn.task_state = TSTATE_TASK_INVALID;
       irqrestore(state);
 
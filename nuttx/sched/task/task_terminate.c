@@ -168,7 +168,19 @@ int task_terminate(pid_t pid, bool nonblocking)
   /* Remove the task from the OS's tasks lists. */
 
   saved_state = irqsave();
-  dq_rem((FAR dq_entry_t*)dtcb, (dq_queue_t*)g_tasklisttable[dtcb->task_state].list);
+#ifdef CONFIG_SCHED_READYQ_BITMAP
+  if (dtcb->task_state == TSTATE_TASK_READYTORUN ||
+      dtcb->task_state == TSTATE_TASK_RUNNING)
+    {
+      sched_readyq_remove(dtcb);
+    }
+  else
+#endif
+    {
+      dq_rem((FAR dq_entry_t*)dtcb,
+             sched_tasklist(dtcb, dtcb->task_state));
+    }
+
   dtcb->task_state = TSTATE_TASK_INVALID;
   irqrestore(saved_state);
 
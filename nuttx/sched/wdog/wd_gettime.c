@@ -94,6 +94,14 @@ int wd_gettime(WDOG_ID wdog)
   flags = irqsave();
   if (wdog && WDOG_ISACTIVE(wdog))
     {
+#ifdef CONFIG_WDOG_TIMER_WHEEL
+      /* The wheel keeps the absolute expiration tick of each watchdog */
+
+      int delay = wd_wheel_remaining(wdog);
+
+      irqrestore(flags);
+      return delay;
+#else
       /* Traverse the watchdog list accumulating lag times until we find the wdog
        * that we are looking for
        */
@@ -110,6 +118,7 @@ int wd_gettime(WDOG_ID wdog)
               return delay;
             }
         }
+#endif
     }
 
   irqrestore(flags);
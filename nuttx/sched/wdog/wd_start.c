@@ -96,12 +96,74 @@ typedef void (*wdentry4_t)(int argc, uint32_t arg1, uint32_t arg2,
 /****************************************************************************
  * Private Functions
  ****************************************************************************/
+/****************************************************************************
+ * Name: wd_dispatch
+ *
+ * Description:
+ *   Execute the function of a watchdog that has been removed from the
+ *   timer queue.
+ *
+ * Parameters:
+ *   wdog - The expired watchdog
+ *
+ * Return Value:
+ *   None
+ *
+ * Assumptions:
+ *
+ ****************************************************************************/
+
+static inline void wd_dispatch(FAR struct wdog_s *wdog)
+{
+  /* Execute the watchdog function */
+
+  up_setpicbase(wdog->picbase);
+  switch (wdog->argc)
+    {
+      default:
+        DEBUGPANIC();
+        break;
+
+      case 0:
+        (*((wdentry0_t)(wdog->func)))(0);
+        break;
+
+#if CONFIG_MAX_WDOGPARMS > 0
+      case 1:
+        (*((wdentry1_t)(wdog->func)))(1, wdog->parm[0]);
+        break;
+#endif
+#if CONFIG_MAX_WDOGPARMS > 1
+      case 2:
+        (*((wdentry2_t)(wdog->func)))(2,
+                        wdog->parm[0], wdog->parm[1]);
+        break;
+#endif
+#if CONFIG_MAX_WDOGPARMS > 2
+      case 3:
+        (*((wdentry3_t)(wdog->func)))(3,
+                        wdog->parm[0], wdog->parm[1],
+                        wdog->parm[2]);
+        break;
+#endif
+#if CONFIG_MAX_WDOGPARMS > 3
+      case 4:
+        (*((wdentry4_t)(wdog->func)))(4,
+                        wdog->parm[0], wdog->parm[1],
+                        wdog->parm[2] ,wdog->parm[3]);
+        break;
+#endif
+    }
+}
+
 /****************************************************************************
  * Name: wd_expiration
  *
  * Description:
  *   Check if the timer for the watchdog at the head of list is ready to
- *   run.  If so, remove the watchdog from the list and execute it.
+ *   run.  If so, remove the watchdog from the list and execute it.  With
+ *   CONFIG_WDOG_TIMER_WHEEL, run all of the watchdogs that the wheel found
+ *   expired instead.
  *
  * Parameters:
  *   None
@@ -113,6 +175,21 @@ typedef void (*wdentry4_t)(int argc, uint32_t arg1, uint32_t arg2,
  *
  ****************************************************************************/
 
+#ifdef CONFIG_WDOG_TIMER_WHEEL
+static inline void wd_expiration(void)
+{
+  FAR struct wdog_s *wdog;
+
+  /* The watchdogs are removed one at a time so that a watchdog function
+   * may still cancel, or restart, another expired watchdog.
+   */
+
+  while ((wdog = wd_wheel_expired()) != NULL)
+    {
+      wd_dispatch(wdog);
+    }
+}
+#else
 static inline void wd_expiration(void)
 {
   FAR struct wdog_s *wdog;
@@ -147,46 +224,11 @@ static inline void wd_expiration(void)
 
           /* Execute the watchdog function */
 
-          up_setpicbase(wdog->picbase);
-          switch (wdog->argc)
-            {
-              default:
-                DEBUGPANIC();
-                break;
-
-              case 0:
-                (*((wdentry0_t)(wdog->func)))(0);
-                break;
-
-#if CONFIG_MAX_WDOGPARMS > 0
-              case 1:
-                (*((wdentry1_t)(wdog->func)))(1, wdog->parm[0]);
-                break;
-#endif
-#if CONFIG_MAX_WDOGPARMS > 1
-              case 2:
-                (*((wdentry2_t)(wdog->func)))(2,
-                                wdog->parm[0], wdog->parm[1]);
-                break;
-#endif
-#if CONFIG_MAX_WDOGPARMS > 2
-              case 3:
-                (*((wdentry3_t)(wdog->func)))(3,
-                                wdog->parm[0], wdog->parm[1],
-                                wdog->parm[2]);
-                break;
-#endif
-#if CONFIG_MAX_WDOGPARMS > 3
-              case 4:
-                (*((wdentry4_t)(wdog->func)))(4,
-                                wdog->parm[0], wdog->parm[1],
-                                wdog->parm[2] ,wdog->parm[3]);
-                break;
-#endif
-            }
+          wd_dispatch(wdog);
         }
     }
 }
+#endif
 
 /****************************************************************************
  * Public Functions
@@ -228,10 +270,12 @@ static inline void wd_expiration(void)
 int wd_start(WDOG_ID wdog, int delay, wdentry_t wdentry,  int argc, ...)
 {
   va_list ap;
+#ifndef CONFIG_WDOG_TIMER_WHEEL
   FAR struct wdog_s *curr;
   FAR struct wdog_s *prev;
   FAR struct wdog_s *next;
   int32_t now;
+#endif
   irqstate_t state;
   int i;
 
@@ -295,6 +339,11 @@ int wd_start(WDOG_ID wdog, int delay, wdentry_t wdentry,  int argc, ...)
   (void)sched_timer_cancel();
 #endif
 
+#ifdef CONFIG_WDOG_TIMER_WHEEL
+  /* Hash the watchdog into the slot of its expiration tick */
+
+  wd_wheel_insert(wdog, delay);
+#else
   /* Do the easy case first -- when the watchdog timer queue is empty. */
 
   if (g_wdactivelist.head == NULL)
@@ -380,9 +429,13 @@ int wd_start(WDOG_ID wdog, int delay, wdentry_t wdentry,  int argc, ...)
         }
     }
 
-  /* Put the lag into the watchdog structure and mark it as active. */
+  /* Put the lag into the watchdog structure */
 
   wdog->lag = delay;
+#endif
+
+  /* Mark the watchdog as active. */
+
   WDOG_SETACTIVE(wdog);
 
 #ifdef CONFIG_SCHED_TICKLESS
@@ -423,8 +476,36 @@ int wd_start(WDOG_ID wdog, int delay, wdentry_t wdentry,  int argc, ...)
  *
  ****************************************************************************/
 
+#ifdef CONFIG_WDOG_TIMER_WHEEL
 #ifdef CONFIG_SCHED_TICKLESS
 unsigned int wd_timer(int ticks)
+{
+  /* Collect the watchdogs that expired during the interval and run them */
+
+  if (ticks > 0)
+    {
+      wd_wheel_advance(ticks);
+    }
+
+  wd_expiration();
+
+  /* Return the delay for the next watchdog to expire */
+
+  return wd_wheel_next();
+}
+
+#else
+void wd_timer(void)
+{
+  /* Collect the watchdogs that expire on this tick and run them */
+
+  wd_wheel_advance(1);
+  wd_expiration();
+}
+#endif /* CONFIG_SCHED_TICKLESS */
+
+#elif defined(CONFIG_SCHED_TICKLESS)
+unsigned int wd_timer(int ticks)
 {
   FAR struct wdog_s *wdog;
   int decr;
@@ -481,4 +562,4 @@ void wd_timer(void)
       wd_expiration();
     }
 }
-#endif /* CONFIG_SCHED_TICKLESS */
+#endif /* CONFIG_WDOG_TIMER_WHEEL */
@@ -0,0 +1,465 @@
+/*
+ * Copyright (c) 2015 Google Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <nuttx/config.h>
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <queue.h>
+#include <assert.h>
+
+#include <nuttx/wdog.h>
+
+#include "wdog/wdog.h"
+
+#ifdef CONFIG_WDOG_TIMER_WHEEL
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+
+#ifndef CONFIG_WDOG_WHEEL_SLOTS
+#  define CONFIG_WDOG_WHEEL_SLOTS 64
+#endif
+
+#if CONFIG_WDOG_WHEEL_SLOTS == 2
+#  define WHEEL_BITS 1
+#elif CONFIG_WDOG_WHEEL_SLOTS == 4
+#  define WHEEL_BITS 2
+#elif CONFIG_WDOG_WHEEL_SLOTS == 8
+#  define WHEEL_BITS 3
+#elif CONFIG_WDOG_WHEEL_SLOTS == 16
+#  define WHEEL_BITS 4
+#elif CONFIG_WDOG_WHEEL_SLOTS == 32
+#  define WHEEL_BITS 5
+#elif CONFIG_WDOG_WHEEL_SLOTS == 64
+#  define WHEEL_BITS 6
+#elif CONFIG_WDOG_WHEEL_SLOTS == 128
+#  define WHEEL_BITS 7
+#elif CONFIG_WDOG_WHEEL_SLOTS == 256
+#  define WHEEL_BITS 8
+#elif CONFIG_WDOG_WHEEL_SLOTS == 512
+#  define WHEEL_BITS 9
+#elif CONFIG_WDOG_WHEEL_SLOTS == 1024
+#  define WHEEL_BITS 10
+#else
+#  error CONFIG_WDOG_WHEEL_SLOTS must be a power of two between 2 and 1024
+#endif
+
+/* Number of wheel levels.  Level n holds the watchdogs that expire less
+ * than CONFIG_WDOG_WHEEL_SLOTS^(n+1) ticks ahead, each slot of it covering
+ * CONFIG_WDOG_WHEEL_SLOTS^n ticks.  Watchdogs further away than the last
+ * level wait in the overflow list, whose level number is WHEEL_LEVELS.
+ */
+
+#define WHEEL_LEVELS      3
+#define WHEEL_MASK        (CONFIG_WDOG_WHEEL_SLOTS - 1)
+#define WHEEL_SHIFT(l)    ((l) * WHEEL_BITS)
+#define WHEEL_RANGE(l)    ((uint32_t)1 << WHEEL_SHIFT((l) + 1))
+#define WHEEL_INDEX(l,t)  (((uint32_t)(t) >> WHEEL_SHIFT(l)) & WHEEL_MASK)
+#define WHEEL_SLOT(l,t)   (&g_wdwheel[l][WHEEL_INDEX(l, t)])
+
+/* Signed number of ticks from the wheel time to an expiration tick */
+
+#define WHEEL_DELTA(t)    ((int32_t)((uint32_t)(t) - g_wdclock))
+
+/****************************************************************************
+ * Private Variables
+ ****************************************************************************/
+
+/* A slot of level 0 holds the watchdogs that expire on one tick.  A slot
+ * of a higher level holds the watchdogs of a range of ticks, in no
+ * particular order, and is moved down a level when the wheel time enters
+ * that range.  Each watchdog is thus only moved a few times before it
+ * expires, instead of being looked at on every revolution.
+ */
+
+static dq_queue_t g_wdwheel[WHEEL_LEVELS][CONFIG_WDOG_WHEEL_SLOTS];
+
+/* Watchdogs more than WHEEL_RANGE(WHEEL_LEVELS - 1) ticks away */
+
+static dq_queue_t g_wdoverflow;
+
+/* Watchdogs that have expired and wait to be run by wd_timer() */
+
+static dq_queue_t g_wdexpired;
+
+/* Wheel time: the number of ticks processed since initialization */
+
+static uint32_t g_wdclock;
+
+/* Number of watchdogs in the wheel, and how many of them are above
+ * level 0.
+ */
+
+static unsigned int g_wdcount;
+static unsigned int g_wdfar;
+
+/* Cached expiration tick of the earliest active watchdog.  Only valid if
+ * g_wdnextvalid is true; it is recomputed lazily by wd_wheel_next().
+ */
+
+static uint32_t g_wdnext;
+static bool g_wdnextvalid;
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: wd_wheel_queue
+ *
+ * Description:
+ *   Return the queue holding a watchdog of the wheel.
+ *
+ ****************************************************************************/
+
+static FAR dq_queue_t *wd_wheel_queue(FAR struct wdog_s *wdog)
+{
+  int level = WDOG_LEVEL(wdog);
+
+  if (level == WHEEL_LEVELS)
+    {
+      return &g_wdoverflow;
+    }
+
+  return WHEEL_SLOT(level, wdog->lag);
+}
+
+/****************************************************************************
+ * Name: wd_wheel_place
+ *
+ * Description:
+ *   Queue a watchdog, whose expiration tick is set, in the lowest level
+ *   that covers it.  Distances are counted from the next tick to process.
+ *
+ ****************************************************************************/
+
+static void wd_wheel_place(FAR struct wdog_s *wdog)
+{
+  uint32_t delta = (uint32_t)wdog->lag - (g_wdclock + 1);
+  int level;
+
+  DEBUGASSERT(WHEEL_DELTA(wdog->lag) > 0);
+
+  for (level = 0; level < WHEEL_LEVELS; level++)
+    {
+      if (delta < WHEEL_RANGE(level))
+        {
+          break;
+        }
+    }
+
+  WDOG_SETLEVEL(wdog, level);
+  dq_addlast((FAR dq_entry_t *)wdog, wd_wheel_queue(wdog));
+
+  if (level > 0)
+    {
+      g_wdfar++;
+    }
+}
+
+/****************************************************************************
+ * Name: wd_wheel_cascade
+ *
+ * Description:
+ *   Move the watchdogs of the level 'level' slot that the next tick enters
+ *   down to the levels below, and return the index of that slot.  Past the
+ *   last level, the overflow list is sorted again.
+ *
+ ****************************************************************************/
+
+static int wd_wheel_cascade(int level)
+{
+  FAR struct wdog_s *curr;
+  FAR dq_queue_t *queue;
+  dq_queue_t pending;
+  int index;
+
+  if (level == WHEEL_LEVELS)
+    {
+      index = 0;
+      queue = &g_wdoverflow;
+    }
+  else
+    {
+      index = WHEEL_INDEX(level, g_wdclock + 1);
+      queue = &g_wdwheel[level][index];
+    }
+
+  pending = *queue;
+  dq_init(queue);
+
+  while ((curr = (FAR struct wdog_s *)dq_remfirst(&pending)) != NULL)
+    {
+      g_wdfar--;
+      wd_wheel_place(curr);
+    }
+
+  return index;
+}
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: wd_wheel_initialize
+ *
+ * Description:
+ *   Empty the timer wheel.
+ *
+ ****************************************************************************/
+
+void wd_wheel_initialize(void)
+{
+  int level;
+  int i;
+
+  for (level = 0; level < WHEEL_LEVELS; level++)
+    {
+      for (i = 0; i < CONFIG_WDOG_WHEEL_SLOTS; i++)
+        {
+          dq_init(&g_wdwheel[level][i]);
+        }
+    }
+
+  dq_init(&g_wdoverflow);
+  dq_init(&g_wdexpired);
+  g_wdclock     = 0;
+  g_wdcount     = 0;
+  g_wdfar       = 0;
+  g_wdnextvalid = false;
+}
+
+/****************************************************************************
+ * Name: wd_wheel_insert
+ *
+ * Description:
+ *   Add a watchdog that expires in 'delay' ticks to the wheel.
+ *
+ ****************************************************************************/
+
+void wd_wheel_insert(FAR struct wdog_s *wdog, int delay)
+{
+  DEBUGASSERT(delay > 0);
+
+  wdog->lag = (int)(g_wdclock + (uint32_t)delay);
+  wd_wheel_place(wdog);
+  g_wdcount++;
+
+  if (g_wdnextvalid && WHEEL_DELTA(wdog->lag) < WHEEL_DELTA(g_wdnext))
+    {
+      g_wdnext = (uint32_t)wdog->lag;
+    }
+}
+
+/****************************************************************************
+ * Name: wd_wheel_remove
+ *
+ * Description:
+ *   Remove an active watchdog from the wheel, or from the list of expired
+ *   watchdogs that have not run yet.
+ *
+ * Return Value:
+ *   True if the watchdog may have been the next one to expire, in which
+ *   case the interval timer should be reassessed.
+ *
+ ****************************************************************************/
+
+bool wd_wheel_remove(FAR struct wdog_s *wdog)
+{
+  if (WDOG_ISEXPIRED(wdog))
+    {
+      dq_rem((FAR dq_entry_t *)wdog, &g_wdexpired);
+      WDOG_CLREXPIRED(wdog);
+      return false;
+    }
+
+  dq_rem((FAR dq_entry_t *)wdog, wd_wheel_queue(wdog));
+  g_wdcount--;
+  if (WDOG_LEVEL(wdog) > 0)
+    {
+      g_wdfar--;
+    }
+
+  if (!g_wdnextvalid || (uint32_t)wdog->lag == g_wdnext)
+    {
+      g_wdnextvalid = false;
+      return true;
+    }
+
+  return false;
+}
+
+/****************************************************************************
+ * Name: wd_wheel_remaining
+ *
+ * Description:
+ *   Return the number of ticks before an active watchdog expires.
+ *
+ ****************************************************************************/
+
+int wd_wheel_remaining(FAR struct wdog_s *wdog)
+{
+  int32_t delta;
+
+  if (WDOG_ISEXPIRED(wdog))
+    {
+      return 0;
+    }
+
+  delta = WHEEL_DELTA(wdog->lag);
+  return delta > 0 ? (int)delta : 0;
+}
+
+/****************************************************************************
+ * Name: wd_wheel_advance
+ *
+ * Description:
+ *   Advance the wheel time by 'ticks' and move every watchdog that expired
+ *   to the expired list, in expiration order.  Each elapsed tick takes the
+ *   whole level 0 slot of that tick; when it crosses into the range of a
+ *   higher level slot, that slot is first moved down.
+ *
+ ****************************************************************************/
+
+void wd_wheel_advance(unsigned int ticks)
+{
+  FAR struct wdog_s *curr;
+  FAR dq_queue_t *slot;
+  int level;
+
+  for (; ticks > 0 && g_wdcount > 0; ticks--)
+    {
+      level = 0;
+      while (level < WHEEL_LEVELS &&
+             WHEEL_INDEX(level, g_wdclock + 1) == 0 &&
+             wd_wheel_cascade(++level) == 0);
+
+      slot = WHEEL_SLOT(0, ++g_wdclock);
+      while ((curr = (FAR struct wdog_s *)dq_remfirst(slot)) != NULL)
+        {
+          DEBUGASSERT(WHEEL_DELTA(curr->lag) == 0);
+          dq_addlast((FAR dq_entry_t *)curr, &g_wdexpired);
+          WDOG_SETEXPIRED(curr);
+          g_wdcount--;
+        }
+    }
+
+  /* Nothing is left to expire, so the remaining ticks need no visit */
+
+  g_wdclock += ticks;
+
+  if (g_wdnextvalid && WHEEL_DELTA(g_wdnext) <= 0)
+    {
+      g_wdnextvalid = false;
+    }
+}
+
+/****************************************************************************
+ * Name: wd_wheel_expired
+ *
+ * Description:
+ *   Remove and return the next expired watchdog, marked inactive, or NULL
+ *   if there is none left.
+ *
+ ****************************************************************************/
+
+FAR struct wdog_s *wd_wheel_expired(void)
+{
+  FAR struct wdog_s *wdog;
+
+  wdog = (FAR struct wdog_s *)dq_remfirst(&g_wdexpired);
+  if (wdog)
+    {
+      WDOG_CLREXPIRED(wdog);
+      WDOG_CLRACTIVE(wdog);
+    }
+
+  return wdog;
+}
+
+/****************************************************************************
+ * Name: wd_wheel_next
+ *
+ * Description:
+ *   Return the number of ticks until the next watchdog expires, or zero if
+ *   no watchdog is active.  Only level 0 is searched: if watchdogs wait in
+ *   higher levels, the number of ticks until the next of them may be moved
+ *   down is returned instead, and the search resumes then.
+ *
+ ****************************************************************************/
+
+unsigned int wd_wheel_next(void)
+{
+  unsigned int boundary;
+  unsigned int i;
+
+  if (g_wdexpired.head)
+    {
+      return 1;
+    }
+
+  if (g_wdnextvalid)
+    {
+      return (unsigned int)WHEEL_DELTA(g_wdnext);
+    }
+
+  if (g_wdcount == 0)
+    {
+      return 0;
+    }
+
+  /* No watchdog above level 0 expires before the next level 1 boundary */
+
+  boundary = CONFIG_WDOG_WHEEL_SLOTS - (g_wdclock & WHEEL_MASK);
+
+  for (i = 1; i <= CONFIG_WDOG_WHEEL_SLOTS; i++)
+    {
+      if (g_wdfar > 0 && i > boundary)
+        {
+          break;
+        }
+
+      if (WHEEL_SLOT(0, g_wdclock + i)->head)
+        {
+          g_wdnext      = g_wdclock + i;
+          g_wdnextvalid = true;
+          return i;
+        }
+    }
+
+  return boundary;
+}
+
+#endif /* CONFIG_WDOG_TIMER_WHEEL */
@@ -74,12 +74,14 @@ extern "C"
 
 extern sq_queue_t g_wdfreelist;
 
+#ifndef CONFIG_WDOG_TIMER_WHEEL
 /* The g_wdactivelist data structure is a singly linked list ordered by
  * watchdog expiration time. When watchdog timers expire,the functions on
  * this linked list are removed and the function is called.
  */
 
 extern sq_queue_t g_wdactivelist;
+#endif
 
 /* This is the number of free, pre-allocated watchdog structures in the
  * g_wdfreelist.  This value is used to enforce a reserve for interrupt
@@ -113,6 +115,28 @@ extern uint16_t g_wdnfree;
 
 void weak_function wd_initialize(void);
 
+#ifdef CONFIG_WDOG_TIMER_WHEEL
+/************************************************************************
+ * Name: wd_wheel_initialize, wd_wheel_insert, wd_wheel_remove,
+ *       wd_wheel_remaining, wd_wheel_advance, wd_wheel_expired,
+ *       wd_wheel_next
+ *
+ * Description:
+ *   Timer wheel holding the active watchdogs when
+ *   CONFIG_WDOG_TIMER_WHEEL is selected (see wd_wheel.c).  All of these
+ *   must be called with interrupts disabled.
+ *
+ ************************************************************************/
+
+void wd_wheel_initialize(void);
+void wd_wheel_insert(FAR struct wdog_s *wdog, int delay);
+bool wd_wheel_remove(FAR struct wdog_s *wdog);
+int  wd_wheel_remaining(FAR struct wdog_s *wdog);
+void wd_wheel_advance(unsigned int ticks);
+FAR struct wdog_s *wd_wheel_expired(void);
+unsigned int wd_wheel_next(void);
+#endif
+
 /****************************************************************************
  * Name: wd_timer
  *